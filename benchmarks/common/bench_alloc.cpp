@@ -0,0 +1,226 @@
+/**
+ * bench_alloc.cpp
+ *
+ * NUMA- and hugepage-aware allocation of benchmark inputs.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <mutex>
+
+#include "bench_alloc.h"
+#include "bench_parallel.h"
+
+// From <numaif.h>; defined here so that libnuma is not required.
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+#define HUGEPAGE_SIZE (2UL * 1024 * 1024)
+// Largest node number supported in the interleave mask.
+#define MAX_NODES 1024
+// Largest number of live bench_alloc mappings.
+#define MAX_MAPPINGS 256
+
+static const char *policy_names[] = {
+    "malloc", "first-touch", "interleave", "thp", "hugetlb"
+};
+
+static enum bench_alloc_policy configured = BENCH_ALLOC_MALLOC;
+static enum bench_alloc_policy effective = BENCH_ALLOC_MALLOC;
+static int touch_threads = 1;
+
+// Memory mapped by bench_alloc, so bench_free can unmap it.
+struct mapping {
+    void *ptr;
+    size_t bytes;
+};
+static struct mapping mappings[MAX_MAPPINGS];
+static std::mutex mappings_lock;
+
+bool bench_alloc_parse(const char *name, enum bench_alloc_policy *policy) {
+    for (int i = 0; i < (int) (sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            *policy = (enum bench_alloc_policy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void bench_alloc_set_policy(enum bench_alloc_policy policy) {
+    configured = policy;
+    effective = policy;
+}
+
+void bench_alloc_set_threads(int threads) {
+    touch_threads = threads;
+}
+
+const char *bench_alloc_policy_name() {
+    return policy_names[effective];
+}
+
+bool bench_alloc_is_placed() {
+    return configured != BENCH_ALLOC_MALLOC;
+}
+
+static size_t round_up(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+static void *map_anonymous(size_t bytes, int flags) {
+    void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+/** Maps bytes (a multiple of HUGEPAGE_SIZE) at a HUGEPAGE_SIZE-aligned address. */
+static void *map_aligned(size_t bytes) {
+    char *raw = (char *) map_anonymous(bytes + HUGEPAGE_SIZE, 0);
+    if (raw == NULL) {
+        return NULL;
+    }
+    char *aligned = (char *) round_up((uintptr_t) raw, HUGEPAGE_SIZE);
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    size_t tail = (raw + bytes + HUGEPAGE_SIZE) - (aligned + bytes);
+    if (tail > 0) {
+        munmap(aligned + bytes, tail);
+    }
+    return aligned;
+}
+
+/** Fills mask with the NUMA nodes that are online. */
+static void online_nodes(unsigned long *mask, size_t mask_words) {
+    memset(mask, 0, mask_words * sizeof(unsigned long));
+    const size_t word_bits = sizeof(unsigned long) * 8;
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    char ranges[256];
+    if (f == NULL || fgets(ranges, sizeof(ranges), f) == NULL) {
+        // No NUMA information: a single node.
+        mask[0] = 1;
+        if (f != NULL) {
+            fclose(f);
+        }
+        return;
+    }
+    fclose(f);
+    // The format is a list of ranges, e.g. "0-1,4".
+    char *p = ranges;
+    while (*p != '\0' && *p != '\n') {
+        long lo = strtol(p, &p, 10);
+        long hi = lo;
+        if (*p == '-') {
+            hi = strtol(p + 1, &p, 10);
+        }
+        for (long node = lo; node <= hi && node < MAX_NODES; node++) {
+            mask[node / word_bits] |= 1UL << (node % word_bits);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+}
+
+static void *alloc_mapped(size_t bytes, size_t *mapped_bytes) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    void *ptr = NULL;
+    switch (effective) {
+        case BENCH_ALLOC_HUGETLB:
+            *mapped_bytes = round_up(bytes, HUGEPAGE_SIZE);
+            ptr = map_anonymous(*mapped_bytes, MAP_HUGETLB);
+            if (ptr != NULL) {
+                break;
+            }
+            fprintf(stderr, "no explicit hugepages available, falling back to thp\n");
+            effective = BENCH_ALLOC_THP;
+            // Fall through.
+        case BENCH_ALLOC_THP:
+            *mapped_bytes = round_up(bytes, HUGEPAGE_SIZE);
+            ptr = map_aligned(*mapped_bytes);
+            if (ptr != NULL) {
+                madvise(ptr, *mapped_bytes, MADV_HUGEPAGE);
+            }
+            break;
+        case BENCH_ALLOC_INTERLEAVE: {
+            *mapped_bytes = round_up(bytes, page);
+            ptr = map_anonymous(*mapped_bytes, 0);
+            if (ptr != NULL) {
+                const size_t words = MAX_NODES / (sizeof(unsigned long) * 8);
+                unsigned long mask[words];
+                online_nodes(mask, words);
+                if (syscall(SYS_mbind, ptr, *mapped_bytes, MPOL_INTERLEAVE, mask, MAX_NODES, 0) != 0) {
+                    fprintf(stderr, "mbind failed, pages are not interleaved\n");
+                }
+            }
+            break;
+        }
+        case BENCH_ALLOC_FIRST_TOUCH:
+            *mapped_bytes = round_up(bytes, page);
+            ptr = map_anonymous(*mapped_bytes, 0);
+            if (ptr != NULL) {
+                // Touch each thread's share of the column from that thread,
+                // split as the multi-threaded schemes split their input.
+                bench_parallel_for(touch_threads, *mapped_bytes, [&](int64_t start, int64_t end) {
+                    memset((char *) ptr + start, 0, end - start);
+                });
+            }
+            break;
+        case BENCH_ALLOC_MALLOC:
+            break;
+    }
+    return ptr;
+}
+
+void *bench_alloc(size_t bytes) {
+    if (effective == BENCH_ALLOC_MALLOC) {
+        void *ptr = malloc(bytes);
+        if (ptr == NULL) {
+            fprintf(stderr, "could not allocate %zu bytes\n", bytes);
+            exit(1);
+        }
+        return ptr;
+    }
+
+    size_t mapped_bytes = 0;
+    void *ptr = alloc_mapped(bytes > 0 ? bytes : 1, &mapped_bytes);
+    if (ptr == NULL) {
+        fprintf(stderr, "could not map %zu bytes with policy %s\n", bytes, bench_alloc_policy_name());
+        exit(1);
+    }
+
+    std::lock_guard<std::mutex> guard(mappings_lock);
+    for (int i = 0; i < MAX_MAPPINGS; i++) {
+        if (mappings[i].ptr == NULL) {
+            mappings[i].ptr = ptr;
+            mappings[i].bytes = mapped_bytes;
+            return ptr;
+        }
+    }
+    fprintf(stderr, "too many live allocations\n");
+    exit(1);
+}
+
+void bench_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mappings_lock);
+        for (int i = 0; i < MAX_MAPPINGS; i++) {
+            if (mappings[i].ptr == ptr) {
+                munmap(ptr, mappings[i].bytes);
+                mappings[i].ptr = NULL;
+                return;
+            }
+        }
+    }
+    free(ptr);
+}
@@ -0,0 +1,65 @@
+/**
+ * bench_alloc.h
+ *
+ * Placement of benchmark input columns in memory.
+ *
+ * Inputs are allocated by the thread that generates them. With plain
+ * malloc, all pages of a large column land on that thread's NUMA node, and
+ * every multi-threaded scheme then reads from one node's memory. The
+ * policies below spread or pin the pages instead, or back them with 2MB
+ * hugepages to take TLB misses out of memory-bound kernels.
+ *
+ */
+
+#ifndef _BENCH_ALLOC_H_
+#define _BENCH_ALLOC_H_
+
+#include <stddef.h>
+
+enum bench_alloc_policy {
+    // malloc, with pages placed on the node that first writes them.
+    BENCH_ALLOC_MALLOC,
+    // Pages are first touched by the benchmark's threads, each touching the
+    // range of the column it processes in the multi-threaded schemes.
+    BENCH_ALLOC_FIRST_TOUCH,
+    // Pages are interleaved round-robin over all NUMA nodes.
+    BENCH_ALLOC_INTERLEAVE,
+    // 2MB-aligned memory advised to use transparent hugepages.
+    BENCH_ALLOC_THP,
+    // Explicit 2MB hugepages (MAP_HUGETLB) from the reserved pool. Falls back
+    // to BENCH_ALLOC_THP if none are available.
+    BENCH_ALLOC_HUGETLB,
+};
+
+/** Parses a policy name: malloc, first-touch, interleave, thp or hugetlb.
+ *
+ * @return true on success.
+ */
+bool bench_alloc_parse(const char *name, enum bench_alloc_policy *policy);
+
+/** Sets the policy of subsequent bench_alloc calls. */
+void bench_alloc_set_policy(enum bench_alloc_policy policy);
+
+/** Sets the number of threads that first-touch pages under BENCH_ALLOC_FIRST_TOUCH. */
+void bench_alloc_set_threads(int threads);
+
+/** Returns the name of the policy allocations actually used.
+ *
+ * This differs from the configured policy if it had to fall back, e.g.
+ * when no explicit hugepages were reserved.
+ */
+const char *bench_alloc_policy_name();
+
+/** Returns true if the configured policy is not BENCH_ALLOC_MALLOC. */
+bool bench_alloc_is_placed();
+
+/** Allocates an input column under the current policy.
+ *
+ * Exits the process if the memory cannot be allocated.
+ */
+void *bench_alloc(size_t bytes);
+
+/** Frees memory returned by bench_alloc. */
+void bench_free(void *ptr);
+
+#endif
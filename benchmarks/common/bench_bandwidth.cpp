@@ -0,0 +1,129 @@
+/**
+ * bench_bandwidth.cpp
+ *
+ * The STREAM-style bandwidth probe and roofline output.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bench_alloc.h"
+#include "bench_bandwidth.h"
+#include "bench_parallel.h"
+#include "bench_timing.h"
+
+// Size of each probe array; large enough to stream from memory rather than
+// from the last-level cache.
+#define PROBE_BYTES (256UL * 1024 * 1024)
+// Runs of each probe kernel. The fastest is kept, as in STREAM.
+#define PROBE_TRIALS 5
+
+static bool probed = false;
+static int probed_threads = 0;
+static struct bench_bandwidth probed_peak;
+
+// Keeps the read kernel's sum live.
+static volatile uint64_t sink;
+
+/** Measures the peak bandwidths on two PROBE_BYTES arrays. */
+static struct bench_bandwidth probe(int threads) {
+    int64_t n = PROBE_BYTES / sizeof(uint64_t);
+    uint64_t *a = (uint64_t *) bench_alloc(PROBE_BYTES);
+    uint64_t *b = (uint64_t *) bench_alloc(PROBE_BYTES);
+    // Written by the threads that read them, so every page is resident.
+    bench_parallel_for(threads, n, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            a[i] = i;
+            b[i] = 0;
+        }
+    });
+
+    double read_time = 0.0, copy_time = 0.0;
+    for (int t = 0; t < PROBE_TRIALS; t++) {
+        double time = bench_time([&] {
+            sink = bench_parallel_sum<uint64_t>(threads, n, [&](int64_t start, int64_t end) {
+                uint64_t sum = 0;
+                for (int64_t i = start; i < end; i++) {
+                    sum += a[i];
+                }
+                return sum;
+            });
+        });
+        if (t == 0 || time < read_time) {
+            read_time = time;
+        }
+
+        // An add rather than a plain copy, so the loop is not turned into a
+        // memcpy with non-temporal stores; this is the shape of the vector kernel.
+        time = bench_time([&] {
+            bench_parallel_for(threads, n, [&](int64_t start, int64_t end) {
+                for (int64_t i = start; i < end; i++) {
+                    b[i] = a[i] + 1;
+                }
+            });
+        });
+        if (t == 0 || time < copy_time) {
+            copy_time = time;
+        }
+    }
+    bench_free(a);
+    bench_free(b);
+
+    struct bench_bandwidth bw;
+    bw.read = PROBE_BYTES / read_time / 1e9;
+    bw.copy = 2.0 * PROBE_BYTES / copy_time / 1e9;
+    return bw;
+}
+
+/** Reads a probe result cached for this thread count and placement policy. */
+static bool load(const char *path, int threads, struct bench_bandwidth *bw) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    int cached_threads;
+    char policy[64];
+    bool ok = fscanf(f, "threads=%d alloc=%63s read=%lf copy=%lf",
+            &cached_threads, policy, &bw->read, &bw->copy) == 4 &&
+        cached_threads == threads && strcmp(policy, bench_alloc_policy_name()) == 0 &&
+        bw->read > 0.0 && bw->copy > 0.0;
+    fclose(f);
+    return ok;
+}
+
+static void store(const char *path, int threads, const struct bench_bandwidth *bw) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "could not write %s\n", path);
+        return;
+    }
+    fprintf(f, "threads=%d alloc=%s read=%.3f copy=%.3f\n",
+            threads, bench_alloc_policy_name(), bw->read, bw->copy);
+    fclose(f);
+}
+
+struct bench_bandwidth bench_bandwidth_peak(const char *path, int threads) {
+    if (probed && probed_threads == threads) {
+        return probed_peak;
+    }
+    if (path == NULL || !load(path, threads, &probed_peak)) {
+        probed_peak = probe(threads);
+        if (path != NULL) {
+            store(path, threads, &probed_peak);
+        }
+    }
+    probed = true;
+    probed_threads = threads;
+    return probed_peak;
+}
+
+void bench_bandwidth_print(double bytes, double seconds, double peak) {
+    if (seconds <= 0.0 || peak <= 0.0) {
+        return;
+    }
+    double gbps = bytes / seconds / 1e9;
+    printf(" [gbps=%.2f peak=%.2f roofline=%.2f]", gbps, peak, gbps / peak);
+}
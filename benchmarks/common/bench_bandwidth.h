@@ -0,0 +1,47 @@
+/**
+ * bench_bandwidth.h
+ *
+ * Memory-bandwidth roofline for the streaming benchmarks.
+ *
+ * A STREAM-style probe measures the read and copy bandwidth the machine
+ * sustains at the benchmark's thread count and placement policy. Timing
+ * lines of schemes that declare how many bytes a query moves then report
+ * the achieved bandwidth and its fraction of that peak.
+ *
+ */
+
+#ifndef _BENCH_BANDWIDTH_H_
+#define _BENCH_BANDWIDTH_H_
+
+// The memory traffic of a query, which selects the peak it is compared to.
+enum bench_traffic {
+    // The query only reads its input, e.g. a reduction.
+    BENCH_TRAFFIC_READ,
+    // The query reads its input and writes an output of similar size.
+    BENCH_TRAFFIC_COPY,
+};
+
+// Peak bandwidths measured by the probe, in GB/s.
+struct bench_bandwidth {
+    // Sum over an array.
+    double read;
+    // Copy of one array into another, counting bytes read and written.
+    double copy;
+};
+
+/** Returns the peak bandwidths at the given thread count.
+ *
+ * The probe runs once per process. If path is not NULL, its result is
+ * also cached there and reused by later processes with the same thread
+ * count and placement policy, so a session of runs probes only once.
+ *
+ * @param path the file to cache the probe result in, or NULL.
+ * @param threads the number of threads to probe with.
+ */
+struct bench_bandwidth bench_bandwidth_peak(const char *path, int threads);
+
+/** Prints " [gbps=... peak=... roofline=...]" for a query that moves bytes
+ * in seconds, without a newline. */
+void bench_bandwidth_print(double bytes, double seconds, double peak);
+
+#endif
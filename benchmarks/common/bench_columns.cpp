@@ -0,0 +1,216 @@
+/**
+ * bench_columns.cpp
+ *
+ * Writing and mapping of binary column files.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bench_columns.h"
+
+size_t column_elem_size(enum column_type type) {
+    switch (type) {
+        case COLUMN_INT8: return sizeof(int8_t);
+        case COLUMN_INT32: return sizeof(int32_t);
+        case COLUMN_INT64: return sizeof(int64_t);
+        case COLUMN_FLOAT: return sizeof(float);
+        case COLUMN_DOUBLE: return sizeof(double);
+    }
+    return 0;
+}
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + COLUMN_FILE_ALIGN - 1) / COLUMN_FILE_ALIGN * COLUMN_FILE_ALIGN;
+}
+
+/** Writes zero bytes until the file position reaches offset. */
+static bool pad_to(FILE *out, uint64_t offset) {
+    static const char zeros[COLUMN_FILE_ALIGN] = {0};
+    long pos = ftell(out);
+    if (pos < 0 || (uint64_t) pos > offset) {
+        return false;
+    }
+    size_t pad = offset - pos;
+    return fwrite(zeros, 1, pad, out) == pad;
+}
+
+bool column_file_write(const char *path, const char *key, int64_t num_rows,
+        const struct column_spec *columns, int num_columns) {
+    if (strlen(key) >= COLUMN_FILE_KEY_LEN) {
+        return false;
+    }
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int) getpid());
+    FILE *out = fopen(tmp_path, "wb");
+    if (out == NULL) {
+        return false;
+    }
+
+    struct column_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLUMN_FILE_MAGIC, sizeof(header.magic));
+    header.version = COLUMN_FILE_VERSION;
+    header.num_columns = num_columns;
+    header.num_rows = num_rows;
+    strcpy(header.key, key);
+
+    struct column_file_entry *entries = (struct column_file_entry *)
+        calloc(num_columns, sizeof(struct column_file_entry));
+    uint64_t offset = align_up(sizeof(header) + sizeof(struct column_file_entry) * num_columns);
+    for (int i = 0; i < num_columns; i++) {
+        strncpy(entries[i].name, columns[i].name, COLUMN_FILE_NAME_LEN - 1);
+        entries[i].type = columns[i].type;
+        entries[i].elem_size = column_elem_size(columns[i].type);
+        entries[i].offset = offset;
+        offset = align_up(offset + entries[i].elem_size * num_rows);
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+        fwrite(entries, sizeof(struct column_file_entry), num_columns, out) == (size_t) num_columns;
+    for (int i = 0; ok && i < num_columns; i++) {
+        size_t bytes = entries[i].elem_size * num_rows;
+        ok = pad_to(out, entries[i].offset) &&
+            fwrite(columns[i].data, 1, bytes, out) == bytes;
+    }
+    // Pad the last block so every column is a whole number of blocks.
+    ok = ok && pad_to(out, offset);
+    ok = (fclose(out) == 0) && ok;
+    free(entries);
+
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+    }
+    return ok;
+}
+
+bool column_file_map(const char *path, const char *key, struct column_file *f) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct column_file_header)) {
+        close(fd);
+        return false;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const struct column_file_header *header = (const struct column_file_header *) base;
+    size_t size = st.st_size;
+    bool ok = memcmp(header->magic, COLUMN_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == COLUMN_FILE_VERSION &&
+        strncmp(header->key, key, COLUMN_FILE_KEY_LEN) == 0 &&
+        sizeof(*header) + sizeof(struct column_file_entry) * header->num_columns <= size;
+
+    const struct column_file_entry *entries = (const struct column_file_entry *) (header + 1);
+    for (uint32_t i = 0; ok && i < header->num_columns; i++) {
+        ok = entries[i].offset % COLUMN_FILE_ALIGN == 0 &&
+            entries[i].offset + entries[i].elem_size * header->num_rows <= size;
+    }
+    if (!ok) {
+        munmap(base, size);
+        return false;
+    }
+
+    f->base = base;
+    f->size = size;
+    f->num_rows = header->num_rows;
+    return true;
+}
+
+void *column_file_column(const struct column_file *f, const char *name, enum column_type type) {
+    const struct column_file_header *header = (const struct column_file_header *) f->base;
+    const struct column_file_entry *entries = (const struct column_file_entry *) (header + 1);
+    for (uint32_t i = 0; i < header->num_columns; i++) {
+        if (strncmp(entries[i].name, name, COLUMN_FILE_NAME_LEN) == 0 && entries[i].type == (uint32_t) type) {
+            return (char *) f->base + entries[i].offset;
+        }
+    }
+    fprintf(stderr, "column file has no column %s\n", name);
+    exit(1);
+}
+
+void column_file_unmap(struct column_file *f) {
+    munmap(f->base, f->size);
+    f->base = NULL;
+}
+
+/** Reads and validates the header and entries of an open column file.
+ *
+ * @param entries receives the entries, allocated with malloc.
+ */
+static bool read_layout(int fd, const char *key, struct column_file_header *header,
+        struct column_file_entry **entries) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+            pread(fd, header, sizeof(*header), 0) != (ssize_t) sizeof(*header)) {
+        return false;
+    }
+    size_t size = st.st_size;
+    if (memcmp(header->magic, COLUMN_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != COLUMN_FILE_VERSION ||
+            strncmp(header->key, key, COLUMN_FILE_KEY_LEN) != 0 ||
+            sizeof(*header) + sizeof(struct column_file_entry) * header->num_columns > size) {
+        return false;
+    }
+    size_t bytes = sizeof(struct column_file_entry) * header->num_columns;
+    *entries = (struct column_file_entry *) malloc(bytes > 0 ? bytes : 1);
+    bool ok = pread(fd, *entries, bytes, sizeof(*header)) == (ssize_t) bytes;
+    for (uint32_t i = 0; ok && i < header->num_columns; i++) {
+        ok = (*entries)[i].offset % COLUMN_FILE_ALIGN == 0 &&
+            (*entries)[i].offset + (*entries)[i].elem_size * header->num_rows <= size;
+    }
+    if (!ok) {
+        free(*entries);
+    }
+    return ok;
+}
+
+bool column_file_check(const char *path, const char *key) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct column_file_header header;
+    struct column_file_entry *entries;
+    bool ok = read_layout(fd, key, &header, &entries);
+    close(fd);
+    if (ok) {
+        free(entries);
+    }
+    return ok;
+}
+
+bool column_file_locate(int fd, const char *key, const char *name, enum column_type type,
+        uint64_t *offset, int64_t *num_rows) {
+    struct column_file_header header;
+    struct column_file_entry *entries;
+    if (!read_layout(fd, key, &header, &entries)) {
+        return false;
+    }
+    bool found = false;
+    for (uint32_t i = 0; i < header.num_columns && !found; i++) {
+        if (strncmp(entries[i].name, name, COLUMN_FILE_NAME_LEN) == 0 && entries[i].type == (uint32_t) type) {
+            *offset = entries[i].offset;
+            *num_rows = header.num_rows;
+            found = true;
+        }
+    }
+    free(entries);
+    return found;
+}
@@ -0,0 +1,125 @@
+/**
+ * bench_columns.h
+ *
+ * A binary column file format for caching generated benchmark inputs.
+ *
+ * A file starts with a column_file_header, followed by one
+ * column_file_entry per column. Each column's values follow as a contiguous
+ * block starting at a COLUMN_FILE_ALIGN-aligned offset, so that a mapped
+ * column can be passed to make_weld_vector directly.
+ *
+ */
+
+#ifndef _BENCH_COLUMNS_H_
+#define _BENCH_COLUMNS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COLUMN_FILE_MAGIC "WBCOLS01"
+#define COLUMN_FILE_VERSION 1
+// Alignment of each column block; a page, so mapped columns are page-aligned.
+#define COLUMN_FILE_ALIGN 4096
+#define COLUMN_FILE_NAME_LEN 32
+#define COLUMN_FILE_KEY_LEN 256
+
+// Element types of a column.
+enum column_type {
+    COLUMN_INT8 = 1,
+    COLUMN_INT32 = 2,
+    COLUMN_INT64 = 3,
+    COLUMN_FLOAT = 4,
+    COLUMN_DOUBLE = 5,
+};
+
+struct column_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_columns;
+    int64_t num_rows;
+    // Describes the parameters the data was generated with; a file is only
+    // reused if its key matches.
+    char key[COLUMN_FILE_KEY_LEN];
+};
+
+struct column_file_entry {
+    char name[COLUMN_FILE_NAME_LEN];
+    uint32_t type;
+    uint32_t elem_size;
+    // Offset of the column block from the start of the file.
+    uint64_t offset;
+};
+
+// A column to write.
+struct column_spec {
+    const char *name;
+    enum column_type type;
+    const void *data;
+};
+
+// A mapped column file.
+struct column_file {
+    void *base;
+    size_t size;
+    int64_t num_rows;
+};
+
+/** Returns the size in bytes of one value of type. */
+size_t column_elem_size(enum column_type type);
+
+/** Writes columns of num_rows values each to a column file.
+ *
+ * The file is written under a temporary name and renamed into place, so
+ * a concurrent or interrupted run never maps a partial file.
+ *
+ * @param path the file to write.
+ * @param key the parameters the data was generated with.
+ * @param num_rows the number of values in each column.
+ * @param columns the columns to write.
+ * @param num_columns the number of columns.
+ * @return true on success, false if the file could not be written.
+ */
+bool column_file_write(const char *path, const char *key, int64_t num_rows,
+        const struct column_spec *columns, int num_columns);
+
+/** Maps a column file written by column_file_write.
+ *
+ * Pages are mapped privately, so writes to a column are never written
+ * back to the file.
+ *
+ * @param path the file to map.
+ * @param key the parameters the caller needs the data generated with.
+ * @param f the mapped file, set on success.
+ * @return true on success, false if the file does not exist, is not a
+ * valid column file or was written with a different key.
+ */
+bool column_file_map(const char *path, const char *key, struct column_file *f);
+
+/** Returns a pointer to the values of a mapped column.
+ *
+ * Exits the process if the file has no column with this name and type.
+ */
+void *column_file_column(const struct column_file *f, const char *name, enum column_type type);
+
+/** Unmaps a file mapped with column_file_map. */
+void column_file_unmap(struct column_file *f);
+
+/** Returns true if path is a valid column file written with key, without
+ * mapping or reading its columns. */
+bool column_file_check(const char *path, const char *key);
+
+/** Finds a column in an open column file without mapping it.
+ *
+ * @param fd the open file.
+ * @param key the parameters the caller needs the data generated with.
+ * @param name the column name.
+ * @param type the column type.
+ * @param offset receives the offset of the column's values in the file.
+ * @param num_rows receives the number of rows.
+ * @return true on success, false if the file is not a valid column file,
+ * was written with a different key or has no such column.
+ */
+bool column_file_locate(int fd, const char *key, const char *name, enum column_type type,
+        uint64_t *offset, int64_t *num_rows);
+
+#endif
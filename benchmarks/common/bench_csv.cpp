@@ -0,0 +1,596 @@
+/**
+ * bench_csv.cpp
+ *
+ * Parallel delimited text loader.
+ *
+ * The body of a file is split into one range per thread at line boundaries
+ * outside quoted fields, found from the parity of the quotes before each
+ * split point. A first pass counts the newlines of each range, which bounds
+ * the index of its first row; a second pass parses the ranges into their
+ * rows of the columns in parallel. Gaps left by blank lines, newlines in
+ * quoted fields and dropped rows are closed afterwards.
+ *
+ * Separators are found 32 bytes at a time with AVX2, skipping those between
+ * quotes, and long runs of digits in numeric fields are converted 8 at a
+ * time within a 64-bit word.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bench_alloc.h"
+#include "bench_csv.h"
+#include "bench_simd.h"
+
+// Most fields a header can have.
+#define MAX_FIELDS 256
+// Most digits a decimal can have to be converted exactly without strtod.
+#define MAX_EXACT_DIGITS 15
+
+static const double POWERS_OF_TEN[MAX_EXACT_DIGITS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+static void malformed(const char *path, const char *column) {
+    fprintf(stderr, "%s: malformed field in column %s\n", path, column);
+    exit(1);
+}
+
+// Finds the delimiters and newlines of a range in order, skipping those
+// in quoted fields.
+struct separators {
+    // The current 32-byte block.
+    const char *block;
+    const char *end;
+    char delimiter;
+    // The separators in the block not yet returned, one bit per byte.
+    uint32_t mask;
+    // All ones if the block ends inside a quoted field, else zero.
+    uint32_t in_quotes;
+};
+
+/** Returns, for each bit, the XOR of it and all lower bits: with one bit per
+ * quote, the bytes after an odd number of quotes. */
+static inline uint32_t prefix_xor(uint32_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    return x;
+}
+
+/** Sets mask to the separators of the block at s->block. */
+static void load_block(struct separators *s) {
+    int64_t n = s->end - s->block < 32 ? s->end - s->block : 32;
+    uint32_t quotes;
+#ifdef __AVX2__
+    __m256i bytes;
+    if (n == 32) {
+        bytes = _mm256_loadu_si256((const __m256i *) s->block);
+    } else {
+        // The last block may end on the last byte of the mapping.
+        char tail[32];
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, s->block, n);
+        bytes = _mm256_loadu_si256((const __m256i *) tail);
+    }
+    __m256i found = _mm256_or_si256(
+            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(s->delimiter)),
+            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+    s->mask = (uint32_t) _mm256_movemask_epi8(found);
+    quotes = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')));
+#else
+    s->mask = 0;
+    quotes = 0;
+    for (int64_t i = 0; i < n; i++) {
+        if (s->block[i] == s->delimiter || s->block[i] == '\n') {
+            s->mask |= 1u << i;
+        }
+        if (s->block[i] == '"') {
+            quotes |= 1u << i;
+        }
+    }
+#endif
+    if (n < 32) {
+        s->mask &= (1u << n) - 1;
+        quotes &= (1u << n) - 1;
+    }
+    if (quotes != 0 || s->in_quotes != 0) {
+        uint32_t inside = prefix_xor(quotes) ^ s->in_quotes;
+        s->mask &= ~inside;
+        s->in_quotes = (inside >> 31) ? ~0u : 0;
+    }
+}
+
+static void separators_init(struct separators *s, const char *start, const char *end, char delimiter) {
+    s->block = start;
+    s->end = end;
+    s->delimiter = delimiter;
+    s->mask = 0;
+    s->in_quotes = 0;
+    if (start < end) {
+        load_block(s);
+    }
+}
+
+/** Returns the next separator, or end if there are none left. */
+static inline const char *separators_next(struct separators *s) {
+    while (s->mask == 0) {
+        if (s->end - s->block <= 32) {
+            s->block = s->end;
+            return s->end;
+        }
+        s->block += 32;
+        load_block(s);
+    }
+    const char *p = s->block + __builtin_ctz(s->mask);
+    s->mask &= s->mask - 1;
+    return p;
+}
+
+/** Returns the number of bytes equal to c in [s, end). */
+static int64_t count_bytes(const char *s, const char *end, char c) {
+    int64_t count = 0;
+#ifdef __AVX2__
+    const __m256i target = _mm256_set1_epi8(c);
+    for (; end - s >= 32; s += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *) s);
+        count += __builtin_popcount((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, target)));
+    }
+#endif
+    for (; s < end; s++) {
+        count += (*s == c);
+    }
+    return count;
+}
+
+/** Splits the lines of [s, end) into fields. Calls field(k, start, end) for
+ * each of the first num_fields fields of a line, then row(fields) with the
+ * number of fields the line had. Blank lines are skipped, and a trailing
+ * '\r' is not part of the last field. Quoted fields are passed with their
+ * quotes, and may span lines. */
+template <typename F, typename R>
+static void scan_rows(const char *s, const char *end, char delimiter, int num_fields, F field, R row) {
+    struct separators sep;
+    separators_init(&sep, s, end, delimiter);
+    int k = 0;
+    while (s < end) {
+        const char *p = separators_next(&sep);
+        bool eol = p == end || *p == '\n';
+        const char *e = p;
+        if (eol && e > s && e[-1] == '\r') {
+            e--;
+        }
+        if (eol && k == 0 && e == s) {
+            s = p + 1;
+            continue;
+        }
+        if (k < num_fields) {
+            field(k, s, e);
+        }
+        k++;
+        if (eol) {
+            row(k);
+            k = 0;
+        }
+        s = p + 1;
+    }
+}
+
+/** Returns true if all eight bytes of a word are ASCII digits. */
+static inline bool all_digits(uint64_t chunk) {
+    // A byte is a digit if its high nibble is 3, and stays 3 after adding 6.
+    return (((chunk & 0xF0F0F0F0F0F0F0F0ULL) | ((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL)) ==
+            0x3030303030303030ULL);
+}
+
+/** Returns the value of eight ASCII digits, the first in the lowest byte. */
+static inline uint64_t eight_digits(uint64_t chunk) {
+    chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    chunk = (chunk & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+
+/** Appends the run of digits at *p, before end, to *value and advances *p
+ * past it. Runs that would overflow wrap; callers only trust runs of at
+ * most MAX_EXACT_DIGITS digits.
+ *
+ * @return the number of digits read.
+ */
+static inline int parse_digits(const char **p, const char *end, uint64_t *value) {
+    const char *s = *p;
+    // Eight at a time while the field has that many bytes left, which
+    // skips the word loads for the short fields most files have.
+    while (end - s >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, s, 8);
+        if (!all_digits(chunk)) {
+            break;
+        }
+        *value = *value * 100000000 + eight_digits(chunk);
+        s += 8;
+    }
+    while (s < end && (unsigned) (*s - '0') < 10) {
+        *value = *value * 10 + (*s - '0');
+        s++;
+    }
+    int digits = s - *p;
+    *p = s;
+    return digits;
+}
+
+/** Parses a number spanning all of [s, end). A decimal such as "-1234.56"
+ * with at most MAX_EXACT_DIGITS digits is converted with one division; other
+ * forms, e.g. exponents, fall back to strtod. */
+static bool parse_double(const char *s, const char *end, double *out) {
+    const char *p = s;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = parse_digits(&p, end, &mantissa);
+    int frac_digits = 0;
+    if (p < end && *p == '.') {
+        p++;
+        frac_digits = parse_digits(&p, end, &mantissa);
+    }
+    if (p == end && digits + frac_digits > 0 && digits + frac_digits <= MAX_EXACT_DIGITS) {
+        double value = (double) (int64_t) mantissa / POWERS_OF_TEN[frac_digits];
+        *out = negative ? -value : value;
+        return true;
+    }
+
+    char buf[64];
+    if (end - s >= (ptrdiff_t) sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, s, end - s);
+    buf[end - s] = '\0';
+    char *parsed;
+    *out = strtod(buf, &parsed);
+    return parsed == buf + (end - s) && parsed != buf;
+}
+
+/** Strips the quotes of a field [*s, *e) that starts with one.
+ *
+ * @param escaped set to whether the quoted text has doubled quotes.
+ * @return false if the field starts with a quote but does not end with one.
+ */
+static inline bool unquote(const char **s, const char **e, bool *escaped) {
+    *escaped = false;
+    if (*s == *e || **s != '"') {
+        return true;
+    }
+    if (*e - *s < 2 || (*e)[-1] != '"') {
+        return false;
+    }
+    (*s)++;
+    (*e)--;
+    *escaped = memchr(*s, '"', *e - *s) != NULL;
+    return true;
+}
+
+/** Replaces the doubled quotes of quoted text in place, in the private
+ * mapping.
+ *
+ * @return the new end of the text.
+ */
+static const char *unescape(const char *s, const char *e) {
+    char *out = (char *) s;
+    for (const char *p = s; p < e; p++) {
+        *out++ = *p;
+        if (*p == '"') {
+            p++;
+        }
+    }
+    return out;
+}
+
+// A mapped file with its header split into fields and its body into ranges.
+struct csv_file {
+    const char *text;
+    const char *end;
+    size_t size;
+    int num_fields;
+    const char *field_names[MAX_FIELDS];
+    int field_lengths[MAX_FIELDS];
+    // Range r is [bounds[r], bounds[r + 1]).
+    int num_ranges;
+    const char **bounds;
+};
+
+static void csv_file_open(const char *path, char delimiter, int num_ranges, struct csv_file *f) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "could not open %s\n", path);
+        exit(1);
+    }
+    f->size = st.st_size;
+    // Writable so that quoted strings can be unescaped in place; pages are
+    // only copied if that happens.
+    void *text = f->size > 0 ? mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (text == MAP_FAILED) {
+        fprintf(stderr, "could not map %s\n", path);
+        exit(1);
+    }
+    f->text = (const char *) text;
+    f->end = f->text + f->size;
+
+    // The header ends at the first newline outside quotes.
+    bool quoted = false;
+    const char *header_end = f->text;
+    while (header_end < f->end && (quoted || *header_end != '\n')) {
+        quoted ^= *header_end == '"';
+        header_end++;
+    }
+    const char *body = header_end < f->end ? header_end + 1 : f->end;
+    if (header_end > f->text && header_end[-1] == '\r') {
+        header_end--;
+    }
+    f->num_fields = 0;
+    for (const char *s = f->text; s <= header_end && f->num_fields < MAX_FIELDS; f->num_fields++) {
+        const char *e = s;
+        quoted = false;
+        while (e < header_end && (quoted || *e != delimiter)) {
+            quoted ^= *e == '"';
+            e++;
+        }
+        const char *name = s;
+        const char *name_end = e;
+        bool escaped;
+        unquote(&name, &name_end, &escaped);
+        f->field_names[f->num_fields] = name;
+        f->field_lengths[f->num_fields] = name_end - name;
+        s = e + 1;
+    }
+
+    // Split evenly, then move each boundary to the start of the next line
+    // outside quotes. A split point is inside quotes if an odd number of
+    // quotes precede it in the body.
+    f->num_ranges = num_ranges;
+    f->bounds = new const char *[num_ranges + 1];
+    const char **splits = new const char *[num_ranges + 1];
+    int64_t *quotes = new int64_t[num_ranges];
+    for (int r = 0; r <= num_ranges; r++) {
+        splits[r] = body + (f->end - body) * r / num_ranges;
+    }
+#pragma omp parallel for num_threads(num_ranges)
+    for (int r = 0; r < num_ranges; r++) {
+        quotes[r] = count_bytes(splits[r], splits[r + 1], '"');
+    }
+    f->bounds[0] = body;
+    int64_t preceding = 0;
+    for (int r = 1; r < num_ranges; r++) {
+        preceding += quotes[r - 1];
+        const char *b = splits[r];
+        quoted = preceding % 2 != 0;
+        if (b <= f->bounds[r - 1]) {
+            b = f->bounds[r - 1];
+        } else if (quoted || b[-1] != '\n') {
+            while (b < f->end && (quoted || *b != '\n')) {
+                quoted ^= *b == '"';
+                b++;
+            }
+            b = b < f->end ? b + 1 : f->end;
+        }
+        f->bounds[r] = b;
+    }
+    f->bounds[num_ranges] = f->end;
+    delete[] splits;
+    delete[] quotes;
+}
+
+/** Frees the ranges; the mapping is left to its owner. */
+static void csv_file_close(struct csv_file *f) {
+    delete[] f->bounds;
+}
+
+static int csv_file_field(const struct csv_file *f, const char *name) {
+    for (int k = 0; k < f->num_fields; k++) {
+        if ((int) strlen(name) == f->field_lengths[k] && memcmp(name, f->field_names[k], f->field_lengths[k]) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+struct csv_table csv_load(const char *path, char delimiter,
+        const struct csv_column_spec *columns, int num_columns, bool drop_missing, int threads) {
+    struct csv_file f;
+    csv_file_open(path, delimiter, threads, &f);
+
+    // The requested column stored from each field of a row, or -1.
+    int wanted[MAX_FIELDS];
+    for (int k = 0; k < f.num_fields; k++) {
+        wanted[k] = -1;
+    }
+    if (num_columns > CSV_MAX_COLUMNS) {
+        fprintf(stderr, "%s: too many requested columns\n", path);
+        exit(1);
+    }
+    for (int c = 0; c < num_columns; c++) {
+        int k = csv_file_field(&f, columns[c].name);
+        if (k < 0) {
+            fprintf(stderr, "%s: missing requested column %s\n", path, columns[c].name);
+            exit(1);
+        }
+        wanted[k] = c;
+    }
+
+    // first[r] is the first row of range r: every newline before it ends a
+    // row until blank lines, newlines in quoted fields and dropped rows are
+    // removed.
+    int64_t *first = new int64_t[threads + 1];
+    int64_t *kept = new int64_t[threads];
+    first[0] = 0;
+#pragma omp parallel for num_threads(threads)
+    for (int r = 0; r < threads; r++) {
+        const char *s = f.bounds[r];
+        const char *e = f.bounds[r + 1];
+        first[r + 1] = count_bytes(s, e, '\n') + (e > s && e[-1] != '\n');
+    }
+    for (int r = 0; r < threads; r++) {
+        first[r + 1] += first[r];
+    }
+
+    struct csv_table t;
+    t.text = (void *) f.text;
+    t.size = f.size;
+    t.num_columns = num_columns;
+    size_t elems[CSV_MAX_COLUMNS];
+    for (int c = 0; c < num_columns; c++) {
+        elems[c] = columns[c].type == CSV_DOUBLE ? sizeof(double) : sizeof(struct csv_string);
+        t.columns[c] = bench_alloc(elems[c] * (first[threads] + 1));
+    }
+
+#pragma omp parallel for num_threads(threads)
+    for (int r = 0; r < threads; r++) {
+        int64_t row = first[r];
+        bool missing = false;
+        scan_rows(f.bounds[r], f.bounds[r + 1], delimiter, f.num_fields,
+            [&](int k, const char *s, const char *e) {
+                int c = wanted[k];
+                if (c < 0) {
+                    return;
+                }
+                bool escaped;
+                if (!unquote(&s, &e, &escaped)) {
+                    malformed(path, columns[c].name);
+                }
+                missing |= e == s;
+                if (columns[c].type == CSV_DOUBLE) {
+                    double value = NAN;
+                    if (e != s && !parse_double(s, e, &value)) {
+                        malformed(path, columns[c].name);
+                    }
+                    ((double *) t.columns[c])[row] = value;
+                } else {
+                    struct csv_string *str = &((struct csv_string *) t.columns[c])[row];
+                    if (escaped) {
+                        e = unescape(s, e);
+                    }
+                    str->data = s;
+                    str->length = e - s;
+                }
+            },
+            [&](int fields) {
+                // A short row lacks its last fields.
+                for (int k = fields; k < f.num_fields; k++) {
+                    int c = wanted[k];
+                    if (c < 0) {
+                        continue;
+                    }
+                    missing = true;
+                    if (columns[c].type == CSV_DOUBLE) {
+                        ((double *) t.columns[c])[row] = NAN;
+                    } else {
+                        ((struct csv_string *) t.columns[c])[row].data = f.end;
+                        ((struct csv_string *) t.columns[c])[row].length = 0;
+                    }
+                }
+                if (!(drop_missing && missing)) {
+                    row++;
+                }
+                missing = false;
+            });
+        kept[r] = row - first[r];
+    }
+
+    int64_t rows = kept[0];
+    for (int r = 1; r < threads; r++) {
+        if (rows != first[r]) {
+            for (int c = 0; c < num_columns; c++) {
+                char *base = (char *) t.columns[c];
+                memmove(base + rows * elems[c], base + first[r] * elems[c], kept[r] * elems[c]);
+            }
+        }
+        rows += kept[r];
+    }
+    t.num_rows = rows;
+
+    delete[] first;
+    delete[] kept;
+    csv_file_close(&f);
+    return t;
+}
+
+void csv_table_free(struct csv_table *t) {
+    for (int c = 0; c < t->num_columns; c++) {
+        bench_free(t->columns[c]);
+    }
+    if (t->text != NULL) {
+        munmap(t->text, t->size);
+    }
+}
+
+char csv_detect_delimiter(const char *path) {
+    char header[4096];
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL || fgets(header, sizeof(header), fp) == NULL) {
+        fprintf(stderr, "could not read %s\n", path);
+        exit(1);
+    }
+    fclose(fp);
+    return strchr(header, '|') != NULL ? '|' : ',';
+}
+
+void csv_infer_schema(const char *path, char delimiter, int threads, struct csv_schema *schema) {
+    struct csv_file f;
+    csv_file_open(path, delimiter, threads, &f);
+    int num_fields = f.num_fields < CSV_MAX_COLUMNS ? f.num_fields : CSV_MAX_COLUMNS;
+
+    // Whether each range has a non-numeric value in each field.
+    bool *strings = new bool[threads * CSV_MAX_COLUMNS]();
+#pragma omp parallel for num_threads(threads)
+    for (int r = 0; r < threads; r++) {
+        bool *seen = &strings[r * CSV_MAX_COLUMNS];
+        scan_rows(f.bounds[r], f.bounds[r + 1], delimiter, num_fields,
+            [&](int k, const char *s, const char *e) {
+                double value;
+                bool escaped;
+                if (!seen[k] && (!unquote(&s, &e, &escaped) || escaped ||
+                            (e != s && !parse_double(s, e, &value)))) {
+                    seen[k] = true;
+                }
+            },
+            [](int) {});
+    }
+
+    schema->num_columns = num_fields;
+    for (int k = 0; k < num_fields; k++) {
+        int length = f.field_lengths[k] < CSV_NAME_LENGTH - 1 ? f.field_lengths[k] : CSV_NAME_LENGTH - 1;
+        memcpy(schema->names[k], f.field_names[k], length);
+        schema->names[k][length] = '\0';
+        schema->columns[k].name = schema->names[k];
+        schema->columns[k].type = CSV_DOUBLE;
+        for (int r = 0; r < threads; r++) {
+            if (strings[r * CSV_MAX_COLUMNS + k]) {
+                schema->columns[k].type = CSV_STRING;
+            }
+        }
+    }
+
+    delete[] strings;
+    csv_file_close(&f);
+    if (f.text != NULL) {
+        munmap((void *) f.text, f.size);
+    }
+}
+
+void csv_input_path(char *path, size_t size, const char *input_template, int scale_factor) {
+    char format[1024];
+    snprintf(format, sizeof(format), "%s%s", input_template[0] == '/' ? "" : "../../", input_template);
+    snprintf(path, size, format, scale_factor);
+}
@@ -0,0 +1,103 @@
+/**
+ * bench_csv.h
+ *
+ * Loader for the delimited text files produced by download-data.sh, with a
+ * header row naming the columns.
+ *
+ * Only the requested columns are extracted. Numeric fields are parsed into
+ * double columns; string fields are returned as pointers into the mapped
+ * file, so loading them copies nothing. Files are split at line boundaries
+ * and parsed by several threads.
+ *
+ * Fields may be quoted as in RFC 4180: a field that starts with a double
+ * quote ends at the matching quote, may contain delimiters and newlines, and
+ * writes a quote as two. The quotes are removed, and doubled quotes are
+ * unescaped in the file's private mapping, copying only the pages that have
+ * them. A quoted number is a number.
+ *
+ */
+
+#ifndef _BENCH_CSV_H_
+#define _BENCH_CSV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Most columns a table can extract.
+#define CSV_MAX_COLUMNS 32
+// Longest column name a schema keeps, with its terminator.
+#define CSV_NAME_LENGTH 64
+
+enum csv_type {
+    CSV_DOUBLE,
+    CSV_STRING,
+};
+
+// A column to extract.
+struct csv_column_spec {
+    const char *name;
+    enum csv_type type;
+};
+
+// A string field: its bytes in the mapped file, not NUL-terminated.
+struct csv_string {
+    const char *data;
+    int64_t length;
+};
+
+// The extracted columns of a file.
+struct csv_table {
+    int64_t num_rows;
+    int num_columns;
+    // One array per requested column: double values for CSV_DOUBLE, struct
+    // csv_string for CSV_STRING. Empty numeric fields are NaN.
+    void *columns[CSV_MAX_COLUMNS];
+    // The mapped file the strings point into.
+    void *text;
+    size_t size;
+};
+
+// The columns of a file and their inferred types.
+struct csv_schema {
+    int num_columns;
+    char names[CSV_MAX_COLUMNS][CSV_NAME_LENGTH];
+    // Specs naming the entries of names, as csv_load takes them.
+    struct csv_column_spec columns[CSV_MAX_COLUMNS];
+};
+
+/** Loads columns from a delimited text file.
+ *
+ * Exits the process if the file cannot be read, lacks a requested column or
+ * has a malformed field: a numeric field that is not a number, or a quoted
+ * field without its closing quote.
+ *
+ * @param path the file.
+ * @param delimiter the field separator, e.g. '|' or ','.
+ * @param columns the columns to extract, by header name.
+ * @param num_columns the number of columns.
+ * @param drop_missing if true, rows with an empty requested field are
+ * dropped, as pandas' dropna does.
+ * @param threads the number of threads parsing the file.
+ * @return the table, freed with csv_table_free.
+ */
+struct csv_table csv_load(const char *path, char delimiter,
+        const struct csv_column_spec *columns, int num_columns, bool drop_missing, int threads);
+
+/** Frees a table returned by csv_load. */
+void csv_table_free(struct csv_table *t);
+
+/** Returns the delimiter of a file: '|' if its header has one, else ','. */
+char csv_detect_delimiter(const char *path);
+
+/** Reads the first CSV_MAX_COLUMNS columns of a file's header and infers
+ * their types by scanning the whole file: a column is CSV_DOUBLE if every
+ * non-empty field parses as a number, else CSV_STRING. */
+void csv_infer_schema(const char *path, char delimiter, int threads, struct csv_schema *schema);
+
+/** Returns the path of an input file of the Python benchmarks: the template
+ * (e.g. "data/us_cities_states_counties_sf=%d.csv") filled in with the
+ * scale factor, relative to the repository root two levels up unless it is
+ * absolute. */
+void csv_input_path(char *path, size_t size, const char *input_template, int scale_factor);
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * bench_histogram.cpp
+ *
+ * Log-linear latency histogram.
+ *
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "bench_histogram.h"
+
+/** Returns the counter that value falls in. */
+static int index_of(uint64_t value) {
+    // Power-of-two range beyond the first 2 * HALF values, then the linear
+    // sub-bucket within it.
+    int msb = 63 - __builtin_clzll(value | 1);
+    int bucket = msb - (BENCH_HISTOGRAM_SUB_BITS - 1);
+    if (bucket < 0) {
+        bucket = 0;
+    }
+    return bucket * BENCH_HISTOGRAM_HALF + (int) (value >> bucket);
+}
+
+/** Returns the highest value that falls in counter index. */
+static uint64_t highest_of(int index) {
+    int bucket = index / BENCH_HISTOGRAM_HALF - 1;
+    if (bucket < 0) {
+        bucket = 0;
+    }
+    uint64_t sub = index - bucket * BENCH_HISTOGRAM_HALF;
+    return ((sub + 1) << bucket) - 1;
+}
+
+void bench_histogram_clear(struct bench_histogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void bench_histogram_record(struct bench_histogram *h, double seconds) {
+    uint64_t ns = seconds > 0.0 ? (uint64_t) llround(seconds * 1e9) : 0;
+    h->counts[index_of(ns)]++;
+    h->total++;
+    if (ns > h->max) {
+        h->max = ns;
+    }
+}
+
+void bench_histogram_merge(struct bench_histogram *dst, const struct bench_histogram *src) {
+    for (int i = 0; i < BENCH_HISTOGRAM_SIZE; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+double bench_histogram_percentile(const struct bench_histogram *h, double p) {
+    if (h->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t) ceil(p * h->total);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BENCH_HISTOGRAM_SIZE; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t value = highest_of(i);
+            return (value < h->max ? value : h->max) / 1e9;
+        }
+    }
+    return h->max / 1e9;
+}
+
+double bench_histogram_max(const struct bench_histogram *h) {
+    return h->max / 1e9;
+}
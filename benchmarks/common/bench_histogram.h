@@ -0,0 +1,46 @@
+/**
+ * bench_histogram.h
+ *
+ * A latency histogram in the style of HdrHistogram.
+ *
+ * Values are nanoseconds. Each power-of-two range of values is split into
+ * the same number of linear sub-buckets, so every recorded value is kept
+ * to within 1 / BENCH_HISTOGRAM_HALF (about 1.6%) of its magnitude while
+ * the histogram spans the whole 64-bit range in a few thousand counters.
+ *
+ */
+
+#ifndef _BENCH_HISTOGRAM_H_
+#define _BENCH_HISTOGRAM_H_
+
+#include <stdint.h>
+
+// Sub-buckets per power of two, as a power of two.
+#define BENCH_HISTOGRAM_SUB_BITS 7
+#define BENCH_HISTOGRAM_HALF (1 << (BENCH_HISTOGRAM_SUB_BITS - 1))
+#define BENCH_HISTOGRAM_SIZE ((64 - BENCH_HISTOGRAM_SUB_BITS + 2) * BENCH_HISTOGRAM_HALF)
+
+struct bench_histogram {
+    uint64_t counts[BENCH_HISTOGRAM_SIZE];
+    uint64_t total;
+    uint64_t max;
+};
+
+/** Empties a histogram. */
+void bench_histogram_clear(struct bench_histogram *h);
+
+/** Records one value, in seconds. */
+void bench_histogram_record(struct bench_histogram *h, double seconds);
+
+/** Adds the values recorded in src to dst. */
+void bench_histogram_merge(struct bench_histogram *dst, const struct bench_histogram *src);
+
+/** Returns the p-th percentile (0 < p <= 1) in seconds: the highest value
+ * that is equivalent, at the histogram's precision, to the value of that
+ * rank. Returns 0 if the histogram is empty. */
+double bench_histogram_percentile(const struct bench_histogram *h, double p);
+
+/** Returns the largest recorded value, in seconds. */
+double bench_histogram_max(const struct bench_histogram *h);
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * bench_memory.cpp
+ *
+ * Allocation counting wrappers and RSS sampling.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "bench_memory.h"
+
+#define MB (1024.0 * 1024.0)
+
+// glibc's allocator, which the wrappers below forward to.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<bool> tracking(false);
+// Bytes ever allocated, bytes currently allocated and the highest value of
+// live since the last bench_memory_begin.
+static std::atomic<uint64_t> allocated(0);
+static std::atomic<int64_t> live(0);
+static std::atomic<int64_t> peak_live(0);
+
+static void count_alloc(void *ptr) {
+    if (ptr == NULL || !tracking.load(std::memory_order_relaxed)) {
+        return;
+    }
+    size_t size = malloc_usable_size(ptr);
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    int64_t now = live.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = peak_live.load(std::memory_order_relaxed);
+    while (now > peak && !peak_live.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+static void count_free(void *ptr) {
+    if (ptr == NULL || !tracking.load(std::memory_order_relaxed)) {
+        return;
+    }
+    live.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void *calloc(size_t num, size_t size) {
+    void *ptr = __libc_calloc(num, size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    count_free(ptr);
+    void *result = __libc_realloc(ptr, size);
+    // On failure the old block is still allocated.
+    count_alloc(result != NULL || size == 0 ? result : ptr);
+    return result;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *ptr = memalign(alignment, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void free(void *ptr) {
+    count_free(ptr);
+    __libc_free(ptr);
+}
+
+}
+
+/** Resets VmHWM to the current RSS. Not supported before Linux 4.0. */
+static void reset_rss_peak() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        if (write(fd, "5", 1) != 1) {
+            // Left at the process-lifetime peak.
+        }
+        close(fd);
+    }
+}
+
+/** Returns VmHWM in bytes, or 0 if it cannot be read. Uses no heap memory,
+ * so reading it is not counted as an allocation. */
+static double rss_peak() {
+    char status[8192];
+    int fd = open("/proc/self/status", O_RDONLY);
+    if (fd < 0) {
+        return 0.0;
+    }
+    ssize_t n = read(fd, status, sizeof(status) - 1);
+    close(fd);
+    if (n <= 0) {
+        return 0.0;
+    }
+    status[n] = '\0';
+    const char *line = strstr(status, "VmHWM:");
+    return line != NULL ? strtod(line + strlen("VmHWM:"), NULL) * 1024.0 : 0.0;
+}
+
+void bench_memory_enable() {
+    tracking = true;
+}
+
+bool bench_memory_enabled() {
+    return tracking;
+}
+
+struct bench_memory_mark bench_memory_begin() {
+    struct bench_memory_mark mark;
+    mark.allocated = allocated;
+    mark.live = live;
+    peak_live = mark.live;
+    if (tracking) {
+        reset_rss_peak();
+    }
+    return mark;
+}
+
+struct bench_memory bench_memory_end(const struct bench_memory_mark *mark, double divisor) {
+    struct bench_memory m = bench_memory_none();
+    if (!tracking) {
+        return m;
+    }
+    m.valid = true;
+    m.allocated = (allocated - mark->allocated) / divisor;
+    m.heap_peak = (double) (peak_live - mark->live);
+    m.rss_peak = rss_peak();
+    return m;
+}
+
+struct bench_memory bench_memory_none() {
+    struct bench_memory m;
+    m.valid = false;
+    m.allocated = 0.0;
+    m.heap_peak = 0.0;
+    m.rss_peak = 0.0;
+    return m;
+}
+
+void bench_memory_add(struct bench_memory *total, const struct bench_memory *m, double divisor) {
+    if (!m->valid) {
+        return;
+    }
+    total->valid = true;
+    total->allocated += m->allocated / divisor;
+    if (m->heap_peak > total->heap_peak) {
+        total->heap_peak = m->heap_peak;
+    }
+    if (m->rss_peak > total->rss_peak) {
+        total->rss_peak = m->rss_peak;
+    }
+}
+
+void bench_memory_print(const struct bench_memory *m) {
+    if (!m->valid) {
+        return;
+    }
+    printf(" [allocated=%.1fMB heap-peak=%.1fMB rss-peak=%.1fMB]",
+            m->allocated / MB, m->heap_peak / MB, m->rss_peak / MB);
+}
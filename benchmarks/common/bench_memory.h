@@ -0,0 +1,63 @@
+/**
+ * bench_memory.h
+ *
+ * Memory use of timed phases: heap allocations and peak resident set size.
+ *
+ * Linking the harness replaces malloc and friends with wrappers around
+ * glibc's allocator, so allocations made by the benchmark, the C++ runtime
+ * and the Weld runtime are all seen. The wrappers only count while tracking
+ * is enabled; otherwise they forward directly.
+ *
+ */
+
+#ifndef _BENCH_MEMORY_H_
+#define _BENCH_MEMORY_H_
+
+#include <stdint.h>
+
+// Memory use of a phase, in bytes.
+struct bench_memory {
+    // Whether the phase was tracked.
+    bool valid;
+    // Bytes allocated, whether or not they were freed again.
+    double allocated;
+    // Highest heap use above the level at the start of the phase.
+    double heap_peak;
+    // Highest resident set size of the process (VmHWM) during the phase.
+    double rss_peak;
+};
+
+// The allocator state at the start of a phase.
+struct bench_memory_mark {
+    uint64_t allocated;
+    int64_t live;
+};
+
+/** Starts counting allocations. */
+void bench_memory_enable();
+
+/** Returns true if allocations are counted. */
+bool bench_memory_enabled();
+
+/** Starts a phase: resets the heap and RSS high-water marks. */
+struct bench_memory_mark bench_memory_begin();
+
+/** Ends a phase started with bench_memory_begin.
+ *
+ * @param mark the state returned by bench_memory_begin.
+ * @param divisor the number of repetitions the phase ran; allocated bytes
+ * are divided by it, peaks are not.
+ */
+struct bench_memory bench_memory_end(const struct bench_memory_mark *mark, double divisor);
+
+/** Returns an untracked bench_memory. */
+struct bench_memory bench_memory_none();
+
+/** Adds m->allocated / divisor to total and raises its peaks to m's. */
+void bench_memory_add(struct bench_memory *total, const struct bench_memory *m, double divisor);
+
+/** Prints " [allocated=...MB heap-peak=...MB rss-peak=...MB]" if m is valid,
+ * without a newline. */
+void bench_memory_print(const struct bench_memory *m);
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * bench_options.cpp
+ *
+ * Parsing of the options shared by all C++ benchmarks.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+
+#include "bench_options.h"
+#include "bench_memory.h"
+#include "bench_perf.h"
+
+struct bench_options bench_options_default() {
+    struct bench_options o;
+    o.reps = 1;
+    o.warmup = 0;
+    o.seed = 1;
+    const char *weld_threads = getenv("WELD_NUM_THREADS");
+    if (weld_threads != NULL && atoi(weld_threads) > 0) {
+        o.threads = atoi(weld_threads);
+    } else {
+        o.threads = omp_get_max_threads();
+    }
+    o.alloc = BENCH_ALLOC_MALLOC;
+    o.counters = false;
+    o.memory = false;
+    o.clients = 0;
+    o.queries = 100;
+    o.num_rates = 0;
+    o.num_chunk_sizes = 0;
+    o.read_depth = COLUMN_READER_DEFAULT_DEPTH;
+    o.reader = COLUMN_READER_IO_URING;
+    o.roofline = NULL;
+    o.bytes = 0.0;
+    o.traffic = BENCH_TRAFFIC_READ;
+    o.tolerance = BENCH_VERIFY_DEFAULT_TOLERANCE;
+    bench_alloc_set_policy(o.alloc);
+    bench_alloc_set_threads(o.threads);
+    return o;
+}
+
+bool bench_parse_option(struct bench_options *o, int ch, const char *arg) {
+    switch (ch) {
+        case 'r':
+            o->reps = atoi(arg);
+            if (o->reps < 1) {
+                fprintf(stderr, "-r must be at least 1");
+                exit(1);
+            }
+            return true;
+        case 'w':
+            o->warmup = atoi(arg);
+            if (o->warmup < 0) {
+                fprintf(stderr, "-w must not be negative");
+                exit(1);
+            }
+            return true;
+        case 't':
+            o->threads = atoi(arg);
+            if (o->threads < 1) {
+                fprintf(stderr, "-t must be at least 1");
+                exit(1);
+            }
+            bench_alloc_set_threads(o->threads);
+            return true;
+        case 'S':
+            o->seed = strtoull(arg, NULL, 10);
+            return true;
+        case 'a':
+            if (!bench_alloc_parse(arg, &o->alloc)) {
+                fprintf(stderr, "-a must be malloc, first-touch, interleave, thp or hugetlb");
+                exit(1);
+            }
+            bench_alloc_set_policy(o->alloc);
+            return true;
+        case 'P':
+            // Opened while parsing, before any worker threads exist.
+            o->counters = true;
+            bench_perf_open();
+            return true;
+        case 'R':
+            o->roofline = arg;
+            return true;
+        case 'M':
+            o->memory = true;
+            bench_memory_enable();
+            return true;
+        case 'K':
+            o->clients = atoi(arg);
+            if (o->clients < 1) {
+                fprintf(stderr, "-K must be at least 1");
+                exit(1);
+            }
+            return true;
+        case 'L': {
+            // A comma-separated list of rates.
+            o->num_rates = 0;
+            const char *p = arg;
+            while (*p != '\0') {
+                char *end;
+                double rate = strtod(p, &end);
+                if (end == p || rate <= 0.0 || o->num_rates == BENCH_MAX_RATES ||
+                        (*end != ',' && *end != '\0')) {
+                    fprintf(stderr, "-L must be a list of up to %d positive rates", BENCH_MAX_RATES);
+                    exit(1);
+                }
+                o->rates[o->num_rates++] = rate;
+                p = *end == ',' ? end + 1 : end;
+            }
+            return true;
+        }
+        case 'C': {
+            // A comma-separated list of chunk sizes.
+            o->num_chunk_sizes = 0;
+            const char *p = arg;
+            while (*p != '\0') {
+                char *end;
+                long long rows = strtoll(p, &end, 10);
+                if (end == p || rows < 1 || o->num_chunk_sizes == BENCH_MAX_CHUNK_SIZES ||
+                        (*end != ',' && *end != '\0')) {
+                    fprintf(stderr, "-C must be a list of up to %d positive chunk sizes",
+                            BENCH_MAX_CHUNK_SIZES);
+                    exit(1);
+                }
+                o->chunk_sizes[o->num_chunk_sizes++] = rows;
+                p = *end == ',' ? end + 1 : end;
+            }
+            return true;
+        }
+        case 'D':
+            o->read_depth = atoi(arg);
+            if (o->read_depth < 1) {
+                fprintf(stderr, "-D must be at least 1");
+                exit(1);
+            }
+            return true;
+        case 'B':
+            if (!column_reader_parse_backend(arg, &o->reader)) {
+                fprintf(stderr, "-B must be io_uring or pread");
+                exit(1);
+            }
+            return true;
+        case 'T':
+            o->tolerance = atof(arg);
+            if (o->tolerance < 0.0) {
+                fprintf(stderr, "-T must not be negative");
+                exit(1);
+            }
+            return true;
+        case 'Q':
+            o->queries = atoi(arg);
+            if (o->queries < 1) {
+                fprintf(stderr, "-Q must be at least 1");
+                exit(1);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
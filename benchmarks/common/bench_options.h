@@ -0,0 +1,89 @@
+/**
+ * bench_options.h
+ *
+ * Command-line options understood by every C++ benchmark, in addition to
+ * its own parameters.
+ *
+ */
+
+#ifndef _BENCH_OPTIONS_H_
+#define _BENCH_OPTIONS_H_
+
+#include <stdint.h>
+
+#include "bench_alloc.h"
+#include "bench_bandwidth.h"
+#include "bench_reader.h"
+#include "bench_verify.h"
+
+// Largest number of offered loads in one open-loop run.
+#define BENCH_MAX_RATES 32
+
+// Largest number of chunk sizes in one chunked run.
+#define BENCH_MAX_CHUNK_SIZES 32
+
+// getopt string for the shared options; append it to the benchmark's own.
+#define BENCH_OPTIONS "r:w:t:S:a:PR:MK:Q:L:C:D:B:T:"
+
+struct bench_options {
+    // Number of timed repetitions of each query kernel.
+    int reps;
+    // Number of untimed repetitions before the timed ones.
+    int warmup;
+    // Number of threads for the multi-threaded native baselines.
+    int threads;
+    // Seed of the generated input data.
+    uint64_t seed;
+    // Placement of the input columns.
+    enum bench_alloc_policy alloc;
+    // Whether to collect hardware performance counters.
+    bool counters;
+    // Whether to track allocations and peak RSS.
+    bool memory;
+    // Largest number of concurrent Weld clients in throughput mode, or 0 if
+    // throughput mode is off.
+    int clients;
+    // Timed queries each client issues in throughput mode, and requests
+    // issued at each offered load in open-loop mode.
+    int queries;
+    // Offered loads of the open-loop mode in queries per second; the mode
+    // is off if there are none.
+    double rates[BENCH_MAX_RATES];
+    int num_rates;
+    // Rows per chunk of the chunked mode, which streams generated input
+    // through the query instead of materializing it; off if there are none.
+    int64_t chunk_sizes[BENCH_MAX_CHUNK_SIZES];
+    int num_chunk_sizes;
+    // Blocks in flight and backend of the column reader, which chunked mode
+    // uses to scan a column file given with -m.
+    int read_depth;
+    enum column_reader_backend reader;
+    // File caching the bandwidth probe, "-" to probe without caching, or
+    // NULL if roofline reporting is off.
+    const char *roofline;
+    // Bytes each query moves to or from memory, or 0 if the benchmark does
+    // not report a roofline.
+    double bytes;
+    // The kind of traffic those bytes are.
+    enum bench_traffic traffic;
+    // Relative tolerance of floating-point result checks.
+    double tolerance;
+};
+
+/** Returns the default options: a single timed run, no warmup, seed 1, malloc
+ * placement, no roofline, an io_uring reader with four blocks in flight, the
+ * default result tolerance, and as many native threads as WELD_NUM_THREADS
+ * (or the OpenMP default if unset) so that native baselines run at the same
+ * core count as Weld. */
+struct bench_options bench_options_default();
+
+/** Handles one getopt result if it is a shared option.
+ *
+ * @param o the options to update.
+ * @param ch the option character returned by getopt.
+ * @param arg the option argument (optarg).
+ * @return true if ch was a shared option, false otherwise.
+ */
+bool bench_parse_option(struct bench_options *o, int ch, const char *arg);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * bench_parallel.h
+ *
+ * Helpers for the multi-threaded native baselines.
+ *
+ */
+
+#ifndef _BENCH_PARALLEL_H_
+#define _BENCH_PARALLEL_H_
+
+#include <stdint.h>
+#include <omp.h>
+
+/** Returns the start of the thread-th of num_threads contiguous ranges of [0, n). */
+inline int64_t bench_range_start(int64_t n, int thread, int num_threads) {
+    return n * thread / num_threads;
+}
+
+/** Calls f(start, end) on one contiguous range of [0, n) per thread. */
+template <typename F>
+void bench_parallel_for(int num_threads, int64_t n, F f) {
+#pragma omp parallel num_threads(num_threads)
+    {
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        f(bench_range_start(n, thread, threads),
+          bench_range_start(n, thread + 1, threads));
+    }
+}
+
+/** Sums f(start, end) over one contiguous range of [0, n) per thread. */
+template <typename T, typename F>
+T bench_parallel_sum(int num_threads, int64_t n, F f) {
+    T total = 0;
+#pragma omp parallel num_threads(num_threads) reduction(+:total)
+    {
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        total += f(bench_range_start(n, thread, threads),
+                   bench_range_start(n, thread + 1, threads));
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * bench_perf.cpp
+ *
+ * perf_event_open counters.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bench_perf.h"
+
+static const char *event_names[BENCH_PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "llc-misses", "branch-misses", "dtlb-misses"
+};
+
+static int fds[BENCH_PERF_NUM_EVENTS] = { -1, -1, -1, -1, -1 };
+
+/** Cache event config for read misses of the given cache. */
+static uint64_t cache_miss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    // Count threads created after this call too.
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void bench_perf_open() {
+    if (bench_perf_enabled()) {
+        return;
+    }
+    fds[BENCH_PERF_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[BENCH_PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[BENCH_PERF_LLC_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+    fds[BENCH_PERF_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[BENCH_PERF_DTLB_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB));
+    if (!bench_perf_enabled()) {
+        fprintf(stderr, "performance counters are unavailable\n");
+    }
+}
+
+bool bench_perf_enabled() {
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        if (fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void bench_perf_read(struct bench_counters *c) {
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        // The count, then the time the event was enabled and running.
+        uint64_t buf[3];
+        c->valid[i] = fds[i] >= 0 && read(fds[i], buf, sizeof(buf)) == sizeof(buf);
+        c->values[i] = 0.0;
+        if (c->valid[i] && buf[2] > 0) {
+            c->values[i] = (double) buf[0] * ((double) buf[1] / buf[2]);
+        }
+    }
+}
+
+struct bench_counters bench_counters_none() {
+    struct bench_counters c;
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        c.values[i] = 0.0;
+        c.valid[i] = false;
+    }
+    return c;
+}
+
+void bench_counters_add_delta(struct bench_counters *total, const struct bench_counters *before,
+        const struct bench_counters *after, double divisor) {
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        if (before->valid[i] && after->valid[i]) {
+            total->values[i] += (after->values[i] - before->values[i]) / divisor;
+            total->valid[i] = true;
+        }
+    }
+}
+
+void bench_counters_add(struct bench_counters *total, const struct bench_counters *c, double divisor) {
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        if (c->valid[i]) {
+            total->values[i] += c->values[i] / divisor;
+            total->valid[i] = true;
+        }
+    }
+}
+
+bool bench_counters_any(const struct bench_counters *c) {
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        if (c->valid[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void bench_counters_print(const struct bench_counters *c) {
+    if (!bench_counters_any(c)) {
+        return;
+    }
+    printf(" [");
+    const char *sep = "";
+    for (int i = 0; i < BENCH_PERF_NUM_EVENTS; i++) {
+        if (c->valid[i]) {
+            printf("%s%s=%.0f", sep, event_names[i], c->values[i]);
+            sep = " ";
+        }
+        if (i == BENCH_PERF_INSTRUCTIONS && c->valid[BENCH_PERF_CYCLES] &&
+                c->valid[BENCH_PERF_INSTRUCTIONS] && c->values[BENCH_PERF_CYCLES] > 0) {
+            printf(" ipc=%.2f", c->values[BENCH_PERF_INSTRUCTIONS] / c->values[BENCH_PERF_CYCLES]);
+        }
+    }
+    printf("]");
+}
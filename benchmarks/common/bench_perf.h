@@ -0,0 +1,61 @@
+/**
+ * bench_perf.h
+ *
+ * Hardware performance counters (perf_event_open) for timed phases.
+ *
+ * Counters are opened for the whole process and inherited by every thread
+ * it creates afterwards, so they include OpenMP and Weld worker threads as
+ * long as they are opened before those threads start. Each counter is
+ * optional: ones the CPU, kernel or perf_event_paranoid setting does not
+ * allow are skipped.
+ *
+ */
+
+#ifndef _BENCH_PERF_H_
+#define _BENCH_PERF_H_
+
+enum bench_perf_event {
+    BENCH_PERF_CYCLES,
+    BENCH_PERF_INSTRUCTIONS,
+    BENCH_PERF_LLC_MISSES,
+    BENCH_PERF_BRANCH_MISSES,
+    BENCH_PERF_DTLB_MISSES,
+    BENCH_PERF_NUM_EVENTS,
+};
+
+// Event counts, scaled for multiplexing.
+struct bench_counters {
+    double values[BENCH_PERF_NUM_EVENTS];
+    // Whether each value was counted.
+    bool valid[BENCH_PERF_NUM_EVENTS];
+};
+
+/** Opens the counters. Call before any threads are created.
+ *
+ * Prints a warning if no counter could be opened.
+ */
+void bench_perf_open();
+
+/** Returns true if at least one counter is open. */
+bool bench_perf_enabled();
+
+/** Reads the current counts of the open counters. */
+void bench_perf_read(struct bench_counters *c);
+
+/** Returns counters with no valid values. */
+struct bench_counters bench_counters_none();
+
+/** Adds (after - before) / divisor to each value of total counted in both. */
+void bench_counters_add_delta(struct bench_counters *total, const struct bench_counters *before,
+        const struct bench_counters *after, double divisor);
+
+/** Adds c / divisor to each value of total that is valid in c. */
+void bench_counters_add(struct bench_counters *total, const struct bench_counters *c, double divisor);
+
+/** Returns true if any value is valid. */
+bool bench_counters_any(const struct bench_counters *c);
+
+/** Prints the valid values as " [cycles=... ipc=...]", without a newline. */
+void bench_counters_print(const struct bench_counters *c);
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * bench_pipeline.h
+ *
+ * Chunked execution for inputs that are not materialized in memory.
+ *
+ * A producer thread fills fixed-size chunks of rows into a ring of buffer
+ * slots while the calling thread consumes the previous ones, so reading or
+ * generating the input overlaps with running the query on it.
+ *
+ */
+
+#ifndef _BENCH_PIPELINE_H_
+#define _BENCH_PIPELINE_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bench_timing.h"
+
+// Buffer slots in the ring: two, for double buffering.
+#define BENCH_PIPELINE_SLOTS 2
+
+/** Runs produce and consume over the rows [0, num_rows) in chunks.
+ *
+ * produce(slot, start, end) fills buffer slot with rows [start, end) on a
+ * producer thread; consume(slot, start, end) then processes them on the
+ * calling thread. Chunks are consumed in order, and a slot is refilled only
+ * after its previous chunk has been consumed.
+ *
+ * @param num_rows the number of input rows.
+ * @param chunk_rows the number of rows per chunk.
+ * @param stall if not NULL, receives the time the consumer spent waiting
+ * for the producer, in seconds.
+ */
+template <typename P, typename C>
+void bench_pipeline(int64_t num_rows, int64_t chunk_rows, P produce, C consume,
+        double *stall = NULL) {
+    int64_t num_chunks = (num_rows + chunk_rows - 1) / chunk_rows;
+    std::mutex lock;
+    std::condition_variable changed;
+    // The chunk each slot holds, or -1 if it is free.
+    int64_t filled[BENCH_PIPELINE_SLOTS];
+    for (int s = 0; s < BENCH_PIPELINE_SLOTS; s++) {
+        filled[s] = -1;
+    }
+
+    std::thread producer([&] {
+        for (int64_t k = 0; k < num_chunks; k++) {
+            int slot = k % BENCH_PIPELINE_SLOTS;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return filled[slot] == -1; });
+            }
+            int64_t start = k * chunk_rows;
+            produce(slot, start, start + chunk_rows < num_rows ? start + chunk_rows : num_rows);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                filled[slot] = k;
+            }
+            changed.notify_all();
+        }
+    });
+
+    double waited = 0.0;
+    for (int64_t k = 0; k < num_chunks; k++) {
+        int slot = k % BENCH_PIPELINE_SLOTS;
+        double wait_start = bench_now();
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return filled[slot] == k; });
+        }
+        waited += bench_now() - wait_start;
+        int64_t start = k * chunk_rows;
+        consume(slot, start, start + chunk_rows < num_rows ? start + chunk_rows : num_rows);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            filled[slot] = -1;
+        }
+        changed.notify_all();
+    }
+    producer.join();
+
+    if (stall != NULL) {
+        *stall = waited;
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * bench_random.cpp
+ *
+ * Zipf sampling for the benchmark data generators.
+ *
+ */
+
+#include <math.h>
+
+#include "bench_random.h"
+
+/** log1p(x) / x, accurate near 0. */
+static double helper1(double x) {
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+/** expm1(x) / x, accurate near 0. */
+static double helper2(double x) {
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+/** The integral of h(x) = 1 / x^exponent, up to a constant. */
+static double h_integral(double x, double exponent) {
+    double log_x = log(x);
+    return helper2((1.0 - exponent) * log_x) * log_x;
+}
+
+static double h(double x, double exponent) {
+    return exp(-exponent * log(x));
+}
+
+static double h_integral_inverse(double x, double exponent) {
+    double t = x * (1.0 - exponent);
+    if (t < -1.0) {
+        // Limit inaccuracies at the upper end of the range.
+        t = -1.0;
+    }
+    return exp(helper1(t) * x);
+}
+
+struct bench_zipf bench_zipf_make(int64_t num_values, double exponent) {
+    struct bench_zipf z;
+    z.num_values = num_values;
+    z.exponent = exponent;
+    z.h_integral_x1 = h_integral(1.5, exponent) - 1.0;
+    z.h_integral_num_values = h_integral(num_values + 0.5, exponent);
+    z.s = 2.0 - h_integral_inverse(h_integral(2.5, exponent) - h(2.0, exponent), exponent);
+    return z;
+}
+
+int64_t bench_zipf_sample(const struct bench_zipf *z, uint64_t r) {
+    if (z->exponent <= 0.0) {
+        return bench_random_uniform<int64_t>(r, 1, z->num_values);
+    }
+    while (true) {
+        double u = z->h_integral_num_values +
+            bench_random_unit(r) * (z->h_integral_x1 - z->h_integral_num_values);
+        double x = h_integral_inverse(u, z->exponent);
+        int64_t k = (int64_t) (x + 0.5);
+        if (k < 1) {
+            k = 1;
+        } else if (k > z->num_values) {
+            k = z->num_values;
+        }
+        if (k - x <= z->s || u >= h_integral(k + 0.5, z->exponent) - h(k, z->exponent)) {
+            return k;
+        }
+        // Rejected: derive the next draw from this one, so the sample still
+        // depends only on the initial random value.
+        r = bench_mix64(r + 0x9e3779b97f4a7c15ULL);
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * bench_random.h
+ *
+ * Deterministic, parallel generation of benchmark input columns.
+ *
+ * Values come from a counter-based generator: the value at index i of a
+ * column is a hash of the seed, the column's stream number and i. Columns
+ * are therefore filled in parallel chunks, and the output depends only on
+ * the seed, never on the number of threads or how the range is split.
+ *
+ */
+
+#ifndef _BENCH_RANDOM_H_
+#define _BENCH_RANDOM_H_
+
+#include <stdint.h>
+#include <type_traits>
+#include <omp.h>
+
+#include "bench_parallel.h"
+
+// Selects an independent random sequence: one stream per generated column.
+struct bench_rng {
+    uint64_t seed;
+    uint64_t stream;
+};
+
+inline struct bench_rng bench_rng_make(uint64_t seed, uint64_t stream) {
+    struct bench_rng rng;
+    rng.seed = seed;
+    rng.stream = stream;
+    return rng;
+}
+
+/** The splitmix64 output function. */
+inline uint64_t bench_mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/** Returns the random value at the given index of rng's sequence. */
+inline uint64_t bench_random(struct bench_rng rng, uint64_t index) {
+    uint64_t key = bench_mix64(rng.seed * 0x9e3779b97f4a7c15ULL + rng.stream);
+    return bench_mix64(key + (index + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+/** Maps a random value to a double in [0, 1). */
+inline double bench_random_unit(uint64_t r) {
+    return (r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/** Maps a random value to an integer in [lo, hi]. */
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value, T>::type
+bench_random_uniform(uint64_t r, T lo, T hi) {
+    uint64_t range = (uint64_t) hi - (uint64_t) lo + 1;
+    if (range == 0) {
+        return (T) r;
+    }
+    return (T) ((uint64_t) lo + (uint64_t) (((unsigned __int128) r * range) >> 64));
+}
+
+/** Maps a random value to a floating-point number in [lo, hi). */
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value, T>::type
+bench_random_uniform(uint64_t r, T lo, T hi) {
+    return lo + (T) (bench_random_unit(r) * (hi - lo));
+}
+
+/** Sets out[i] = f(r) for each i in [0, n), where r is the random value at
+ * index first + i of rng's sequence. Runs on all OpenMP threads.
+ *
+ * first is the index of out[0] in the whole column, so that a column can be
+ * generated in chunks that match the column generated at once. */
+template <typename T, typename F>
+void bench_generate(T *out, int64_t n, struct bench_rng rng, F f, int64_t first = 0) {
+    bench_parallel_for(omp_get_max_threads(), n, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            out[i] = f(bench_random(rng, first + i));
+        }
+    });
+}
+
+/** Fills a column with values drawn uniformly from [lo, hi] for integer
+ * types and [lo, hi) for floating-point types. */
+template <typename T>
+void bench_fill_uniform(T *out, int64_t n, T lo, T hi, struct bench_rng rng, int64_t first = 0) {
+    bench_generate(out, n, rng, [=](uint64_t r) {
+        return bench_random_uniform(r, lo, hi);
+    }, first);
+}
+
+/** Fills a column for a predicate with a fixed selectivity: each value is
+ * pass with probability prob and fail otherwise. */
+template <typename T>
+void bench_fill_selectivity(T *out, int64_t n, double prob, T pass, T fail, struct bench_rng rng,
+        int64_t first = 0) {
+    bench_generate(out, n, rng, [=](uint64_t r) {
+        return bench_random_unit(r) < prob ? pass : fail;
+    }, first);
+}
+
+// A Zipf distribution over the ranks 1..num_values, sampled with
+// rejection-inversion (Hormann and Derflinger, 1996).
+struct bench_zipf {
+    int64_t num_values;
+    double exponent;
+    double h_integral_x1;
+    double h_integral_num_values;
+    double s;
+};
+
+/** Prepares a Zipf distribution in which rank k has weight 1 / k^exponent.
+ * An exponent of 0 gives a uniform distribution. */
+struct bench_zipf bench_zipf_make(int64_t num_values, double exponent);
+
+/** Maps a random value to a Zipf-distributed rank in [1, num_values]. */
+int64_t bench_zipf_sample(const struct bench_zipf *z, uint64_t r);
+
+/** Fills a column with Zipf-distributed ranks in [1, num_values]. Rank 1 is
+ * the most frequent value. */
+template <typename T>
+void bench_fill_zipf(T *out, int64_t n, int64_t num_values, double exponent, struct bench_rng rng,
+        int64_t first = 0) {
+    struct bench_zipf z = bench_zipf_make(num_values, exponent);
+    bench_generate(out, n, rng, [&](uint64_t r) {
+        return (T) bench_zipf_sample(&z, r);
+    }, first);
+}
+
+#endif
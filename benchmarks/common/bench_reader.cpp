@@ -0,0 +1,486 @@
+/**
+ * bench_reader.cpp
+ *
+ * Prefetching block reader for column files, over io_uring or pread.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bench_reader.h"
+#include "bench_timing.h"
+
+// A read of one column of one block.
+struct request {
+    int column;
+    uint64_t offset;
+    size_t length;
+    // Bytes read so far; short reads are resubmitted for the rest.
+    size_t done;
+    struct iovec iov;
+};
+
+// Buffers for one block in flight.
+struct slot {
+    void *buffers[COLUMN_READER_MAX_COLUMNS];
+    // The block the slot holds or is reading, or -1 if it is free.
+    int64_t block;
+    // Column reads of the block that have not completed.
+    int pending;
+};
+
+// The memory-mapped submission and completion queues of an io_uring.
+struct ring {
+    int fd;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+struct column_reader {
+    int fd;
+    bool direct;
+    enum column_reader_backend backend;
+
+    int num_columns;
+    uint64_t offsets[COLUMN_READER_MAX_COLUMNS];
+    size_t elem_sizes[COLUMN_READER_MAX_COLUMNS];
+    int64_t num_rows;
+    int64_t block_rows;
+    int64_t num_blocks;
+
+    int depth;
+    struct slot *slots;
+    // One request per column of each slot.
+    struct request *requests;
+    // The next block to start reading and the next to return.
+    int64_t next_read;
+    int64_t next_return;
+    // Time spent waiting in column_reader_next.
+    double stall;
+
+    struct ring ring;
+
+    // The pread backend's reading thread.
+    std::thread *worker;
+    std::mutex lock;
+    std::condition_variable changed;
+    bool stopping;
+};
+
+static size_t align_up(size_t n) {
+    return (n + COLUMN_FILE_ALIGN - 1) / COLUMN_FILE_ALIGN * COLUMN_FILE_ALIGN;
+}
+
+static void read_failed(int error) {
+    fprintf(stderr, "could not read column file: %s\n", strerror(error));
+    exit(1);
+}
+
+/** Sets up the request for column c of the block in slot s. */
+static struct request *prepare(struct column_reader *r, int s, int c) {
+    struct request *q = &r->requests[s * r->num_columns + c];
+    int64_t start = r->slots[s].block * r->block_rows;
+    int64_t rows = r->num_rows - start < r->block_rows ? r->num_rows - start : r->block_rows;
+    q->column = c;
+    q->offset = r->offsets[c] + start * r->elem_sizes[c];
+    q->length = rows * r->elem_sizes[c];
+    if (r->direct) {
+        // The file is padded, so whole pages past the last row are there to read.
+        q->length = align_up(q->length);
+    }
+    q->done = 0;
+    return q;
+}
+
+/* io_uring, driven with raw system calls. */
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/** Creates a ring with room for entries reads. Returns false if io_uring
+ * is not available. */
+static bool ring_open(struct ring *ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = io_uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        return false;
+    }
+
+    ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_map = MAP_FAILED;
+    if (ring->sq_map != MAP_FAILED) {
+        ring->cq_map = (p.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_map :
+            mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) MAP_FAILED;
+    if (ring->cq_map != MAP_FAILED) {
+        ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    }
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) {
+            munmap(ring->cq_map, ring->cq_map_size);
+        }
+        if (ring->sq_map != MAP_FAILED) {
+            munmap(ring->sq_map, ring->sq_map_size);
+        }
+        close(ring->fd);
+        return false;
+    }
+
+    char *sq = (char *) ring->sq_map;
+    char *cq = (char *) ring->cq_map;
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return true;
+}
+
+static void ring_close(struct ring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    munmap(ring->sq_map, ring->sq_map_size);
+    close(ring->fd);
+}
+
+/** Queues the rest of request q. Takes effect at the next ring_submit. */
+static void ring_queue(struct column_reader *r, struct request *q, void *buffer) {
+    struct ring *ring = &r->ring;
+    q->iov.iov_base = (char *) buffer + q->done;
+    q->iov.iov_len = q->length - q->done;
+
+    // Only this thread writes the tail; the kernel reads it after the release.
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = r->fd;
+    sqe->off = q->offset + q->done;
+    sqe->addr = (uint64_t) (uintptr_t) &q->iov;
+    sqe->len = 1;
+    sqe->user_data = q - r->requests;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void ring_submit(struct column_reader *r, unsigned count) {
+    while (count > 0) {
+        int submitted = io_uring_enter(r->ring.fd, count, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            read_failed(errno);
+        }
+        count -= submitted;
+    }
+}
+
+/** Starts reading the next block into slot s. */
+static void ring_start(struct column_reader *r, int s) {
+    r->slots[s].block = r->next_read++;
+    r->slots[s].pending = r->num_columns;
+    for (int c = 0; c < r->num_columns; c++) {
+        ring_queue(r, prepare(r, s, c), r->slots[s].buffers[c]);
+    }
+    ring_submit(r, r->num_columns);
+}
+
+/** Waits for at least one read to complete and processes all completed
+ * ones, resubmitting the rest of short reads. */
+static void ring_complete(struct column_reader *r) {
+    struct ring *ring = &r->ring;
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        if (io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            read_failed(errno);
+        }
+    }
+
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned resubmitted = 0;
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        struct request *q = &r->requests[cqe->user_data];
+        int s = (int) (cqe->user_data / r->num_columns);
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            ring_queue(r, q, r->slots[s].buffers[q->column]);
+            resubmitted++;
+        } else if (cqe->res < 0) {
+            read_failed(-cqe->res);
+        } else if (cqe->res == 0) {
+            read_failed(EIO);
+        } else if ((q->done += cqe->res) < q->length) {
+            ring_queue(r, q, r->slots[s].buffers[q->column]);
+            resubmitted++;
+        } else {
+            r->slots[s].pending--;
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    ring_submit(r, resubmitted);
+}
+
+/* pread, on a thread that reads ahead of the caller. */
+
+static void read_fully(struct column_reader *r, struct request *q, void *buffer) {
+    while (q->done < q->length) {
+        ssize_t n = pread(r->fd, (char *) buffer + q->done, q->length - q->done, q->offset + q->done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            read_failed(n < 0 ? errno : EIO);
+        }
+        q->done += n;
+    }
+}
+
+static void pread_worker(struct column_reader *r) {
+    while (true) {
+        std::unique_lock<std::mutex> guard(r->lock);
+        if (r->next_read == r->num_blocks) {
+            return;
+        }
+        int s = r->next_read % r->depth;
+        r->changed.wait(guard, [&] { return r->stopping || r->slots[s].block == -1; });
+        if (r->stopping) {
+            return;
+        }
+        r->slots[s].block = r->next_read++;
+        r->slots[s].pending = r->num_columns;
+        guard.unlock();
+
+        for (int c = 0; c < r->num_columns; c++) {
+            read_fully(r, prepare(r, s, c), r->slots[s].buffers[c]);
+        }
+
+        guard.lock();
+        r->slots[s].pending = 0;
+        r->changed.notify_all();
+    }
+}
+
+/* The reader. */
+
+struct column_reader *column_reader_open(const char *path, const char *key,
+        const struct column_reader_column *columns, int num_columns,
+        int64_t block_rows, int depth, enum column_reader_backend backend) {
+    if (num_columns < 1 || num_columns > COLUMN_READER_MAX_COLUMNS || block_rows < 1 || depth < 1) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct column_reader *r = new struct column_reader();
+    r->num_columns = num_columns;
+    for (int c = 0; c < num_columns; c++) {
+        if (!column_file_locate(fd, key, columns[c].name, columns[c].type, &r->offsets[c], &r->num_rows)) {
+            close(fd);
+            delete r;
+            return NULL;
+        }
+        r->elem_sizes[c] = column_elem_size(columns[c].type);
+    }
+    // Drop cached pages, including ones just written, so the scan is cold.
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    // The header is not aligned for O_DIRECT, so only the columns are read
+    // through a direct descriptor.
+    int direct_fd = open(path, O_RDONLY | O_DIRECT);
+    if (direct_fd >= 0) {
+        close(fd);
+        fd = direct_fd;
+    }
+    r->fd = fd;
+    r->direct = direct_fd >= 0;
+
+    r->block_rows = r->direct ? align_up(block_rows) : block_rows;
+    r->num_blocks = (r->num_rows + r->block_rows - 1) / r->block_rows;
+    r->depth = depth;
+    r->slots = new struct slot[depth];
+    r->requests = new struct request[depth * num_columns];
+    for (int s = 0; s < depth; s++) {
+        for (int c = 0; c < num_columns; c++) {
+            size_t bytes = align_up(r->block_rows * r->elem_sizes[c]);
+            if (posix_memalign(&r->slots[s].buffers[c], COLUMN_FILE_ALIGN, bytes) != 0) {
+                fprintf(stderr, "could not allocate %zu bytes\n", bytes);
+                exit(1);
+            }
+        }
+        r->slots[s].block = -1;
+        r->slots[s].pending = 0;
+    }
+    r->next_read = 0;
+    r->next_return = 0;
+    r->stall = 0.0;
+    r->worker = NULL;
+    r->stopping = false;
+
+    r->backend = COLUMN_READER_PREAD;
+    if (backend == COLUMN_READER_IO_URING && ring_open(&r->ring, depth * num_columns)) {
+        r->backend = COLUMN_READER_IO_URING;
+        for (int s = 0; s < depth && r->next_read < r->num_blocks; s++) {
+            ring_start(r, s);
+        }
+    } else {
+        r->worker = new std::thread(pread_worker, r);
+    }
+    return r;
+}
+
+bool column_reader_next(struct column_reader *r, struct column_block *block) {
+    if (r->next_return == r->num_blocks) {
+        return false;
+    }
+    int s = r->next_return % r->depth;
+    double wait_start = bench_now();
+    if (r->backend == COLUMN_READER_IO_URING) {
+        while (r->slots[s].pending > 0) {
+            ring_complete(r);
+        }
+    } else {
+        std::unique_lock<std::mutex> guard(r->lock);
+        r->changed.wait(guard, [&] {
+            return r->slots[s].block == r->next_return && r->slots[s].pending == 0;
+        });
+    }
+    r->stall += bench_now() - wait_start;
+
+    block->start = r->next_return * r->block_rows;
+    block->rows = r->num_rows - block->start < r->block_rows ? r->num_rows - block->start : r->block_rows;
+    block->bytes = 0;
+    for (int c = 0; c < r->num_columns; c++) {
+        block->columns[c] = r->slots[s].buffers[c];
+        block->bytes += r->requests[s * r->num_columns + c].length;
+    }
+    r->next_return++;
+    return true;
+}
+
+void column_reader_release(struct column_reader *r, const struct column_block *block) {
+    int s = (block->start / r->block_rows) % r->depth;
+    if (r->backend == COLUMN_READER_IO_URING) {
+        r->slots[s].block = -1;
+        if (r->next_read < r->num_blocks) {
+            ring_start(r, s);
+        }
+    } else {
+        std::lock_guard<std::mutex> guard(r->lock);
+        r->slots[s].block = -1;
+        r->changed.notify_all();
+    }
+}
+
+void column_reader_close(struct column_reader *r) {
+    if (r->backend == COLUMN_READER_IO_URING) {
+        // Buffers may not be freed while the kernel still writes to them.
+        for (int s = 0; s < r->depth; s++) {
+            while (r->slots[s].block != -1 && r->slots[s].pending > 0) {
+                ring_complete(r);
+            }
+        }
+        ring_close(&r->ring);
+    } else {
+        {
+            std::lock_guard<std::mutex> guard(r->lock);
+            r->stopping = true;
+        }
+        r->changed.notify_all();
+        r->worker->join();
+        delete r->worker;
+    }
+    for (int s = 0; s < r->depth; s++) {
+        for (int c = 0; c < r->num_columns; c++) {
+            free(r->slots[s].buffers[c]);
+        }
+    }
+    delete[] r->slots;
+    delete[] r->requests;
+    close(r->fd);
+    delete r;
+}
+
+int64_t column_reader_num_rows(const struct column_reader *r) {
+    return r->num_rows;
+}
+
+int64_t column_reader_block_rows(const struct column_reader *r) {
+    return r->block_rows;
+}
+
+int64_t column_reader_num_blocks(const struct column_reader *r) {
+    return r->num_blocks;
+}
+
+double column_reader_stall(const struct column_reader *r) {
+    return r->stall;
+}
+
+const char *column_reader_backend_name(const struct column_reader *r) {
+    if (r->backend == COLUMN_READER_IO_URING) {
+        return r->direct ? "io_uring+direct" : "io_uring";
+    }
+    return r->direct ? "pread+direct" : "pread";
+}
+
+bool column_reader_parse_backend(const char *name, enum column_reader_backend *backend) {
+    if (strcmp(name, "io_uring") == 0) {
+        *backend = COLUMN_READER_IO_URING;
+    } else if (strcmp(name, "pread") == 0) {
+        *backend = COLUMN_READER_PREAD;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+/**
+ * bench_reader.h
+ *
+ * Prefetching block reader for column files.
+ *
+ * The reader splits the rows of a column file into blocks and keeps up to
+ * `depth` blocks in flight, so the query runs on one block while the next
+ * ones are read from disk. Each block is read straight into aligned buffers
+ * and handed to the caller in place, without a copy.
+ *
+ * Reads go through io_uring where the kernel supports it, or through pread
+ * on a background thread otherwise. Files are opened with O_DIRECT where the
+ * file system allows, and evicted from the page cache when opened, so every
+ * scan reads from the device.
+ *
+ */
+
+#ifndef _BENCH_READER_H_
+#define _BENCH_READER_H_
+
+#include <stdint.h>
+
+#include "bench_columns.h"
+
+// Most columns a reader reads.
+#define COLUMN_READER_MAX_COLUMNS 16
+// Default number of blocks in flight.
+#define COLUMN_READER_DEFAULT_DEPTH 4
+
+enum column_reader_backend {
+    COLUMN_READER_IO_URING,
+    COLUMN_READER_PREAD,
+};
+
+// A column to read.
+struct column_reader_column {
+    const char *name;
+    enum column_type type;
+};
+
+// A block of rows returned by column_reader_next.
+struct column_block {
+    // Index of the first row and number of rows.
+    int64_t start;
+    int64_t rows;
+    // The values of each column, in the order given to column_reader_open.
+    void *columns[COLUMN_READER_MAX_COLUMNS];
+    // Bytes read for the block.
+    int64_t bytes;
+};
+
+struct column_reader;
+
+/** Opens a column file for reading in blocks and starts reading the first
+ * ones.
+ *
+ * @param path the column file.
+ * @param key the parameters the caller needs the data generated with.
+ * @param columns the columns to read.
+ * @param num_columns the number of columns.
+ * @param block_rows the number of rows per block; rounded up to a multiple
+ * of COLUMN_FILE_ALIGN for O_DIRECT.
+ * @param depth the number of blocks in flight.
+ * @param backend the preferred backend; falls back to pread if io_uring is
+ * not available.
+ * @return the reader, or NULL if the file is not a valid column file for
+ * key or lacks one of the columns.
+ */
+struct column_reader *column_reader_open(const char *path, const char *key,
+        const struct column_reader_column *columns, int num_columns,
+        int64_t block_rows, int depth, enum column_reader_backend backend);
+
+/** Waits for the next block, in row order. Returns false after the last
+ * block. The block's buffers stay valid until column_reader_release. */
+bool column_reader_next(struct column_reader *r, struct column_block *block);
+
+/** Returns a block's buffers to the reader, which reuses them for the next
+ * block to read. Blocks must be released in the order they were returned. */
+void column_reader_release(struct column_reader *r, const struct column_block *block);
+
+/** Closes a reader, waiting for any reads still in flight. */
+void column_reader_close(struct column_reader *r);
+
+/** Returns the number of rows in the file. */
+int64_t column_reader_num_rows(const struct column_reader *r);
+
+/** Returns the number of rows per block. */
+int64_t column_reader_block_rows(const struct column_reader *r);
+
+/** Returns the number of blocks the file is read in. */
+int64_t column_reader_num_blocks(const struct column_reader *r);
+
+/** Returns the time spent in column_reader_next waiting for blocks to be
+ * read, in seconds. */
+double column_reader_stall(const struct column_reader *r);
+
+/** Returns the backend in use, e.g. "io_uring+direct" or "pread". */
+const char *column_reader_backend_name(const struct column_reader *r);
+
+/** Parses a backend name ("io_uring" or "pread"). Returns false if the name
+ * is unknown. */
+bool column_reader_parse_backend(const char *name, enum column_reader_backend *backend);
+
+/** Passes every block of r to consume(block) in order, releasing each one
+ * after it is consumed.
+ *
+ * @return the number of bytes read.
+ */
+template <typename C>
+int64_t bench_scan(struct column_reader *r, C consume) {
+    struct column_block block;
+    int64_t bytes = 0;
+    while (column_reader_next(r, &block)) {
+        consume(&block);
+        bytes += block.bytes;
+        column_reader_release(r, &block);
+    }
+    return bytes;
+}
+
+#endif
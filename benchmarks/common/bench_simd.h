@@ -0,0 +1,43 @@
+/**
+ * bench_simd.h
+ *
+ * AVX2 helpers for the explicitly vectorized native baselines. Kernels that
+ * use them are only built when the compiler targets AVX2 (-march=native on a
+ * machine that has it).
+ *
+ */
+
+#ifndef _BENCH_SIMD_H_
+#define _BENCH_SIMD_H_
+
+#ifdef __AVX2__
+
+#include <stdint.h>
+#include <immintrin.h>
+
+/** Horizontal sum of eight 32-bit integers, wrapping on overflow. */
+inline int32_t bench_hsum_epi32(__m256i v) {
+    __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+/** Horizontal sum of eight floats. */
+inline float bench_hsum_ps(__m256 v) {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_movehdup_ps(x));
+    return _mm_cvtss_f32(x);
+}
+
+/** Horizontal sum of four doubles. */
+inline double bench_hsum_pd(__m256d v) {
+    __m128d x = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    x = _mm_add_sd(x, _mm_unpackhi_pd(x, x));
+    return _mm_cvtsd_f64(x);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * bench_timing.cpp
+ *
+ * Timers, summary statistics and timing output.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#include "bench_alloc.h"
+#include "bench_bandwidth.h"
+#include "bench_timing.h"
+
+// Seconds before a deadline at which bench_sleep_until stops sleeping and spins.
+#define SLEEP_SPIN_MARGIN 200e-6
+
+double bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void bench_sleep_until(double deadline) {
+    // Sleep to shortly before the deadline, then spin: timer wakeups can be
+    // tens of microseconds late.
+    double wake = deadline - SLEEP_SPIN_MARGIN;
+    if (wake > bench_now()) {
+        struct timespec t;
+        t.tv_sec = (time_t) wake;
+        t.tv_nsec = (long) ((wake - t.tv_sec) * 1e9);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+        }
+    }
+    while (bench_now() < deadline) {
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *((const double *) a);
+    double y = *((const double *) b);
+    return (x > y) - (x < y);
+}
+
+double bench_percentile(const double *sorted, int n, double p) {
+    int rank = (int) ceil(p * n);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+struct bench_stats bench_stats_compute(double *times, int num_times) {
+    qsort(times, num_times, sizeof(double), compare_doubles);
+
+    struct bench_stats stats;
+    stats.reps = num_times;
+    stats.min = times[0];
+    if (num_times % 2 == 1) {
+        stats.median = times[num_times / 2];
+    } else {
+        stats.median = (times[num_times / 2 - 1] + times[num_times / 2]) / 2;
+    }
+    stats.p95 = bench_percentile(times, num_times, 0.95);
+
+    double sum = 0.0;
+    for (int i = 0; i < num_times; i++) {
+        sum += times[i];
+    }
+    stats.mean = sum / num_times;
+
+    double sq = 0.0;
+    for (int i = 0; i < num_times; i++) {
+        sq += (times[i] - stats.mean) * (times[i] - stats.mean);
+    }
+    stats.stddev = sqrt(sq / num_times);
+    stats.counters = bench_counters_none();
+    stats.memory = bench_memory_none();
+    stats.bytes = 0.0;
+    stats.peak = 0.0;
+    return stats;
+}
+
+void bench_stats_set_traffic(struct bench_stats *stats, const struct bench_options *o) {
+    if (o->roofline == NULL || o->bytes <= 0.0) {
+        return;
+    }
+    const char *path = strcmp(o->roofline, "-") == 0 ? NULL : o->roofline;
+    struct bench_bandwidth peak = bench_bandwidth_peak(path, o->threads);
+    stats->bytes = o->bytes;
+    stats->peak = o->traffic == BENCH_TRAFFIC_COPY ? peak.copy : peak.read;
+}
+
+/** Prints "<scheme>: <seconds>" followed by the formatted metadata. */
+static void report_line(const char *scheme, double seconds,
+        const char *fmt, va_list ap) {
+    printf("%s: %.9f", scheme, seconds);
+    if (fmt != NULL) {
+        printf(" ");
+        vprintf(fmt, ap);
+    }
+}
+
+void bench_report(const char *scheme, double seconds, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    report_line(scheme, seconds, fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+void bench_report_stats(const char *scheme, const struct bench_stats *stats,
+        const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    report_line(scheme, stats->median, fmt, ap);
+    va_end(ap);
+    if (stats->reps > 1) {
+        printf(" [reps=%d min=%.9f median=%.9f p95=%.9f stddev=%.9f]",
+                stats->reps, stats->min, stats->median, stats->p95, stats->stddev);
+    }
+    bench_counters_print(&stats->counters);
+    bench_memory_print(&stats->memory);
+    if (stats->bytes > 0.0) {
+        bench_bandwidth_print(stats->bytes, stats->median, stats->peak);
+    }
+    if (bench_alloc_is_placed()) {
+        printf(" [alloc=%s]", bench_alloc_policy_name());
+    }
+    printf("\n");
+}
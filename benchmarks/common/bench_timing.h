@@ -0,0 +1,160 @@
+/**
+ * bench_timing.h
+ *
+ * Timers, repeated trials and summary statistics for the C++ benchmarks.
+ *
+ */
+
+#ifndef _BENCH_TIMING_H_
+#define _BENCH_TIMING_H_
+
+#include "bench_memory.h"
+#include "bench_options.h"
+#include "bench_perf.h"
+
+// Summary of the timed repetitions of one scheme.
+struct bench_stats {
+    int reps;
+    double min;
+    double median;
+    double p95;
+    double mean;
+    double stddev;
+    // Mean event counts per timed repetition, if counters are open.
+    struct bench_counters counters;
+    // Memory use of the timed repetitions, if tracked.
+    struct bench_memory memory;
+    // Bytes moved per repetition and the peak bandwidth for that traffic in
+    // GB/s, if the roofline is reported.
+    double bytes;
+    double peak;
+};
+
+/** Returns a CLOCK_MONOTONIC timestamp in seconds, with nanosecond resolution. */
+double bench_now();
+
+/** Sleeps until bench_now() reaches deadline; returns at once if it has. */
+void bench_sleep_until(double deadline);
+
+/** Times a single call of f, returning the elapsed time in seconds. */
+template <typename F>
+double bench_time(F f) {
+    double start = bench_now();
+    f();
+    return bench_now() - start;
+}
+
+/** Returns the nearest-rank p-th percentile (0 < p <= 1) of n sorted values. */
+double bench_percentile(const double *sorted, int n, double p);
+
+/** Summarizes num_times measurements. The array is sorted in place. */
+struct bench_stats bench_stats_compute(double *times, int num_times);
+
+/** Attaches the bytes a query moves and the matching peak bandwidth to
+ * stats, if o enables roofline reporting and the benchmark sets o->bytes. */
+void bench_stats_set_traffic(struct bench_stats *stats, const struct bench_options *o);
+
+/** Runs f o->warmup times untimed, then o->reps times timed.
+ *
+ * f is called with no arguments and should run exactly one query, including
+ * any per-query setup that the scheme would pay in practice.
+ */
+template <typename F>
+struct bench_stats bench_trials(const struct bench_options *o, F f) {
+    for (int i = 0; i < o->warmup; i++) {
+        f();
+    }
+    double *times = new double[o->reps];
+    struct bench_counters before, after;
+    struct bench_memory_mark mark = bench_memory_begin();
+    bench_perf_read(&before);
+    for (int i = 0; i < o->reps; i++) {
+        times[i] = bench_time(f);
+    }
+    bench_perf_read(&after);
+    struct bench_memory memory = bench_memory_end(&mark, o->reps);
+    struct bench_stats stats = bench_stats_compute(times, o->reps);
+    bench_counters_add_delta(&stats.counters, &before, &after, o->reps);
+    stats.memory = memory;
+    bench_stats_set_traffic(&stats, o);
+    delete[] times;
+    return stats;
+}
+
+/** Runs f like bench_trials, but calls setup untimed before every run of f,
+ * for per-query state that should not be measured, such as zeroing the
+ * arrays a scheme aggregates into. Event counts exclude setup too, and the
+ * memory use counts from the end of the first timed run's setup.
+ */
+template <typename S, typename F>
+struct bench_stats bench_trials_setup(const struct bench_options *o, S setup, F f) {
+    for (int i = 0; i < o->warmup; i++) {
+        setup();
+        f();
+    }
+    double *times = new double[o->reps];
+    struct bench_counters counters = bench_counters_none();
+    struct bench_counters before, after;
+    setup();
+    struct bench_memory_mark mark = bench_memory_begin();
+    for (int i = 0; i < o->reps; i++) {
+        if (i > 0) {
+            setup();
+        }
+        bench_perf_read(&before);
+        times[i] = bench_time(f);
+        bench_perf_read(&after);
+        bench_counters_add_delta(&counters, &before, &after, o->reps);
+    }
+    struct bench_memory memory = bench_memory_end(&mark, o->reps);
+    struct bench_stats stats = bench_stats_compute(times, o->reps);
+    stats.counters = counters;
+    stats.memory = memory;
+    bench_stats_set_traffic(&stats, o);
+    delete[] times;
+    return stats;
+}
+
+/** Runs a scheme that returns an allocated output like bench_trials, but
+ * releases each output outside the timed region, so that no repetition pays
+ * for freeing the previous one's and each starts from the same heap.
+ *
+ * @param output receives the output of the last timed repetition, which the
+ * caller checks and releases.
+ * @param f runs one query and returns its output.
+ * @param release frees one output of f.
+ */
+template <typename T, typename F, typename R>
+struct bench_stats bench_trials_output(const struct bench_options *o, T *output, F f, R release) {
+    bool have_output = false;
+    return bench_trials_setup(o, [&] {
+        if (have_output) {
+            release(*output);
+        }
+    }, [&] {
+        *output = f();
+        have_output = true;
+    });
+}
+
+/** Prints a timing line in the `<scheme>: <time> <metadata>` format.
+ *
+ * @param scheme the experiment description.
+ * @param seconds the measured time.
+ * @param fmt printf-style format for the trailing metadata, or NULL.
+ */
+void bench_report(const char *scheme, double seconds, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/** Prints a timing line for repeated trials.
+ *
+ * The reported time is the median; min, p95 and stddev follow the metadata
+ * when more than one repetition was timed, then the event counts if
+ * counters are open, the memory use if it is tracked, and the achieved
+ * bandwidth if the roofline is reported.
+ */
+void bench_report_stats(const char *scheme, const struct bench_stats *stats,
+        const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * bench_verify.cpp
+ *
+ * Result checks shared by the C++ benchmarks.
+ *
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <atomic>
+
+#include "bench_verify.h"
+
+// Number of failed checks so far.
+static std::atomic<int> failures(0);
+
+void bench_verify_fail(const char *scheme, const char *fmt, ...) {
+    failures++;
+    fprintf(stderr, "Mismatch in %s: ", scheme);
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+}
+
+bool bench_verify_int(const char *scheme, const char *what, int64_t expected, int64_t actual) {
+    if (expected != actual) {
+        bench_verify_fail(scheme, "%s expected %lld, got %lld",
+                what, (long long) expected, (long long) actual);
+        return false;
+    }
+    return true;
+}
+
+bool bench_verify_double(const char *scheme, const char *what, double expected, double actual,
+        double tolerance) {
+    if (expected == actual || (isnan(expected) && isnan(actual))) {
+        return true;
+    }
+    double scale = fmax(fabs(expected), fabs(actual));
+    // Written so that a NaN on either side fails.
+    if (!(fabs(actual - expected) <= tolerance * scale)) {
+        bench_verify_fail(scheme, "%s expected %.17g, got %.17g (tolerance %g)",
+                what, expected, actual, tolerance);
+        return false;
+    }
+    return true;
+}
+
+int bench_verify_status() {
+    return failures > 0 ? BENCH_VERIFY_FAILED : 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * bench_verify.h
+ *
+ * Checks that every scheme of a benchmark computes the same answer as its
+ * reference scheme, usually the single-threaded C++ one.
+ *
+ * A failed check prints a "Mismatch" line on stderr, keeping stdout in the
+ * timing-line format, and is remembered: benchmarks return
+ * bench_verify_status() from main, so a run that produced a wrong answer
+ * exits nonzero and run_benchmarks.py records it.
+ *
+ */
+
+#ifndef _BENCH_VERIFY_H_
+#define _BENCH_VERIFY_H_
+
+#include <stdint.h>
+
+// Exit status of a run in which a check failed.
+#define BENCH_VERIFY_FAILED 2
+// Default relative tolerance of floating-point checks.
+#define BENCH_VERIFY_DEFAULT_TOLERANCE 1e-6
+
+/** Records a failed check of scheme and prints the formatted reason. */
+void bench_verify_fail(const char *scheme, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/** Checks an integer result exactly.
+ *
+ * @param scheme the scheme that produced actual.
+ * @param what names the value in the mismatch line, e.g. "result".
+ * @return true if the values are equal.
+ */
+bool bench_verify_int(const char *scheme, const char *what, int64_t expected, int64_t actual);
+
+/** Checks a floating-point result to a relative tolerance: the values match
+ * if they differ by at most tolerance times the larger magnitude, or are
+ * both NaN. */
+bool bench_verify_double(const char *scheme, const char *what, double expected, double actual,
+        double tolerance);
+
+/** Checks n values exactly, reporting the first that differs and how many
+ * do. T must convert to long long. */
+template <typename T>
+bool bench_verify_array(const char *scheme, const char *what, const T *expected, const T *actual,
+        int64_t n) {
+    int64_t first = -1;
+    int64_t differ = 0;
+    for (int64_t i = 0; i < n; i++) {
+        if (expected[i] != actual[i]) {
+            if (first < 0) {
+                first = i;
+            }
+            differ++;
+        }
+    }
+    if (differ > 0) {
+        bench_verify_fail(scheme, "%s[%lld] expected %lld, got %lld (%lld of %lld values differ)",
+                what, (long long) first, (long long) expected[first], (long long) actual[first],
+                (long long) differ, (long long) n);
+    }
+    return differ == 0;
+}
+
+/** Returns the exit status of the run so far: 0 if every check passed,
+ * BENCH_VERIFY_FAILED otherwise. */
+int bench_verify_status();
+
+#endif
@@ -0,0 +1,342 @@
+/**
+ * tpch_lineitem.cpp
+ *
+ * dbgen-format lineitem loader and generator, and synthetic lineitem
+ * columns.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench_alloc.h"
+#include "bench_random.h"
+#include "tpch_lineitem.h"
+
+// Dates from the TPC-H specification, as days since 1970-01-01.
+#define STARTDATE_YEAR 1992
+#define ENDDATE_YEAR 1998
+// CURRENTDATE is 1995-06-17.
+#define CURRENTDATE_Y 1995
+#define CURRENTDATE_M 6
+#define CURRENTDATE_D 17
+
+/** Days since 1970-01-01 of a proleptic Gregorian date. */
+static int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/** Inverse of days_from_civil. */
+static void civil_from_days(int64_t z, int *year, int *month, int *day) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = (int) (doy - (153 * mp + 2) / 5 + 1);
+    *month = (int) (mp < 10 ? mp + 3 : mp - 9);
+    *year = (int) (yoe + era * 400 + (*month <= 2));
+}
+
+static void malformed(const char *path, int64_t row) {
+    fprintf(stderr, "%s: malformed lineitem row %lld\n", path, (long long) row);
+    exit(1);
+}
+
+/** Advances p past the next '|' and returns false if the row ends first. */
+static bool skip_field(const char **p, const char *end) {
+    const char *s = *p;
+    while (s < end && *s != '|' && *s != '\n') {
+        s++;
+    }
+    if (s >= end || *s != '|') {
+        return false;
+    }
+    *p = s + 1;
+    return true;
+}
+
+/** Parses a decimal such as "-1234.56" terminated by '|'. */
+static bool parse_decimal(const char **p, const char *end, double *out) {
+    const char *s = *p;
+    bool negative = false;
+    if (s < end && *s == '-') {
+        negative = true;
+        s++;
+    }
+    int64_t whole = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        whole = whole * 10 + (*s - '0');
+        s++;
+    }
+    int64_t frac = 0;
+    int64_t scale = 1;
+    if (s < end && *s == '.') {
+        s++;
+        while (s < end && *s >= '0' && *s <= '9') {
+            frac = frac * 10 + (*s - '0');
+            scale *= 10;
+            s++;
+        }
+    }
+    double value = whole + (double) frac / scale;
+    *out = negative ? -value : value;
+    *p = s;
+    return skip_field(p, end);
+}
+
+/** Parses a YYYY-MM-DD date terminated by '|' into a yyyymmdd integer. */
+static bool parse_date(const char **p, const char *end, int32_t *out) {
+    const char *s = *p;
+    if (end - s < 11 || s[4] != '-' || s[7] != '-') {
+        return false;
+    }
+    int32_t y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    int32_t m = (s[5] - '0') * 10 + (s[6] - '0');
+    int32_t d = (s[8] - '0') * 10 + (s[9] - '0');
+    *out = y * 10000 + m * 100 + d;
+    *p = s + 10;
+    return skip_field(p, end);
+}
+
+/** Parses a single-character field terminated by '|'. */
+static bool parse_char(const char **p, const char *end, char *out) {
+    if (*p >= end) {
+        return false;
+    }
+    *out = **p;
+    (*p)++;
+    return skip_field(p, end);
+}
+
+struct lineitem_columns lineitem_load(const char *path) {
+    FILE *fptr = fopen(path, "r");
+    if (fptr == NULL) {
+        fprintf(stderr, "could not open %s\n", path);
+        exit(1);
+    }
+    fseek(fptr, 0, SEEK_END);
+    long size = ftell(fptr);
+    rewind(fptr);
+    char *buf = (char *) malloc(size + 1);
+    size_t read = fread(buf, 1, size, fptr);
+    fclose(fptr);
+    const char *end = buf + read;
+
+    int64_t rows = 0;
+    for (const char *s = buf; s < end; s++) {
+        rows += (*s == '\n');
+    }
+    if (read > 0 && end[-1] != '\n') {
+        rows++;
+    }
+
+    struct lineitem_columns c;
+    c.return_flags = (int8_t *) bench_alloc(sizeof(int8_t) * rows);
+    c.line_statuses = (int8_t *) bench_alloc(sizeof(int8_t) * rows);
+    c.quantities = (double *) bench_alloc(sizeof(double) * rows);
+    c.extended_prices = (double *) bench_alloc(sizeof(double) * rows);
+    c.discounts = (double *) bench_alloc(sizeof(double) * rows);
+    c.taxes = (double *) bench_alloc(sizeof(double) * rows);
+    c.shipdates = (int32_t *) bench_alloc(sizeof(int32_t) * rows);
+
+    const char *p = buf;
+    int64_t i = 0;
+    while (p < end) {
+        if (*p == '\n') {
+            // Blank line.
+            p++;
+            continue;
+        }
+        // l_orderkey, l_partkey, l_suppkey, l_linenumber.
+        for (int f = 0; f < 4; f++) {
+            if (!skip_field(&p, end)) {
+                malformed(path, i);
+            }
+        }
+        char return_flag, line_status;
+        if (!parse_decimal(&p, end, &c.quantities[i]) ||
+                !parse_decimal(&p, end, &c.extended_prices[i]) ||
+                !parse_decimal(&p, end, &c.discounts[i]) ||
+                !parse_decimal(&p, end, &c.taxes[i]) ||
+                !parse_char(&p, end, &return_flag) ||
+                !parse_char(&p, end, &line_status) ||
+                !parse_date(&p, end, &c.shipdates[i])) {
+            malformed(path, i);
+        }
+        switch (return_flag) {
+            case 'A': c.return_flags[i] = RETURNFLAG_A; break;
+            case 'N': c.return_flags[i] = RETURNFLAG_N; break;
+            case 'R': c.return_flags[i] = RETURNFLAG_R; break;
+            default: malformed(path, i);
+        }
+        switch (line_status) {
+            case 'F': c.line_statuses[i] = LINESTATUS_F; break;
+            case 'O': c.line_statuses[i] = LINESTATUS_O; break;
+            default: malformed(path, i);
+        }
+        // The remaining fields are not queried.
+        while (p < end && *p != '\n') {
+            p++;
+        }
+        p++;
+        i++;
+    }
+    c.num_items = i;
+    free(buf);
+    return c;
+}
+
+void lineitem_columns_free(struct lineitem_columns *c) {
+    bench_free(c->return_flags);
+    bench_free(c->line_statuses);
+    bench_free(c->quantities);
+    bench_free(c->extended_prices);
+    bench_free(c->discounts);
+    bench_free(c->taxes);
+    bench_free(c->shipdates);
+}
+
+void synthetic_lineitems_alloc(struct synthetic_lineitems *items, int64_t num_items) {
+    items->return_flags = (int8_t *) bench_alloc(sizeof(int8_t) * num_items);
+    items->line_statuses = (int8_t *) bench_alloc(sizeof(int8_t) * num_items);
+    items->quantities = (float *) bench_alloc(sizeof(float) * num_items);
+    items->extended_prices = (float *) bench_alloc(sizeof(float) * num_items);
+    items->discounts = (float *) bench_alloc(sizeof(float) * num_items);
+    items->shipdates = (int32_t *) bench_alloc(sizeof(int32_t) * num_items);
+    items->taxes = (float *) bench_alloc(sizeof(float) * num_items);
+}
+
+void synthetic_lineitems_free(struct synthetic_lineitems *items) {
+    bench_free(items->return_flags);
+    bench_free(items->line_statuses);
+    bench_free(items->quantities);
+    bench_free(items->extended_prices);
+    bench_free(items->discounts);
+    bench_free(items->shipdates);
+    bench_free(items->taxes);
+}
+
+void synthetic_lineitems_generate(struct synthetic_lineitems *items, int64_t first, int64_t n,
+        float prob, int32_t pass, uint64_t seed) {
+    bench_fill_selectivity<int32_t>(items->shipdates, n, prob, pass, pass + 1,
+            bench_rng_make(seed, 0), first);
+    bench_fill_uniform<int8_t>(items->return_flags, n, RETURNFLAG_A, RETURNFLAG_R,
+            bench_rng_make(seed, 1), first);
+    bench_fill_uniform<int8_t>(items->line_statuses, n, LINESTATUS_F, LINESTATUS_O,
+            bench_rng_make(seed, 2), first);
+    bench_generate(items->quantities, n, bench_rng_make(seed, 3), [](uint64_t r) {
+        return (float) bench_random_uniform(r, 1, 50);
+    }, first);
+    bench_fill_uniform<float>(items->extended_prices, n, 900.0f, 105000.0f,
+            bench_rng_make(seed, 4), first);
+    bench_generate(items->discounts, n, bench_rng_make(seed, 5), [](uint64_t r) {
+        return bench_random_uniform(r, 0, 10) / 100.0f;
+    }, first);
+    bench_generate(items->taxes, n, bench_rng_make(seed, 6), [](uint64_t r) {
+        return bench_random_uniform(r, 0, 8) / 100.0f;
+    }, first);
+}
+
+/** splitmix64 step, used as the generator's random stream. */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/** Uniform integer in [lo, hi]. */
+static int64_t uniform(uint64_t *state, int64_t lo, int64_t hi) {
+    return lo + (int64_t) (next_random(state) % (uint64_t) (hi - lo + 1));
+}
+
+static void format_date(char *out, int64_t days) {
+    int y, m, d;
+    civil_from_days(days, &y, &m, &d);
+    sprintf(out, "%04d-%02d-%02d", y, m, d);
+}
+
+void lineitem_generate(const char *path, double scale_factor) {
+    static const char *instructs[] = {
+        "DELIVER IN PERSON", "COLLECT COD", "NONE", "TAKE BACK RETURN"
+    };
+    static const char *modes[] = {
+        "REG AIR", "AIR", "RAIL", "SHIP", "TRUCK", "MAIL", "FOB"
+    };
+    static const char *words[] = {
+        "furiously", "quickly", "carefully", "blithely", "slyly", "regular",
+        "final", "express", "pending", "ironic", "special", "bold", "even",
+        "deposits", "requests", "accounts", "packages", "theodolites", "pinto",
+        "beans", "foxes", "instructions", "dependencies", "excuses", "sleep",
+        "wake", "haggle", "nag", "cajole", "boost", "detect", "integrate"
+    };
+    const int num_words = sizeof(words) / sizeof(words[0]);
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "could not create %s\n", path);
+        exit(1);
+    }
+
+    const int64_t num_orders = (int64_t) (1500000 * scale_factor);
+    const int64_t num_parts = (int64_t) (200000 * scale_factor);
+    const int64_t num_suppliers = (int64_t) (10000 * scale_factor) > 0 ?
+        (int64_t) (10000 * scale_factor) : 1;
+    const int64_t startdate = days_from_civil(STARTDATE_YEAR, 1, 1);
+    const int64_t enddate = days_from_civil(ENDDATE_YEAR, 12, 31);
+    const int64_t currentdate = days_from_civil(CURRENTDATE_Y, CURRENTDATE_M, CURRENTDATE_D);
+
+    uint64_t state = 1;
+    char shipdate[11], commitdate[11], receiptdate[11], comment[128];
+    for (int64_t o = 0; o < num_orders; o++) {
+        // Order keys are sparse: the first 8 of every 32 are used.
+        int64_t orderkey = (o / 8) * 32 + (o % 8) + 1;
+        int64_t orderdate = uniform(&state, startdate, enddate - 151);
+        int lines = (int) uniform(&state, 1, 7);
+        for (int line = 1; line <= lines; line++) {
+            int64_t partkey = uniform(&state, 1, num_parts > 0 ? num_parts : 1);
+            int64_t supp_index = uniform(&state, 0, 3);
+            int64_t suppkey = (partkey + supp_index * (num_suppliers / 4 +
+                        (partkey - 1) / num_suppliers)) % num_suppliers + 1;
+            int64_t quantity = uniform(&state, 1, 50);
+            // P_RETAILPRICE in cents.
+            int64_t retail = 90000 + ((partkey / 10) % 20001) + 100 * (partkey % 1000);
+            int64_t extended = quantity * retail;
+            int64_t discount = uniform(&state, 0, 10);
+            int64_t tax = uniform(&state, 0, 8);
+
+            int64_t ship = orderdate + uniform(&state, 1, 121);
+            int64_t commit = orderdate + uniform(&state, 30, 90);
+            int64_t receipt = ship + uniform(&state, 1, 30);
+            char return_flag = receipt <= currentdate ?
+                (uniform(&state, 0, 1) ? 'R' : 'A') : 'N';
+            char line_status = ship > currentdate ? 'O' : 'F';
+            format_date(shipdate, ship);
+            format_date(commitdate, commit);
+            format_date(receiptdate, receipt);
+
+            int comment_len = 0;
+            int num_comment_words = (int) uniform(&state, 2, 5);
+            for (int w = 0; w < num_comment_words; w++) {
+                const char *word = words[uniform(&state, 0, num_words - 1)];
+                comment_len += sprintf(comment + comment_len, w == 0 ? "%s" : " %s", word);
+            }
+
+            fprintf(out, "%lld|%lld|%lld|%d|%lld|%lld.%02lld|0.%02lld|0.%02lld|%c|%c|%s|%s|%s|%s|%s|%s|\n",
+                    (long long) orderkey, (long long) partkey, (long long) suppkey, line,
+                    (long long) quantity, (long long) (extended / 100), (long long) (extended % 100),
+                    (long long) discount, (long long) tax, return_flag, line_status,
+                    shipdate, commitdate, receiptdate,
+                    instructs[uniform(&state, 0, 3)], modes[uniform(&state, 0, 6)], comment);
+        }
+    }
+    fclose(out);
+}
@@ -0,0 +1,94 @@
+/**
+ * tpch_lineitem.h
+ *
+ * Loader for TPC-H lineitem tables in dbgen's pipe-delimited `.tbl` format,
+ * a built-in generator that writes such tables at a given scale factor, and
+ * the synthetic lineitem columns that tpch_q1 and sort generate in memory.
+ *
+ */
+
+#ifndef _TPCH_LINEITEM_H_
+#define _TPCH_LINEITEM_H_
+
+#include <stdint.h>
+
+// Codes used for the l_returnflag column.
+#define RETURNFLAG_A 0
+#define RETURNFLAG_N 1
+#define RETURNFLAG_R 2
+
+// Codes used for the l_linestatus column.
+#define LINESTATUS_F 0
+#define LINESTATUS_O 1
+
+// The lineitem columns the benchmarks query, one array per column.
+struct lineitem_columns {
+    int64_t num_items;
+    // l_returnflag as RETURNFLAG_* codes.
+    int8_t *return_flags;
+    // l_linestatus as LINESTATUS_* codes.
+    int8_t *line_statuses;
+    double *quantities;
+    double *extended_prices;
+    double *discounts;
+    double *taxes;
+    // l_shipdate as a yyyymmdd integer, e.g. 19980901.
+    int32_t *shipdates;
+};
+
+// Synthetic lineitem columns, in the types tpch_q1 queries.
+struct synthetic_lineitems {
+    int8_t *return_flags;
+    int8_t *line_statuses;
+    float *quantities;
+    float *extended_prices;
+    float *discounts;
+    int32_t *shipdates;
+    float *taxes;
+};
+
+/** Allocates the columns of num_items line items with bench_alloc. */
+void synthetic_lineitems_alloc(struct synthetic_lineitems *items, int64_t num_items);
+
+/** Frees columns allocated with synthetic_lineitems_alloc. */
+void synthetic_lineitems_free(struct synthetic_lineitems *items);
+
+/** Generates rows [first, first + n) of synthetic columns into items.
+ *
+ * Each column is drawn from its own random stream, so a row depends only on
+ * seed and its index, and rows generated in chunks match rows generated at
+ * once. Shipdates are pass with probability prob and pass + 1 otherwise;
+ * flags and statuses use the codes above; quantities are uniform over 1 to
+ * 50, extended prices over 900 to 105000, discounts over 0 to 0.1 and taxes
+ * over 0 to 0.08.
+ */
+void synthetic_lineitems_generate(struct synthetic_lineitems *items, int64_t first, int64_t n,
+        float prob, int32_t pass, uint64_t seed);
+
+/** Parses a dbgen-format lineitem table.
+ *
+ * Exits the process if the file cannot be read or a row is malformed.
+ *
+ * @param path the path of the lineitem.tbl file.
+ * @return the parsed columns, allocated with bench_alloc and freed with
+ * lineitem_columns_free.
+ */
+struct lineitem_columns lineitem_load(const char *path);
+
+/** Frees the columns returned by lineitem_load. */
+void lineitem_columns_free(struct lineitem_columns *c);
+
+/** Writes a lineitem table at the given scale factor.
+ *
+ * Rows follow the value distributions of the TPC-H specification (clause
+ * 4.2.3): 1,500,000 * scale_factor orders of 1 to 7 lineitems each, with
+ * quantities, prices, discounts, taxes and dates drawn and derived as dbgen
+ * does. The random streams differ from dbgen's, so the rows are not
+ * byte-identical to a dbgen table of the same scale factor.
+ *
+ * @param path the file to write.
+ * @param scale_factor the TPC-H scale factor.
+ */
+void lineitem_generate(const char *path, double scale_factor);
+
+#endif
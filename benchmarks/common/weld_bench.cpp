@@ -0,0 +1,116 @@
+/**
+ * weld_bench.cpp
+ *
+ * Implementation of the shared benchmark harness.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "weld_bench.h"
+
+/** Reads a whole file into a NUL-terminated buffer. */
+static char *read_program(const char *filename) {
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL) {
+        printf("Error message: could not open %s\n", filename);
+        exit(1);
+    }
+    fseek(fptr, 0, SEEK_END);
+    long string_size = ftell(fptr);
+    rewind(fptr);
+    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
+    size_t read = fread(program, sizeof(char), string_size, fptr);
+    program[read] = '\0';
+    fclose(fptr);
+    return program;
+}
+
+/** Prints the error and exits if e is set. */
+static void check_error(weld_error_t e) {
+    if (weld_error_code(e)) {
+        const char *err = weld_error_message(e);
+        printf("Error message: %s\n", err);
+        exit(1);
+    }
+}
+
+struct weld_bench_module weld_bench_compile(const char *filename) {
+    char *program = read_program(filename);
+
+    struct weld_bench_module m;
+    weld_error_t e = weld_error_new();
+    weld_conf_t conf = weld_conf_new();
+    double compile_time = bench_time([&] {
+        m.module = weld_module_compile(program, conf, e);
+    });
+    bench_report("Weld compile time (cold)", compile_time, NULL);
+    check_error(e);
+
+    // The same program again, once the process has paid for initializing
+    // the compiler. The run script starts a fresh process per trial, so
+    // every trial pays the cold time.
+    weld_module_t warm = NULL;
+    compile_time = bench_time([&] {
+        warm = weld_module_compile(program, conf, e);
+    });
+    bench_report("Weld compile time (warm)", compile_time, NULL);
+    check_error(e);
+    weld_module_free(warm);
+
+    weld_conf_free(conf);
+    weld_error_free(e);
+    free(program);
+    return m;
+}
+
+void weld_bench_module_free(struct weld_bench_module *m) {
+    weld_module_free(m->module);
+    m->module = NULL;
+}
+
+void weld_bench_marshal(struct weld_bench_run_state *s, void *args) {
+    s->error = weld_error_new();
+    s->args = weld_value_new(args);
+    s->conf = weld_conf_new();
+    s->result = NULL;
+}
+
+void weld_bench_execute(struct weld_bench_module *m, struct weld_bench_run_state *s) {
+    s->result = weld_module_run(m->module, s->conf, s->args, s->error);
+    check_error(s->error);
+}
+
+void weld_bench_teardown(struct weld_bench_run_state *s) {
+    weld_value_free(s->result);
+    weld_value_free(s->args);
+    weld_conf_free(s->conf);
+    weld_error_free(s->error);
+}
+
+void weld_bench_report_phases(const struct bench_options *o,
+        const struct weld_bench_phases *phases, int num_runs) {
+    const char *names[] = {
+        "Weld marshal", "Weld execute", "Weld decode", "Weld teardown"
+    };
+    double *times = new double[num_runs];
+    for (int p = 0; p < 4; p++) {
+        for (int i = 0; i < num_runs; i++) {
+            const double fields[] = {
+                phases[i].marshal, phases[i].execute, phases[i].decode, phases[i].teardown
+            };
+            times[i] = fields[p];
+        }
+        struct bench_stats stats = bench_stats_compute(times, num_runs);
+        if (p == 1) {
+            for (int i = 0; i < num_runs; i++) {
+                bench_counters_add(&stats.counters, &phases[i].execute_counters, num_runs);
+                bench_memory_add(&stats.memory, &phases[i].execute_memory, num_runs);
+            }
+            bench_stats_set_traffic(&stats, o);
+        }
+        bench_report_stats(names[p], &stats, NULL);
+    }
+    delete[] times;
+}
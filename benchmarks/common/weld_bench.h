@@ -0,0 +1,352 @@
+/**
+ * weld_bench.h
+ *
+ * Shared harness for the C++ benchmarks: loads and compiles Weld programs,
+ * marshals arguments, runs compiled modules and reports timings.
+ *
+ */
+
+#ifndef _WELD_BENCH_H_
+#define _WELD_BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "weld.h"
+
+#include "bench_alloc.h"
+#include "bench_histogram.h"
+#include "bench_options.h"
+#include "bench_parallel.h"
+#include "bench_pipeline.h"
+#include "bench_random.h"
+#include "bench_simd.h"
+#include "bench_timing.h"
+
+// A vector as laid out by the Weld runtime.
+template <typename T>
+struct weld_vector {
+    T *data;
+    int64_t length;
+};
+
+template <typename T>
+weld_vector<T> make_weld_vector(T *data, int64_t length) {
+    struct weld_vector<T> vector;
+    vector.data = data;
+    vector.length = length;
+    return vector;
+}
+
+// A compiled Weld program.
+struct weld_bench_module {
+    weld_module_t module;
+};
+
+/** Reads and compiles a Weld program, printing its compile time.
+ *
+ * The program is compiled a second time and that module freed, so that a
+ * "Weld compile time (warm)" line follows the "Weld compile time (cold)"
+ * line of the first compile in the process.
+ *
+ * Exits the process if the file cannot be read or compilation fails.
+ *
+ * @param filename the path of the .weld file.
+ * @return the compiled module.
+ */
+struct weld_bench_module weld_bench_compile(const char *filename);
+
+/** Frees a module returned by weld_bench_compile. */
+void weld_bench_module_free(struct weld_bench_module *m);
+
+// State of one in-flight Weld run.
+struct weld_bench_run_state {
+    weld_value_t args;
+    weld_conf_t conf;
+    weld_error_t error;
+    weld_value_t result;
+};
+
+// Time spent in each phase of one Weld run, in seconds.
+struct weld_bench_phases {
+    // weld_value_new and configuration setup.
+    double marshal;
+    // weld_module_run.
+    double execute;
+    // Extracting the result from the returned value.
+    double decode;
+    // Freeing the result, arguments, configuration and error.
+    double teardown;
+    // Event counts of weld_module_run, if counters are open.
+    struct bench_counters execute_counters;
+    // Memory use of weld_module_run, if tracked.
+    struct bench_memory execute_memory;
+};
+
+/** Wraps args in a Weld value and prepares a configuration for a run. */
+void weld_bench_marshal(struct weld_bench_run_state *s, void *args);
+
+/** Runs a compiled module on marshalled arguments.
+ *
+ * Exits the process if the run fails.
+ */
+void weld_bench_execute(struct weld_bench_module *m, struct weld_bench_run_state *s);
+
+/** Frees everything held by a run, including its result. */
+void weld_bench_teardown(struct weld_bench_run_state *s);
+
+/** Runs a compiled module and decodes its result.
+ *
+ * @param m the compiled module.
+ * @param args a pointer to the argument struct, laid out as Weld expects.
+ * @param decode called with the result data; its return value is returned.
+ * @param phases if not NULL, receives the time spent in each phase.
+ */
+template <typename R, typename D>
+R weld_bench_run(struct weld_bench_module *m, void *args, D decode,
+        struct weld_bench_phases *phases = NULL) {
+    struct weld_bench_run_state s;
+    double start = bench_now();
+    weld_bench_marshal(&s, args);
+    double marshal_end = bench_now();
+    // Memory tracking resets and samples the RSS peak outside every phase.
+    struct bench_counters before, after;
+    struct bench_memory_mark mark = bench_memory_begin();
+    bench_perf_read(&before);
+    double marshalled = bench_now();
+    weld_bench_execute(m, &s);
+    double executed = bench_now();
+    bench_perf_read(&after);
+    struct bench_memory memory = bench_memory_end(&mark, 1.0);
+    double decode_start = bench_now();
+    R final_result = decode(weld_value_data(s.result));
+    double decoded = bench_now();
+    weld_bench_teardown(&s);
+    double end = bench_now();
+
+    if (phases != NULL) {
+        phases->marshal = marshal_end - start;
+        phases->execute = executed - marshalled;
+        phases->decode = decoded - decode_start;
+        phases->teardown = end - decoded;
+        phases->execute_counters = bench_counters_none();
+        bench_counters_add_delta(&phases->execute_counters, &before, &after, 1.0);
+        phases->execute_memory = memory;
+    }
+    return final_result;
+}
+
+/** Prints a "Weld <phase>" timing line for each phase of the given runs.
+ * The execute line carries the mean event counts and memory use of
+ * weld_module_run and, if o enables it, its bandwidth roofline. */
+void weld_bench_report_phases(const struct bench_options *o,
+        const struct weld_bench_phases *phases, int num_runs);
+
+/** Runs a compiled module o->warmup times untimed, then o->reps times timed.
+ *
+ * Prints the per-phase timing lines and returns the statistics of the
+ * end-to-end run time; the caller prints the "Weld" line with its result.
+ *
+ * @param result receives the decoded result of the last run.
+ */
+template <typename R, typename D>
+struct bench_stats weld_bench_trials(const struct bench_options *o,
+        struct weld_bench_module *m, void *args, D decode, R *result) {
+    for (int i = 0; i < o->warmup; i++) {
+        *result = weld_bench_run<R>(m, args, decode);
+    }
+    struct weld_bench_phases *phases = new struct weld_bench_phases[o->reps];
+    double *times = new double[o->reps];
+    for (int i = 0; i < o->reps; i++) {
+        times[i] = bench_time([&] {
+            *result = weld_bench_run<R>(m, args, decode, &phases[i]);
+        });
+    }
+    weld_bench_report_phases(o, phases, o->reps);
+    struct bench_stats stats = bench_stats_compute(times, o->reps);
+    bench_stats_set_traffic(&stats, o);
+    delete[] phases;
+    delete[] times;
+    return stats;
+}
+
+/** Runs a compiled module once without timing its phases or tracking its
+ * counters and memory, so that it can be called from several threads. */
+template <typename R, typename D>
+R weld_bench_query(struct weld_bench_module *m, void *args, D decode) {
+    struct weld_bench_run_state s;
+    weld_bench_marshal(&s, args);
+    weld_bench_execute(m, &s);
+    R final_result = decode(weld_value_data(s.result));
+    weld_bench_teardown(&s);
+    return final_result;
+}
+
+/** Measures throughput with concurrent clients sharing one compiled module.
+ *
+ * For 1, 2, 4, ... up to o->clients clients, each client thread issues
+ * o->warmup untimed queries, waits for the others, then issues o->queries
+ * timed queries back to back on its own arguments. Prints one line per
+ * client count: the time is the wall time per query (the inverse of the
+ * throughput), followed by the queries per second and the latency
+ * percentiles.
+ *
+ * @param scheme the experiment description; " (clients=K)" is appended.
+ * @param client_args o->clients argument structs, one per client.
+ */
+template <typename R, typename D>
+void weld_bench_throughput(const struct bench_options *o, const char *scheme,
+        struct weld_bench_module *m, void **client_args, D decode) {
+    for (int clients = 1; ; clients = (clients * 2 < o->clients) ? clients * 2 : o->clients) {
+        int num_queries = clients * o->queries;
+        double *latencies = new double[num_queries];
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+
+        std::vector<std::thread> threads;
+        for (int c = 0; c < clients; c++) {
+            threads.emplace_back([&, c] {
+                for (int i = 0; i < o->warmup; i++) {
+                    weld_bench_query<R>(m, client_args[c], decode);
+                }
+                ready++;
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < o->queries; i++) {
+                    latencies[c * o->queries + i] = bench_time([&] {
+                        weld_bench_query<R>(m, client_args[c], decode);
+                    });
+                }
+            });
+        }
+        while (ready < clients) {
+            std::this_thread::yield();
+        }
+        double start = bench_now();
+        go = true;
+        for (size_t t = 0; t < threads.size(); t++) {
+            threads[t].join();
+        }
+        double elapsed = bench_now() - start;
+
+        struct bench_stats stats = bench_stats_compute(latencies, num_queries);
+        char name[128];
+        snprintf(name, sizeof(name), "%s (clients=%d)", scheme, clients);
+        bench_report(name, elapsed / num_queries,
+                "[queries=%d qps=%.1f p50=%.9f p95=%.9f p99=%.9f max=%.9f]",
+                num_queries, num_queries / elapsed, stats.median, stats.p95,
+                bench_percentile(latencies, num_queries, 0.99), latencies[num_queries - 1]);
+        delete[] latencies;
+
+        if (clients >= o->clients) {
+            break;
+        }
+    }
+}
+
+// First random stream of the open-loop arrival times, clear of the streams
+// benchmarks use for their columns.
+#define WELD_BENCH_ARRIVAL_STREAM 1000
+
+/** Measures latency under a fixed offered load.
+ *
+ * For each rate in o->rates, o->queries requests arrive as a Poisson
+ * process (exponential gaps, reproducible from o->seed) and are served in
+ * arrival order by num_workers worker threads sharing one compiled module.
+ * A request's latency runs from its scheduled arrival to its completion,
+ * so time spent queued behind earlier requests is included even when the
+ * workers fall behind. Each worker runs o->warmup untimed queries first.
+ *
+ * Prints one line per rate: the time is the median latency, followed by
+ * the offered and achieved rates and the p50, p99, p99.9 and maximum
+ * latencies from an HDR-style histogram.
+ *
+ * @param scheme the experiment description; " (rate=R)" is appended.
+ * @param worker_args num_workers argument structs, one per worker.
+ */
+template <typename R, typename D>
+void weld_bench_open_loop(const struct bench_options *o, const char *scheme,
+        struct weld_bench_module *m, int num_workers, void **worker_args, D decode) {
+    int num_requests = o->queries;
+    double *arrivals = new double[num_requests];
+    struct bench_histogram *histograms = new struct bench_histogram[num_workers];
+
+    for (int r = 0; r < o->num_rates; r++) {
+        double rate = o->rates[r];
+        struct bench_rng rng = bench_rng_make(o->seed, WELD_BENCH_ARRIVAL_STREAM + r);
+        double t = 0.0;
+        for (int i = 0; i < num_requests; i++) {
+            t += -log(1.0 - bench_random_unit(bench_random(rng, i))) / rate;
+            arrivals[i] = t;
+        }
+
+        std::atomic<int> next(0);
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+        double start = 0.0;
+        double *finished = new double[num_workers];
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < num_workers; w++) {
+            bench_histogram_clear(&histograms[w]);
+            finished[w] = 0.0;
+            threads.emplace_back([&, w] {
+                for (int i = 0; i < o->warmup; i++) {
+                    weld_bench_query<R>(m, worker_args[w], decode);
+                }
+                ready++;
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                for (int i = next++; i < num_requests; i = next++) {
+                    double arrival = start + arrivals[i];
+                    bench_sleep_until(arrival);
+                    weld_bench_query<R>(m, worker_args[w], decode);
+                    finished[w] = bench_now();
+                    bench_histogram_record(&histograms[w], finished[w] - arrival);
+                }
+            });
+        }
+        while (ready < num_workers) {
+            std::this_thread::yield();
+        }
+        start = bench_now();
+        go = true;
+        for (size_t w = 0; w < threads.size(); w++) {
+            threads[w].join();
+        }
+
+        struct bench_histogram *all = &histograms[0];
+        double end = finished[0];
+        for (int w = 1; w < num_workers; w++) {
+            bench_histogram_merge(all, &histograms[w]);
+            if (finished[w] > end) {
+                end = finished[w];
+            }
+        }
+        delete[] finished;
+
+        char name[128];
+        snprintf(name, sizeof(name), "%s (rate=%g)", scheme, rate);
+        bench_report(name, bench_histogram_percentile(all, 0.5),
+                "[requests=%d offered=%.1f achieved=%.1f p50=%.9f p99=%.9f p999=%.9f max=%.9f]",
+                num_requests, rate, num_requests / (end - start),
+                bench_histogram_percentile(all, 0.5), bench_histogram_percentile(all, 0.99),
+                bench_histogram_percentile(all, 0.999), bench_histogram_max(all));
+    }
+    delete[] histograms;
+    delete[] arrivals;
+}
+
+/** Decoder for results that are a single scalar. */
+template <typename T>
+T weld_bench_scalar(void *data) {
+    return *((T *) data);
+}
+
+#endif
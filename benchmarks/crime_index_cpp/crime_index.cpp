@@ -0,0 +1,265 @@
+/**
+ * crime_index.cpp
+ *
+ * Native and Weld versions of the crime_index benchmark: a crime index per
+ * big city, normalized over all big cities and summed by state.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <string>
+#include <unordered_map>
+
+#include "weld_bench.h"
+#include "bench_csv.h"
+
+// Cities with more people than this are big.
+#define BIG_CITY 500000.0
+
+// The loaded input data.
+struct gen_data {
+    int64_t num_rows;
+    double *pop;
+    double *adult;
+    double *robberies;
+    // "State short", dictionary-encoded as 0 .. num_states - 1.
+    int64_t *states;
+    int64_t num_states;
+    // The table the numeric columns belong to.
+    struct csv_table table;
+};
+
+struct args {
+    struct weld_vector<double> pop;
+    struct weld_vector<double> adult;
+    struct weld_vector<double> robberies;
+    struct weld_vector<int64_t> states;
+    int64_t num_states;
+};
+
+/** Returns the sum of the three largest per-state indices, the value the
+ * Python benchmark reports. */
+double top3(const double *sums, int64_t n) {
+    double best[3] = { 0.0, 0.0, 0.0 };
+    for (int64_t i = 0; i < n; i++) {
+        double v = sums[i];
+        if (v > best[0]) {
+            best[2] = best[1];
+            best[1] = best[0];
+            best[0] = v;
+        } else if (v > best[1]) {
+            best[2] = best[1];
+            best[1] = v;
+        } else if (v > best[2]) {
+            best[2] = v;
+        }
+    }
+    return best[0] + best[1] + best[2];
+}
+
+/** Adds the crime index of each big city in rows [start, end) to its
+ * state's entry of sums and returns the total. */
+double run_query_range(struct gen_data *d, int64_t start, int64_t end, double *sums) {
+    double total = 0.0;
+    for (int64_t i = start; i < end; i++) {
+        if (d->pop[i] > BIG_CITY) {
+            double index = exp((d->pop[i] + 2.0 * d->adult[i] - 2000.0 * d->robberies[i]) / 100000.0);
+            sums[d->states[i]] += index;
+            total += index;
+        }
+    }
+    return total;
+}
+
+/** Normalizes the per-state sums by the total. */
+void finish_query(double *sums, int64_t num_states, double total) {
+    for (int64_t s = 0; s < num_states; s++) {
+        sums[s] /= total;
+    }
+}
+
+/** Returns the normalized index of each state, allocated with malloc. */
+double *run_query(struct gen_data *d) {
+    double *sums = (double *) calloc(d->num_states, sizeof(double));
+    double total = run_query_range(d, 0, d->num_rows, sums);
+    finish_query(sums, d->num_states, total);
+    return sums;
+}
+
+double *run_query_parallel(struct gen_data *d, int threads) {
+    // Per-thread state sums, added up after the scan.
+    double *partials = (double *) calloc((int64_t) threads * d->num_states, sizeof(double));
+    double total = bench_parallel_sum<double>(threads, d->num_rows, [&](int64_t start, int64_t end) {
+        return run_query_range(d, start, end, &partials[omp_get_thread_num() * d->num_states]);
+    });
+    for (int t = 1; t < threads; t++) {
+        for (int64_t s = 0; s < d->num_states; s++) {
+            partials[s] += partials[t * d->num_states + s];
+        }
+    }
+    // The first num_states entries now hold the result.
+    finish_query(partials, d->num_states, total);
+    return partials;
+}
+
+/** Decodes the Weld result, the normalized sum of each state, into the
+ * value every scheme reports. */
+double decode_result(void *data) {
+    weld_vector<double> *sums = (weld_vector<double> *) data;
+    return top3(sums->data, sums->length);
+}
+
+/** Copies the normalized sums out of a Weld result before it is freed. */
+struct weld_vector<double> copy_output(void *data) {
+    weld_vector<double> *v = (weld_vector<double> *) data;
+    double *copy = (double *) malloc(sizeof(double) * (v->length > 0 ? v->length : 1));
+    memcpy(copy, v->data, sizeof(double) * v->length);
+    return make_weld_vector<double>(copy, v->length);
+}
+
+/** Times the Weld program, then runs it once more untimed to return the
+ * normalized index of each state, allocated with malloc. */
+struct weld_vector<double> run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("crime_index.weld");
+
+    struct args args;
+    args.pop = make_weld_vector<double>(d->pop, d->num_rows);
+    args.adult = make_weld_vector<double>(d->adult, d->num_rows);
+    args.robberies = make_weld_vector<double>(d->robberies, d->num_rows);
+    args.states = make_weld_vector<int64_t>(d->states, d->num_rows);
+    args.num_states = d->num_states;
+
+    double final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, decode_result, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%.4f)", final_result);
+
+    struct weld_vector<double> output = weld_bench_query<struct weld_vector<double> >(&m, &args, copy_output);
+    weld_bench_module_free(&m);
+    return output;
+}
+
+/** Checks a scheme's per-state indices against the reference and frees
+ * them. Stops at the first index that differs. */
+void verify_sums(const char *scheme, const double *expected, double *sums, int64_t num_states,
+        double tolerance) {
+    char what[64];
+    for (int64_t s = 0; s < num_states; s++) {
+        snprintf(what, sizeof(what), "state %lld index", (long long) s);
+        if (!bench_verify_double(scheme, what, expected[s], sums[s], tolerance)) {
+            break;
+        }
+    }
+    free(sums);
+}
+
+/** Loads the city table written by download-data.sh.
+ *
+ * Rows with missing fields are dropped, as the Python benchmark's dropna
+ * does, and states are dictionary-encoded in order of first appearance.
+ *
+ * @param path the pipe-delimited file.
+ * @param threads the number of threads parsing the file.
+ * @return the loaded data in a structure.
+ */
+struct gen_data load_data(const char *path, int threads) {
+    static const struct csv_column_spec columns[] = {
+        { "State short", CSV_STRING },
+        { "Total population", CSV_DOUBLE },
+        { "Total adult population", CSV_DOUBLE },
+        { "Number of robberies", CSV_DOUBLE },
+    };
+    struct gen_data d;
+    d.table = csv_load(path, '|', columns, sizeof(columns) / sizeof(columns[0]), true, threads);
+    d.num_rows = d.table.num_rows;
+    d.pop = (double *) d.table.columns[1];
+    d.adult = (double *) d.table.columns[2];
+    d.robberies = (double *) d.table.columns[3];
+
+    const struct csv_string *names = (const struct csv_string *) d.table.columns[0];
+    std::unordered_map<std::string, int64_t> codes;
+    d.states = (int64_t *) bench_alloc(sizeof(int64_t) * d.num_rows);
+    for (int64_t i = 0; i < d.num_rows; i++) {
+        std::string name(names[i].data, names[i].length);
+        auto it = codes.find(name);
+        if (it == codes.end()) {
+            it = codes.insert(std::make_pair(name, (int64_t) codes.size())).first;
+        }
+        d.states[i] = it->second;
+    }
+    d.num_states = codes.size();
+    return d;
+}
+
+void free_data(struct gen_data *d) {
+    bench_free(d->states);
+    csv_table_free(&d->table);
+}
+
+int main(int argc, char **argv) {
+    // The input file, as a template filled in with the scale factor.
+    const char *input_template = "data/us_cities_states_counties_sf=%d.csv";
+    int scale_factor = 10;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "f:s:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'f':
+                input_template = optarg;
+                break;
+            case 's':
+                scale_factor = atoi(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(scale_factor > 0);
+
+    char path[1024];
+    csv_input_path(path, sizeof(path), input_template, scale_factor);
+    struct gen_data d = load_data(path, o.threads);
+    double *sums = NULL;
+
+    struct bench_stats stats = bench_trials_output(&o, &sums, [&] { return run_query(&d); }, free);
+    bench_report_stats("Single-threaded C++", &stats, "(result=%.4f)", top3(sums, d.num_states));
+    // Every other scheme must compute the same index for every state.
+    double *expected = sums;
+    sums = NULL;
+
+    stats = bench_trials_output(&o, &sums, [&] { return run_query_parallel(&d, o.threads); }, free);
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%.4f, threads=%d)",
+            top3(sums, d.num_states), o.threads);
+    verify_sums("Multi-threaded C++", expected, sums, d.num_states, o.tolerance);
+    sums = NULL;
+
+    struct weld_vector<double> weld_sums = run_query_weld(&d, &o);
+    if (bench_verify_int("Weld", "length", d.num_states, weld_sums.length)) {
+        verify_sums("Weld", expected, weld_sums.data, d.num_states, o.tolerance);
+    } else {
+        free(weld_sums.data);
+    }
+    free(expected);
+    free_data(&d);
+
+    return bench_verify_status();
+}
@@ -0,0 +1,272 @@
+/**
+ * crime_index_simplified.cpp
+ *
+ * Native and Weld versions of the crime_index_simplified benchmark: the sum
+ * of a clamped crime index over big cities, where the index is a dot product
+ * of each city's statistics with fixed weights.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "weld_bench.h"
+#include "bench_csv.h"
+
+// Cities with more people than this are big.
+#define BIG_CITY 500000.0
+// Bounds the crime index is clamped to.
+#define INDEX_MIN 0.01
+#define INDEX_MAX 0.02
+// Statistics in every dot product, before the extra columns.
+#define NUM_STATS 3
+// Extra columns the data files are written with (prune-csv -n).
+#define MAX_EXTRA_COLUMNS 20
+
+// The loaded input data.
+struct gen_data {
+    int64_t num_rows;
+    // Number of statistics in each dot product: NUM_STATS plus the extra
+    // columns.
+    int num_columns;
+    // "Total population", also the first statistic.
+    double *pop;
+    // The statistics, one array per column.
+    double *columns[NUM_STATS + MAX_EXTRA_COLUMNS];
+    // The weight of each statistic, and the same as the i64 the Weld
+    // programs take.
+    double weights[NUM_STATS + MAX_EXTRA_COLUMNS];
+    int64_t weights_i64[NUM_STATS + MAX_EXTRA_COLUMNS];
+    // The statistics row by row, for the Weld programs' vec[vec[f64]].
+    double *matrix;
+    struct weld_vector<double> *rows;
+    struct csv_table table;
+};
+
+struct args {
+    struct weld_vector<double> pop;
+    struct weld_vector<struct weld_vector<double> > rows;
+    struct weld_vector<int64_t> weights;
+};
+
+/** Clamps a crime index as the benchmark does: first down to INDEX_MAX,
+ * then up to INDEX_MIN. */
+inline double clamp_index(double index) {
+    index = index >= INDEX_MAX ? INDEX_MAX : index;
+    return index < INDEX_MIN ? INDEX_MIN : index;
+}
+
+double run_query_range(struct gen_data *d, int64_t start, int64_t end) {
+    double result = 0.0;
+    for (int64_t i = start; i < end; i++) {
+        if (d->pop[i] > BIG_CITY) {
+            double dot = 0.0;
+            for (int c = 0; c < d->num_columns; c++) {
+                dot += d->columns[c][i] * d->weights[c];
+            }
+            result += clamp_index(dot / 100000.0);
+        }
+    }
+    return result;
+}
+
+double run_query(struct gen_data *d) {
+    return run_query_range(d, 0, d->num_rows);
+}
+
+double run_query_parallel(struct gen_data *d, int threads) {
+    return bench_parallel_sum<double>(threads, d->num_rows, [&](int64_t start, int64_t end) {
+        return run_query_range(d, start, end);
+    });
+}
+
+#ifdef __AVX2__
+/** Four rows at a time: the filter becomes a mask on the clamped index. */
+double run_query_simd_range(struct gen_data *d, int64_t start, int64_t end) {
+    const __m256d big = _mm256_set1_pd(BIG_CITY);
+    const __m256d scale = _mm256_set1_pd(100000.0);
+    const __m256d lo = _mm256_set1_pd(INDEX_MIN);
+    const __m256d hi = _mm256_set1_pd(INDEX_MAX);
+    __m256d acc = _mm256_setzero_pd();
+    int64_t i = start;
+    for (; i + 4 <= end; i += 4) {
+        __m256d dot = _mm256_setzero_pd();
+        for (int c = 0; c < d->num_columns; c++) {
+            __m256d x = _mm256_loadu_pd(&d->columns[c][i]);
+            dot = _mm256_add_pd(dot, _mm256_mul_pd(x, _mm256_set1_pd(d->weights[c])));
+        }
+        __m256d index = _mm256_max_pd(_mm256_min_pd(_mm256_div_pd(dot, scale), hi), lo);
+        __m256d pass = _mm256_cmp_pd(_mm256_loadu_pd(&d->pop[i]), big, _CMP_GT_OQ);
+        acc = _mm256_add_pd(acc, _mm256_and_pd(index, pass));
+    }
+    return bench_hsum_pd(acc) + run_query_range(d, i, end);
+}
+
+double run_query_simd(struct gen_data *d, int threads) {
+    return bench_parallel_sum<double>(threads, d->num_rows, [&](int64_t start, int64_t end) {
+        return run_query_simd_range(d, start, end);
+    });
+}
+#endif
+
+double run_query_weld(struct gen_data *d, const char *filename, const char *scheme,
+        const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile(filename);
+
+    struct args args;
+    args.pop = make_weld_vector<double>(d->pop, d->num_rows);
+    args.rows = make_weld_vector<struct weld_vector<double> >(d->rows, d->num_rows);
+    args.weights = make_weld_vector<int64_t>(d->weights_i64, d->num_columns);
+
+    double final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, weld_bench_scalar<double>, &final_result);
+    bench_report_stats(scheme, &stats, "(result=%.4f)", final_result);
+
+    weld_bench_module_free(&m);
+    return final_result;
+}
+
+/** Loads the city table written by download-data.sh.
+ *
+ * Rows with missing fields are dropped, as the Python benchmark's dropna
+ * does. The statistics are kept both as columns, for the native kernels,
+ * and row by row, the vec[vec[f64]] layout the Weld programs take.
+ *
+ * @param path the pipe-delimited file.
+ * @param num_extra_columns the number of colN columns added to the dot
+ * product, each weighted 1.
+ * @param threads the number of threads parsing the file.
+ * @return the loaded data in a structure.
+ */
+struct gen_data load_data(const char *path, int num_extra_columns, int threads) {
+    static const char *stats[NUM_STATS] = {
+        "Total population", "Total adult population", "Number of robberies",
+    };
+    static const double stat_weights[NUM_STATS] = { 1.0, 2.0, -2000.0 };
+    char extra_names[MAX_EXTRA_COLUMNS][16];
+
+    struct gen_data d;
+    d.num_columns = NUM_STATS + num_extra_columns;
+    struct csv_column_spec columns[NUM_STATS + MAX_EXTRA_COLUMNS];
+    for (int c = 0; c < d.num_columns; c++) {
+        if (c < NUM_STATS) {
+            columns[c].name = stats[c];
+            d.weights[c] = stat_weights[c];
+        } else {
+            snprintf(extra_names[c - NUM_STATS], sizeof(extra_names[0]), "col%d", c - NUM_STATS);
+            columns[c].name = extra_names[c - NUM_STATS];
+            d.weights[c] = 1.0;
+        }
+        columns[c].type = CSV_DOUBLE;
+        d.weights_i64[c] = (int64_t) d.weights[c];
+    }
+
+    d.table = csv_load(path, '|', columns, d.num_columns, true, threads);
+    d.num_rows = d.table.num_rows;
+    for (int c = 0; c < d.num_columns; c++) {
+        d.columns[c] = (double *) d.table.columns[c];
+    }
+    d.pop = d.columns[0];
+
+    d.matrix = (double *) bench_alloc(sizeof(double) * d.num_rows * d.num_columns);
+    d.rows = (struct weld_vector<double> *) bench_alloc(sizeof(struct weld_vector<double>) * d.num_rows);
+    for (int64_t i = 0; i < d.num_rows; i++) {
+        double *row = &d.matrix[i * d.num_columns];
+        for (int c = 0; c < d.num_columns; c++) {
+            row[c] = d.columns[c][i];
+        }
+        d.rows[i] = make_weld_vector<double>(row, d.num_columns);
+    }
+    return d;
+}
+
+void free_data(struct gen_data *d) {
+    bench_free(d->matrix);
+    bench_free(d->rows);
+    csv_table_free(&d->table);
+}
+
+int main(int argc, char **argv) {
+    // The input file, as a template filled in with the scale factor.
+    const char *input_template = "data/us_cities_states_counties_sf=%d.csv";
+    int scale_factor = 10;
+    // Extra columns in the dot product, as in the Python benchmark.
+    int num_extra_columns = 0;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "f:n:s:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'f':
+                input_template = optarg;
+                break;
+            case 'n':
+                num_extra_columns = atoi(optarg);
+                break;
+            case 's':
+                scale_factor = atoi(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(scale_factor > 0);
+    assert(num_extra_columns >= 0 && num_extra_columns <= MAX_EXTRA_COLUMNS);
+
+    char path[1024];
+    csv_input_path(path, sizeof(path), input_template, scale_factor);
+    struct gen_data d = load_data(path, num_extra_columns, o.threads);
+
+    // Each query reads the population and every statistic once.
+    o.bytes = (double) d.num_rows * sizeof(double) * (d.num_columns + 1);
+    o.traffic = BENCH_TRAFFIC_READ;
+    double result;
+
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_query(&d); });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%.4f)", result);
+    // Every other scheme must compute the same index.
+    double expected = result;
+
+    stats = bench_trials(&o, [&] { result = run_query_parallel(&d, o.threads); });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%.4f, threads=%d)", result, o.threads);
+    bench_verify_double("Multi-threaded C++", "result", expected, result, o.tolerance);
+
+#ifdef __AVX2__
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, 1); });
+    bench_report_stats("SIMD C++", &stats, "(result=%.4f)", result);
+    bench_verify_double("SIMD C++", "result", expected, result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, o.threads); });
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%.4f, threads=%d)", result, o.threads);
+    bench_verify_double("Multi-threaded SIMD C++", "result", expected, result, o.tolerance);
+#endif
+
+    result = run_query_weld(&d, "../crime_index_simplified/crime_index_simplified.weld", "Weld", &o);
+    bench_verify_double("Weld", "result", expected, result, o.tolerance);
+    if (num_extra_columns == 0) {
+        // Unrolls the dot product, so it only covers the first three columns.
+        result = run_query_weld(&d, "../crime_index_simplified/crime_index_simplified_hacked_dp.weld",
+                "Weld unrolled dot product", &o);
+        bench_verify_double("Weld unrolled dot product", "result", expected, result, o.tolerance);
+    }
+    free_data(&d);
+
+    return bench_verify_status();
+}
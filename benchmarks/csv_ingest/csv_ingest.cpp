@@ -0,0 +1,230 @@
+/**
+ * csv_ingest.cpp
+ *
+ * Loads one of the delimited text files the Python benchmarks read into
+ * columns, and converts it to a column file. pandas' read_csv is timed on
+ * the same file by read_csv.py, so ingestion can be compared separately
+ * from the queries.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "weld_bench.h"
+#include "bench_csv.h"
+#include "bench_columns.h"
+
+/** Returns the sum of every non-missing numeric value of a table, which
+ * every scheme must agree on. */
+double table_checksum(const struct csv_table *t, const struct csv_schema *schema) {
+    double sum = 0.0;
+    for (int c = 0; c < schema->num_columns; c++) {
+        if (schema->columns[c].type != CSV_DOUBLE) {
+            continue;
+        }
+        const double *values = (const double *) t->columns[c];
+        for (int64_t i = 0; i < t->num_rows; i++) {
+            if (!isnan(values[i])) {
+                sum += values[i];
+            }
+        }
+    }
+    return sum;
+}
+
+/** Writes the numeric columns of a table to a column file. The format has
+ * no string type, so string columns are left out.
+ *
+ * @return the number of columns written, or -1 if the file could not be
+ * written.
+ */
+int write_columns(const struct csv_table *t, const struct csv_schema *schema,
+        const char *path, const char *key) {
+    struct column_spec columns[CSV_MAX_COLUMNS];
+    int n = 0;
+    for (int c = 0; c < schema->num_columns; c++) {
+        if (schema->columns[c].type == CSV_DOUBLE) {
+            columns[n].name = schema->columns[c].name;
+            columns[n].type = COLUMN_DOUBLE;
+            columns[n].data = t->columns[c];
+            n++;
+        }
+    }
+    return column_file_write(path, key, t->num_rows, columns, n) ? n : -1;
+}
+
+/** Times pandas' read_csv on the same file with read_csv.py, and checks its
+ * rows and checksum against the C++ load. Prints a note on stderr instead
+ * if Python or pandas is unavailable.
+ *
+ * The placement of -a does not apply to pandas, so the line has no alloc
+ * suffix.
+ */
+void run_pandas(const char *path, char delimiter, int num_columns, int64_t num_rows,
+        double expect, double size, const struct bench_options *o) {
+    if (strchr(path, '\'') != NULL) {
+        fprintf(stderr, "skipping Pandas read_csv: cannot quote %s\n", path);
+        return;
+    }
+    char command[4096];
+    snprintf(command, sizeof(command), "python read_csv.py -i '%s' -d '%c' -c %d -w %d -r %d",
+            path, delimiter, num_columns, o->warmup, o->reps);
+    FILE *p = popen(command, "r");
+    if (p == NULL) {
+        fprintf(stderr, "skipping Pandas read_csv: could not run python\n");
+        return;
+    }
+    double *times = new double[o->reps];
+    int num_times = 0;
+    double result = NAN;
+    long long rows = -1;
+    int columns = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), p) != NULL) {
+        double t;
+        if (sscanf(line, "time %lf", &t) == 1) {
+            if (num_times < o->reps) {
+                times[num_times++] = t;
+            }
+        } else {
+            sscanf(line, "result %lf %lld %d", &result, &rows, &columns);
+        }
+    }
+    if (pclose(p) != 0 || num_times == 0 || rows < 0) {
+        fprintf(stderr, "skipping Pandas read_csv: %s failed\n", command);
+        delete[] times;
+        return;
+    }
+
+    struct bench_stats stats = bench_stats_compute(times, num_times);
+    char reps[160] = "";
+    if (stats.reps > 1) {
+        snprintf(reps, sizeof(reps), " [reps=%d min=%.9f median=%.9f p95=%.9f stddev=%.9f]",
+                stats.reps, stats.min, stats.median, stats.p95, stats.stddev);
+    }
+    bench_report("Pandas read_csv", stats.median, "(result=%.4f, rows=%lld, columns=%d, mb-per-sec=%.1f)%s",
+            result, rows, columns, size / stats.median / 1e6, reps);
+    bench_verify_int("Pandas read_csv", "rows", num_rows, rows);
+    bench_verify_int("Pandas read_csv", "columns", num_columns, columns);
+    bench_verify_double("Pandas read_csv", "result", expect, result, o->tolerance);
+    delete[] times;
+}
+
+int main(int argc, char **argv) {
+    // The input file, as a template filled in with the scale factor.
+    const char *input_template = "data/us_cities_states_counties_sf=%d.csv";
+    int scale_factor = 10;
+    // The column file to write; the input path with ".cols" appended if
+    // not given.
+    const char *output = NULL;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "f:m:s:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'f':
+                input_template = optarg;
+                break;
+            case 'm':
+                output = optarg;
+                break;
+            case 's':
+                scale_factor = atoi(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(scale_factor > 0);
+
+    char path[1024];
+    csv_input_path(path, sizeof(path), input_template, scale_factor);
+    // Room for path and its ".cols" suffix.
+    char output_path[sizeof(path) + 8];
+    if (output == NULL) {
+        snprintf(output_path, sizeof(output_path), "%s.cols", path);
+        output = output_path;
+    }
+
+    // The schema is inferred once and not timed.
+    char delimiter = csv_detect_delimiter(path);
+    struct csv_schema schema;
+    csv_infer_schema(path, delimiter, o.threads, &schema);
+    int num_strings = 0;
+    for (int c = 0; c < schema.num_columns; c++) {
+        num_strings += schema.columns[c].type == CSV_STRING;
+    }
+
+    struct csv_table t = csv_load(path, delimiter, schema.columns, schema.num_columns, false, 1);
+    int64_t num_rows = t.num_rows;
+    double size = (double) t.size;
+    double expect = table_checksum(&t, &schema);
+    csv_table_free(&t);
+
+    // Every load reads the whole file.
+    o.bytes = size;
+    o.traffic = BENCH_TRAFFIC_READ;
+    double result;
+
+    struct bench_stats stats = bench_trials(&o, [&] {
+        t = csv_load(path, delimiter, schema.columns, schema.num_columns, false, 1);
+        csv_table_free(&t);
+    });
+    bench_report_stats("Single-threaded C++ load", &stats,
+            "(result=%.4f, rows=%lld, columns=%d, mb-per-sec=%.1f)",
+            expect, (long long) num_rows, schema.num_columns, size / stats.median / 1e6);
+
+    stats = bench_trials(&o, [&] {
+        t = csv_load(path, delimiter, schema.columns, schema.num_columns, false, o.threads);
+        csv_table_free(&t);
+    });
+    t = csv_load(path, delimiter, schema.columns, schema.num_columns, false, o.threads);
+    result = table_checksum(&t, &schema);
+    bench_verify_int("Multi-threaded C++ load", "rows", num_rows, t.num_rows);
+    bench_verify_double("Multi-threaded C++ load", "result", expect, result, o.tolerance);
+    csv_table_free(&t);
+    bench_report_stats("Multi-threaded C++ load", &stats,
+            "(result=%.4f, rows=%lld, columns=%d, threads=%d, mb-per-sec=%.1f)",
+            result, (long long) num_rows, schema.num_columns, o.threads, size / stats.median / 1e6);
+
+    // Keys name the input by its file name and size.
+    const char *base = strrchr(path, '/');
+    char key[COLUMN_FILE_KEY_LEN];
+    snprintf(key, sizeof(key), "csv_ingest %.200s size=%lld", base != NULL ? base + 1 : path, (long long) size);
+    int written = 0;
+    stats = bench_trials(&o, [&] {
+        t = csv_load(path, delimiter, schema.columns, schema.num_columns, false, o.threads);
+        written = write_columns(&t, &schema, output, key);
+        csv_table_free(&t);
+    });
+    if (written < 0) {
+        fprintf(stderr, "could not write %s\n", output);
+        exit(1);
+    }
+    bench_report_stats("Multi-threaded C++ load to column file", &stats,
+            "(result=%.4f, rows=%lld, columns=%d, skipped-strings=%d, threads=%d, mb-per-sec=%.1f)",
+            result, (long long) num_rows, written, num_strings, o.threads, size / stats.median / 1e6);
+
+    run_pandas(path, delimiter, schema.num_columns, num_rows, expect, size, &o);
+
+    return bench_verify_status();
+}
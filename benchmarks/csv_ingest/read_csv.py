@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+"""Times pandas' read_csv on the file csv_ingest loads, for its
+"Pandas read_csv" scheme.
+
+Reads the same columns as the C++ loader (the first -c of the header) and,
+like it, drops no rows and treats only empty fields as missing. Prints the
+seconds of each timed read on its own line as "time <seconds>", then
+"result <checksum> <rows> <columns>", where the checksum is the sum of
+every non-missing value of the numeric columns. Exits with status 3 if
+pandas cannot be imported.
+"""
+
+from __future__ import print_function
+
+import argparse
+import sys
+import time
+
+try:
+    import numpy as np
+    import pandas as pd
+except ImportError as e:
+    print("read_csv.py: %s" % e, file=sys.stderr)
+    sys.exit(3)
+
+
+def read(path, delimiter, num_columns):
+    return pd.read_csv(path, sep=delimiter, usecols=range(num_columns),
+                       keep_default_na=False, na_values=[''])
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Time pandas' read_csv")
+    parser.add_argument('-i', "--input", type=str, required=True,
+                        help="Input file")
+    parser.add_argument('-d', "--delimiter", type=str, required=True,
+                        help="Field separator")
+    parser.add_argument('-c', "--columns", type=int, required=True,
+                        help="Number of leading columns to read")
+    parser.add_argument('-w', "--warmup", type=int, default=0,
+                        help="Untimed reads before the timed ones")
+    parser.add_argument('-r', "--reps", type=int, default=1,
+                        help="Timed reads")
+    args = parser.parse_args()
+
+    for _ in range(args.warmup):
+        read(args.input, args.delimiter, args.columns)
+    for _ in range(args.reps):
+        start = time.time()
+        df = read(args.input, args.delimiter, args.columns)
+        end = time.time()
+        print("time %.9f" % (end - start))
+        del df
+
+    df = read(args.input, args.delimiter, args.columns)
+    # Booleans are not numbers to the C++ loader.
+    numeric = df.select_dtypes(include=[np.number])
+    print("result %.17g %d %d" % (numeric.sum().sum(), len(df), len(df.columns)))
@@ -0,0 +1,257 @@
+/**
+ * data_cleaning.cpp
+ *
+ * Native and Weld versions of the data_cleaning benchmark: truncate zip
+ * codes to five characters, treat 00000 as missing and count the distinct
+ * values.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "weld_bench.h"
+#include "bench_csv.h"
+
+// Length zip codes are truncated to.
+#define ZIP_LENGTH 5
+// Key of a missing zip code; real keys have their length in bits 40-42.
+#define MISSING_KEY UINT64_MAX
+// Initial number of slots in a zip_set.
+#define ZIP_SET_CAPACITY 1024
+
+// Values read as missing: pandas' default na_values and the ones the
+// Python benchmark adds.
+static const char *NA_VALUES[] = {
+    "", "#N/A", "#N/A N/A", "#NA", "-1.#IND", "-1.#QNAN", "-NaN", "-nan",
+    "1.#IND", "1.#QNAN", "<NA>", "N/A", "NA", "NULL", "NaN", "None", "n/a",
+    "nan", "null", "NO CLUE", "0",
+};
+
+// How the Weld program's input spells a missing value.
+static char NA_STRING[] = "nan";
+
+// The loaded input data.
+struct gen_data {
+    int64_t num_rows;
+    // "Incident Zip"; data is NULL if the value is missing.
+    struct csv_string *zips;
+    // The same strings as the Weld program's vec[vec[i8]].
+    struct weld_vector<int8_t> *weld_zips;
+    struct csv_table table;
+};
+
+struct args {
+    struct weld_vector<struct weld_vector<int8_t> > zips;
+};
+
+// An open-addressing set of zip keys.
+struct zip_set {
+    uint64_t *slots;
+    int64_t capacity;
+    int64_t size;
+};
+
+/** Returns the cleaned zip code as a key: its first ZIP_LENGTH bytes and
+ * its length, or MISSING_KEY if it is missing or 00000. */
+inline uint64_t zip_key(const struct csv_string *zip) {
+    if (zip->data == NULL) {
+        return MISSING_KEY;
+    }
+    int64_t length = zip->length < ZIP_LENGTH ? zip->length : ZIP_LENGTH;
+    if (length == ZIP_LENGTH && memcmp(zip->data, "00000", ZIP_LENGTH) == 0) {
+        return MISSING_KEY;
+    }
+    uint64_t key = 0;
+    memcpy(&key, zip->data, length);
+    return key | (uint64_t) length << 40;
+}
+
+void zip_set_init(struct zip_set *s, int64_t capacity) {
+    s->slots = (uint64_t *) calloc(capacity, sizeof(uint64_t));
+    s->capacity = capacity;
+    s->size = 0;
+}
+
+void zip_set_insert(struct zip_set *s, uint64_t key);
+
+/** Doubles the number of slots, keeping the set at most half full. */
+void zip_set_grow(struct zip_set *s) {
+    struct zip_set larger;
+    zip_set_init(&larger, s->capacity * 2);
+    for (int64_t i = 0; i < s->capacity; i++) {
+        if (s->slots[i] != 0) {
+            zip_set_insert(&larger, s->slots[i]);
+        }
+    }
+    free(s->slots);
+    *s = larger;
+}
+
+/** Adds a key; no real or missing key is 0, which marks empty slots. */
+void zip_set_insert(struct zip_set *s, uint64_t key) {
+    uint64_t mask = s->capacity - 1;
+    uint64_t i = (key * 0x9E3779B97F4A7C15ULL) >> 32 & mask;
+    while (s->slots[i] != 0) {
+        if (s->slots[i] == key) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    s->slots[i] = key;
+    if (++s->size * 2 > s->capacity) {
+        zip_set_grow(s);
+    }
+}
+
+void run_query_range(struct gen_data *d, int64_t start, int64_t end, struct zip_set *s) {
+    for (int64_t i = start; i < end; i++) {
+        zip_set_insert(s, zip_key(&d->zips[i]));
+    }
+}
+
+int64_t run_query(struct gen_data *d) {
+    struct zip_set s;
+    zip_set_init(&s, ZIP_SET_CAPACITY);
+    run_query_range(d, 0, d->num_rows, &s);
+    free(s.slots);
+    return s.size;
+}
+
+int64_t run_query_parallel(struct gen_data *d, int threads) {
+    // Per-thread sets, merged after the scan.
+    struct zip_set *sets = new struct zip_set[threads];
+    for (int t = 0; t < threads; t++) {
+        zip_set_init(&sets[t], ZIP_SET_CAPACITY);
+    }
+    bench_parallel_for(threads, d->num_rows, [&](int64_t start, int64_t end) {
+        run_query_range(d, start, end, &sets[omp_get_thread_num()]);
+    });
+    for (int t = 1; t < threads; t++) {
+        for (int64_t i = 0; i < sets[t].capacity; i++) {
+            if (sets[t].slots[i] != 0) {
+                zip_set_insert(&sets[0], sets[t].slots[i]);
+            }
+        }
+        free(sets[t].slots);
+    }
+    int64_t result = sets[0].size;
+    free(sets[0].slots);
+    delete[] sets;
+    return result;
+}
+
+int64_t run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("data_cleaning.weld");
+
+    struct args args;
+    args.zips = make_weld_vector<struct weld_vector<int8_t> >(d->weld_zips, d->num_rows);
+
+    int64_t final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, weld_bench_scalar<int64_t>, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%lld)", (long long) final_result);
+
+    weld_bench_module_free(&m);
+    return final_result;
+}
+
+/** Loads the service request table written by download-data.sh.
+ *
+ * Missing values are recognized while loading, as pandas' read_csv does
+ * with the Python benchmark's na_values. The Weld program's strings point
+ * into the file, with missing values spelled "nan" as Grizzly spells them.
+ *
+ * @param path the comma-delimited file.
+ * @param threads the number of threads parsing the file.
+ * @return the loaded data in a structure.
+ */
+struct gen_data load_data(const char *path, int threads) {
+    static const struct csv_column_spec columns[] = {
+        { "Incident Zip", CSV_STRING },
+    };
+    struct gen_data d;
+    d.table = csv_load(path, ',', columns, 1, false, threads);
+    d.num_rows = d.table.num_rows;
+    d.zips = (struct csv_string *) d.table.columns[0];
+    d.weld_zips = (struct weld_vector<int8_t> *) bench_alloc(sizeof(struct weld_vector<int8_t>) * d.num_rows);
+    for (int64_t i = 0; i < d.num_rows; i++) {
+        struct csv_string *zip = &d.zips[i];
+        for (size_t v = 0; v < sizeof(NA_VALUES) / sizeof(NA_VALUES[0]); v++) {
+            if ((int64_t) strlen(NA_VALUES[v]) == zip->length &&
+                    memcmp(NA_VALUES[v], zip->data, zip->length) == 0) {
+                zip->data = NULL;
+                break;
+            }
+        }
+        if (zip->data == NULL) {
+            d.weld_zips[i] = make_weld_vector<int8_t>((int8_t *) NA_STRING, strlen(NA_STRING));
+        } else {
+            d.weld_zips[i] = make_weld_vector<int8_t>((int8_t *) zip->data, zip->length);
+        }
+    }
+    return d;
+}
+
+void free_data(struct gen_data *d) {
+    bench_free(d->weld_zips);
+    csv_table_free(&d->table);
+}
+
+int main(int argc, char **argv) {
+    // The input file, as a template filled in with the scale factor.
+    const char *input_template = "data/311-service-requests-sf=%d.csv";
+    int scale_factor = 10;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "f:s:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'f':
+                input_template = optarg;
+                break;
+            case 's':
+                scale_factor = atoi(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(scale_factor > 0);
+
+    char path[1024];
+    csv_input_path(path, sizeof(path), input_template, scale_factor);
+    struct gen_data d = load_data(path, o.threads);
+    int64_t result;
+
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_query(&d); });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%lld)", (long long) result);
+    // Every other scheme must find the same number of distinct zip codes.
+    int64_t expected = result;
+
+    stats = bench_trials(&o, [&] { result = run_query_parallel(&d, o.threads); });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%lld, threads=%d)", (long long) result, o.threads);
+    bench_verify_int("Multi-threaded C++", "result", expected, result);
+
+    result = run_query_weld(&d, &o);
+    bench_verify_int("Weld", "result", expected, result);
+    free_data(&d);
+
+    return bench_verify_status();
+}
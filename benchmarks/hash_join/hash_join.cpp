@@ -0,0 +1,510 @@
+/**
+ * hash_join.cpp
+ *
+ * An equi-join of generated lineitem-like rows (the probe side) with
+ * orders-like rows (the build side) on the order key, summing the revenue
+ * of the matching lines and the priority of their orders.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "weld_bench.h"
+
+// Multiplier of the Fibonacci hash that places keys in partitions and slots.
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+// Key of an unused hash table slot. Order keys are never negative.
+#define EMPTY_KEY -1
+// Build rows per partition that the radix-partitioned join aims for, so
+// that each partition's hash table (8 bytes per slot, half full) fits in L2.
+#define BUILD_ROWS_PER_PARTITION 16384
+// Most partitions the radix-partitioned join writes in its one pass.
+#define MAX_PARTITION_BITS 11
+
+// The generated input data.
+struct gen_data {
+    // Number of lineitems, the probe side.
+    int64_t num_items;
+    int32_t *l_orderkey;
+    float *l_extendedprice;
+    float *l_discount;
+    // Number of orders, the build side. Order keys are unique.
+    int64_t num_orders;
+    int32_t *o_orderkey;
+    int32_t *o_shippriority;
+};
+
+struct args {
+    struct weld_vector<int32_t> l_orderkey;
+    struct weld_vector<float> l_extendedprice;
+    struct weld_vector<float> l_discount;
+    struct weld_vector<int32_t> o_orderkey;
+    struct weld_vector<int32_t> o_shippriority;
+};
+
+// The result of the join, laid out as the Weld program returns it.
+struct join_result {
+    // Number of lineitems with an order.
+    int64_t matches;
+    // Sum of l_extendedprice * (1 - l_discount) over those lineitems.
+    double revenue;
+    // Sum of o_shippriority over those lineitems.
+    int64_t priorities;
+};
+
+// A slot of an open-addressing hash table from order keys to priorities.
+struct join_slot {
+    int32_t key;
+    int32_t payload;
+};
+
+// An open-addressing hash table with linear probing, sized for its build
+// side up front.
+struct join_table {
+    struct join_slot *slots;
+    // log2 of the number of slots.
+    int bits;
+    // Number of leading hash bits that are the same for every key, because
+    // they chose the partition the table joins.
+    int skip_bits;
+};
+
+// A build row, as the radix-partitioned join copies it into its partition.
+struct build_row {
+    int32_t key;
+    int32_t payload;
+};
+
+// A probe row, as the radix-partitioned join copies it into its partition.
+struct probe_row {
+    int32_t key;
+    float extended_price;
+    float discount;
+};
+
+inline uint64_t hash_key(int32_t key) {
+    return (uint64_t) (uint32_t) key * HASH_MULTIPLIER;
+}
+
+/** Returns the smallest number of bits b with 2^b >= n. */
+int ceil_log2(int64_t n) {
+    int b = 0;
+    while (((int64_t) 1 << b) < n) {
+        b++;
+    }
+    return b;
+}
+
+void add_results(struct join_result *dst, const struct join_result *src) {
+    dst->matches += src->matches;
+    dst->revenue += src->revenue;
+    dst->priorities += src->priorities;
+}
+
+/** Allocates a hash table with at least twice as many slots as rows. */
+void join_table_init(struct join_table *t, int64_t rows, int skip_bits) {
+    // At least one bit, so that join_table_slot never shifts by 64.
+    int bits = ceil_log2(2 * rows + 1);
+    t->bits = bits > 0 ? bits : 1;
+    t->skip_bits = skip_bits;
+    int64_t capacity = (int64_t) 1 << t->bits;
+    t->slots = (struct join_slot *) malloc(sizeof(struct join_slot) * capacity);
+}
+
+/** Marks every slot in [start, end) of a hash table unused. */
+void join_table_clear(struct join_table *t, int64_t start, int64_t end) {
+    for (int64_t s = start; s < end; s++) {
+        t->slots[s].key = EMPTY_KEY;
+    }
+}
+
+inline uint64_t join_table_slot(const struct join_table *t, int32_t key) {
+    return (hash_key(key) << t->skip_bits) >> (64 - t->bits);
+}
+
+/** Inserts a key, which must not be in the table yet.
+ *
+ * @param concurrent whether other threads insert at the same time, in
+ * which case slots are claimed with a compare-and-swap.
+ */
+template <bool concurrent>
+inline void join_table_insert(struct join_table *t, int32_t key, int32_t payload) {
+    uint64_t mask = ((uint64_t) 1 << t->bits) - 1;
+    uint64_t s = join_table_slot(t, key);
+    while (true) {
+        struct join_slot *slot = &t->slots[s];
+        if (concurrent) {
+            if (slot->key == EMPTY_KEY && __sync_bool_compare_and_swap(&slot->key, EMPTY_KEY, key)) {
+                slot->payload = payload;
+                return;
+            }
+        } else if (slot->key == EMPTY_KEY) {
+            slot->key = key;
+            slot->payload = payload;
+            return;
+        }
+        s = (s + 1) & mask;
+    }
+}
+
+/** Returns the slot of key, or NULL if the table does not hold it. */
+inline const struct join_slot *join_table_find(const struct join_table *t, int32_t key) {
+    uint64_t mask = ((uint64_t) 1 << t->bits) - 1;
+    uint64_t s = join_table_slot(t, key);
+    while (t->slots[s].key != EMPTY_KEY) {
+        if (t->slots[s].key == key) {
+            return &t->slots[s];
+        }
+        s = (s + 1) & mask;
+    }
+    return NULL;
+}
+
+/** Adds a probe row to the result if its key has a match. */
+inline void probe_row(const struct join_table *t, struct join_result *r,
+        int32_t key, float extended_price, float discount) {
+    const struct join_slot *slot = join_table_find(t, key);
+    if (slot != NULL) {
+        r->matches++;
+        r->revenue += extended_price * (1 - discount);
+        r->priorities += slot->payload;
+    }
+}
+
+/** Joins with one hash table over the whole build side, shared by all
+ * threads: the threads insert their part of the build side concurrently,
+ * then probe the table with their part of the probe side. */
+struct join_result run_query_no_partition(struct gen_data *d, int threads) {
+    struct join_table t;
+    join_table_init(&t, d->num_orders, 0);
+    int64_t capacity = (int64_t) 1 << t.bits;
+    struct join_result total = { 0, 0.0, 0 };
+
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        join_table_clear(&t, bench_range_start(capacity, thread, num_threads),
+                bench_range_start(capacity, thread + 1, num_threads));
+#pragma omp barrier
+        int64_t end = bench_range_start(d->num_orders, thread + 1, num_threads);
+        for (int64_t i = bench_range_start(d->num_orders, thread, num_threads); i < end; i++) {
+            if (num_threads > 1) {
+                join_table_insert<true>(&t, d->o_orderkey[i], d->o_shippriority[i]);
+            } else {
+                join_table_insert<false>(&t, d->o_orderkey[i], d->o_shippriority[i]);
+            }
+        }
+#pragma omp barrier
+        struct join_result local = { 0, 0.0, 0 };
+        end = bench_range_start(d->num_items, thread + 1, num_threads);
+        for (int64_t i = bench_range_start(d->num_items, thread, num_threads); i < end; i++) {
+            probe_row(&t, &local, d->l_orderkey[i], d->l_extendedprice[i], d->l_discount[i]);
+        }
+#pragma omp critical
+        add_results(&total, &local);
+    }
+
+    free(t.slots);
+    return total;
+}
+
+/** Copies rows into partitions by the leading bits of their key's hash.
+ *
+ * Called by every thread of a parallel region. Each thread counts its rows
+ * of each partition, then writes them to its own part of every partition,
+ * so the copy needs no synchronization beyond two barriers.
+ *
+ * @param counts num_threads * num_partitions zeroed counts.
+ * @param starts receives the first row of each partition, and the total.
+ * @param row called as row(out, i) to copy input row i to out.
+ */
+template <typename R, typename F>
+void partition_rows(const int32_t *keys, int64_t n, int bits, int64_t *counts, int64_t *starts,
+        R *out, F row) {
+    int thread = omp_get_thread_num();
+    int num_threads = omp_get_num_threads();
+    int num_partitions = 1 << bits;
+    int64_t start = bench_range_start(n, thread, num_threads);
+    int64_t end = bench_range_start(n, thread + 1, num_threads);
+    int64_t *local = &counts[(int64_t) thread * num_partitions];
+    for (int64_t i = start; i < end; i++) {
+        local[bits > 0 ? hash_key(keys[i]) >> (64 - bits) : 0]++;
+    }
+#pragma omp barrier
+#pragma omp single
+    {
+        int64_t offset = 0;
+        for (int p = 0; p < num_partitions; p++) {
+            starts[p] = offset;
+            for (int t = 0; t < num_threads; t++) {
+                int64_t count = counts[(int64_t) t * num_partitions + p];
+                counts[(int64_t) t * num_partitions + p] = offset;
+                offset += count;
+            }
+        }
+        starts[num_partitions] = offset;
+    }
+    for (int64_t i = start; i < end; i++) {
+        row(&out[local[bits > 0 ? hash_key(keys[i]) >> (64 - bits) : 0]++], i);
+    }
+#pragma omp barrier
+}
+
+/** Returns the number of bits of the hash that the radix-partitioned join
+ * partitions num_orders build rows by. */
+int partition_bits(int64_t num_orders) {
+    int bits = ceil_log2((num_orders + BUILD_ROWS_PER_PARTITION - 1) / BUILD_ROWS_PER_PARTITION);
+    return bits < MAX_PARTITION_BITS ? bits : MAX_PARTITION_BITS;
+}
+
+/** Joins in two phases. Both sides are first copied into partitions by
+ * the leading bits of their key's hash; then each pair of partitions is
+ * joined with a hash table small enough to stay in cache. Pairs are joined
+ * by the threads independently. */
+struct join_result run_query_radix(struct gen_data *d, int threads) {
+    int bits = partition_bits(d->num_orders);
+    int num_partitions = 1 << bits;
+    int64_t *build_counts = (int64_t *) calloc((int64_t) threads * num_partitions, sizeof(int64_t));
+    int64_t *probe_counts = (int64_t *) calloc((int64_t) threads * num_partitions, sizeof(int64_t));
+    int64_t *build_starts = (int64_t *) malloc(sizeof(int64_t) * (num_partitions + 1));
+    int64_t *probe_starts = (int64_t *) malloc(sizeof(int64_t) * (num_partitions + 1));
+    struct build_row *build = (struct build_row *) malloc(sizeof(struct build_row) * d->num_orders);
+    struct probe_row *probe = (struct probe_row *) malloc(sizeof(struct probe_row) * d->num_items);
+    struct join_result total = { 0, 0.0, 0 };
+
+#pragma omp parallel num_threads(threads)
+    {
+        partition_rows(d->o_orderkey, d->num_orders, bits, build_counts, build_starts, build,
+                [&](struct build_row *r, int64_t i) {
+            r->key = d->o_orderkey[i];
+            r->payload = d->o_shippriority[i];
+        });
+        partition_rows(d->l_orderkey, d->num_items, bits, probe_counts, probe_starts, probe,
+                [&](struct probe_row *r, int64_t i) {
+            r->key = d->l_orderkey[i];
+            r->extended_price = d->l_extendedprice[i];
+            r->discount = d->l_discount[i];
+        });
+
+        struct join_result local = { 0, 0.0, 0 };
+#pragma omp for schedule(dynamic)
+        for (int p = 0; p < num_partitions; p++) {
+            struct join_table t;
+            join_table_init(&t, build_starts[p + 1] - build_starts[p], bits);
+            join_table_clear(&t, 0, (int64_t) 1 << t.bits);
+            for (int64_t r = build_starts[p]; r < build_starts[p + 1]; r++) {
+                join_table_insert<false>(&t, build[r].key, build[r].payload);
+            }
+            for (int64_t r = probe_starts[p]; r < probe_starts[p + 1]; r++) {
+                probe_row(&t, &local, probe[r].key, probe[r].extended_price, probe[r].discount);
+            }
+            free(t.slots);
+        }
+#pragma omp critical
+        add_results(&total, &local);
+    }
+
+    free(probe);
+    free(build);
+    free(probe_starts);
+    free(build_starts);
+    free(probe_counts);
+    free(build_counts);
+    return total;
+}
+
+struct join_result run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("hash_join.weld");
+
+    struct args args;
+    args.l_orderkey = make_weld_vector<int32_t>(d->l_orderkey, d->num_items);
+    args.l_extendedprice = make_weld_vector<float>(d->l_extendedprice, d->num_items);
+    args.l_discount = make_weld_vector<float>(d->l_discount, d->num_items);
+    args.o_orderkey = make_weld_vector<int32_t>(d->o_orderkey, d->num_orders);
+    args.o_shippriority = make_weld_vector<int32_t>(d->o_shippriority, d->num_orders);
+
+    struct join_result final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args,
+            weld_bench_scalar<struct join_result>, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%.4f, matches=%lld)",
+            final_result.revenue, (long long) final_result.matches);
+
+    weld_bench_module_free(&m);
+    return final_result;
+}
+
+/** Returns a multiplier coprime to n, so that i -> i * multiplier mod n
+ * permutes [0, n). */
+int64_t coprime_multiplier(int64_t n) {
+    int64_t m = (int64_t) (n * 0.6180339887) | 1;
+    while (true) {
+        int64_t a = m, b = n;
+        while (b != 0) {
+            int64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        if (a == 1) {
+            return m;
+        }
+        m += 2;
+    }
+}
+
+/** Generates input data.
+ *
+ * Order keys are the even numbers below 2 * num_orders, in a scrambled
+ * order. A lineitem has an order with probability match_rate; its order is
+ * then drawn from a Zipf distribution over the orders (uniform if skew is
+ * 0), with the most frequent orders spread over the key range. Other
+ * lineitems get an odd key, which no order has.
+ *
+ * @param num_items the number of lineitems.
+ * @param num_orders the number of orders.
+ * @param match_rate the fraction of lineitems that have an order.
+ * @param skew the Zipf exponent of the orders of matching lineitems.
+ * @param seed the seed of the random values.
+ * @return the generated data in a structure.
+ */
+struct gen_data generate_data(int64_t num_items, int64_t num_orders, double match_rate,
+        double skew, uint64_t seed) {
+    struct gen_data d;
+    d.num_items = num_items;
+    d.num_orders = num_orders;
+    d.l_orderkey = (int32_t *) bench_alloc(sizeof(int32_t) * num_items);
+    d.l_extendedprice = (float *) bench_alloc(sizeof(float) * num_items);
+    d.l_discount = (float *) bench_alloc(sizeof(float) * num_items);
+    d.o_orderkey = (int32_t *) bench_alloc(sizeof(int32_t) * num_orders);
+    d.o_shippriority = (int32_t *) bench_alloc(sizeof(int32_t) * num_orders);
+
+    int64_t multiplier = coprime_multiplier(num_orders);
+    auto order_key = [=](int64_t order) {
+        return (int32_t) (2 * ((order * multiplier) % num_orders));
+    };
+    for (int64_t i = 0; i < num_orders; i++) {
+        d.o_orderkey[i] = order_key(i);
+    }
+    bench_fill_uniform<int32_t>(d.o_shippriority, num_orders, 0, 4, bench_rng_make(seed, 0));
+
+    struct bench_zipf zipf = bench_zipf_make(num_orders, skew);
+    bench_generate(d.l_orderkey, num_items, bench_rng_make(seed, 1), [&](uint64_t r) {
+        uint64_t next = bench_mix64(r);
+        if (bench_random_unit(r) < match_rate) {
+            // Rank 1, the most frequent, is order 0.
+            return order_key(bench_zipf_sample(&zipf, next) - 1);
+        }
+        return (int32_t) (2 * bench_random_uniform<int64_t>(next, 0, num_orders - 1) + 1);
+    });
+    bench_fill_uniform<float>(d.l_extendedprice, num_items, 900.0f, 105000.0f, bench_rng_make(seed, 2));
+    bench_generate(d.l_discount, num_items, bench_rng_make(seed, 3), [](uint64_t r) {
+        return bench_random_uniform(r, 0, 10) / 100.0f;
+    });
+    return d;
+}
+
+void free_data(struct gen_data *d) {
+    bench_free(d->l_orderkey);
+    bench_free(d->l_extendedprice);
+    bench_free(d->l_discount);
+    bench_free(d->o_orderkey);
+    bench_free(d->o_shippriority);
+}
+
+/** Checks a join result against the reference. */
+void verify_result(const char *scheme, const struct join_result *expected,
+        const struct join_result *actual, double tolerance) {
+    bench_verify_int(scheme, "matches", expected->matches, actual->matches);
+    bench_verify_int(scheme, "priorities", expected->priorities, actual->priorities);
+    bench_verify_double(scheme, "revenue", expected->revenue, actual->revenue, tolerance);
+}
+
+int main(int argc, char **argv) {
+    // Number of lineitems (should be >> cache size).
+    int64_t num_items = 10000000;
+    // Number of orders.
+    int64_t num_orders = 1000000;
+    // Fraction of lineitems that have an order.
+    double match_rate = 1.0;
+    // Zipf exponent of the orders of matching lineitems.
+    double skew = 0.0;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "b:j:n:z:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'b':
+                num_orders = atoll(optarg);
+                break;
+            case 'j':
+                match_rate = atof(optarg);
+                break;
+            case 'n':
+                num_items = atoll(optarg);
+                break;
+            case 'z':
+                skew = atof(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(num_items > 0);
+    // Keys are even numbers below 2 * num_orders.
+    assert(num_orders > 0 && num_orders <= INT32_MAX / 2);
+    assert(match_rate >= 0.0 && match_rate <= 1.0);
+    assert(skew >= 0.0);
+
+    struct gen_data d = generate_data(num_items, num_orders, match_rate, skew, o.seed);
+    struct join_result result;
+    int partitions = 1 << partition_bits(num_orders);
+
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_query_no_partition(&d, 1); });
+    bench_report_stats("No-partition hash join C++", &stats, "(result=%.4f, matches=%lld)",
+            result.revenue, (long long) result.matches);
+    // Every other scheme must compute the same join.
+    struct join_result expected = result;
+
+    stats = bench_trials(&o, [&] { result = run_query_no_partition(&d, o.threads); });
+    bench_report_stats("Multi-threaded no-partition hash join C++", &stats,
+            "(result=%.4f, matches=%lld, threads=%d)",
+            result.revenue, (long long) result.matches, o.threads);
+    verify_result("Multi-threaded no-partition hash join C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_query_radix(&d, 1); });
+    bench_report_stats("Radix-partitioned hash join C++", &stats,
+            "(result=%.4f, matches=%lld, partitions=%d)",
+            result.revenue, (long long) result.matches, partitions);
+    verify_result("Radix-partitioned hash join C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_query_radix(&d, o.threads); });
+    bench_report_stats("Multi-threaded radix-partitioned hash join C++", &stats,
+            "(result=%.4f, matches=%lld, partitions=%d, threads=%d)",
+            result.revenue, (long long) result.matches, partitions, o.threads);
+    verify_result("Multi-threaded radix-partitioned hash join C++", &expected, &result, o.tolerance);
+
+    result = run_query_weld(&d, &o);
+    verify_result("Weld", &expected, &result, o.tolerance);
+    free_data(&d);
+
+    return bench_verify_status();
+}
@@ -16,14 +16,9 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
 #include <omp.h>
 
-#include "weld.h"
-
-#ifndef NUM_PARALLEL_THREADS
-    #define NUM_PARALLEL_THREADS 4
-#endif
+#include "weld_bench.h"
 
 // The generated input data.
 struct gen_data {
@@ -31,24 +26,10 @@ struct gen_data {
     int32_t *x;
 };
 
-template <typename T>
-struct weld_vector {
-    T *data;
-    int64_t size;
-};
-
 struct args {
     struct weld_vector<int32_t> x;
 };
 
-template <typename T>
-weld_vector<T> make_weld_vector(T *data, int64_t size) {
-    struct weld_vector<T> vector;
-    vector.data = data;
-    vector.size = size;
-    return vector;
-}
-
 int32_t run_query(struct gen_data *d) {
     int32_t sum = 0;
     for (int i = 0; i < d->size; i++) {
@@ -57,83 +38,70 @@ int32_t run_query(struct gen_data *d) {
     return sum;
 }
 
-int32_t run_query_weld(struct gen_data *d) {
-    // Compile Weld module.
-    weld_error_t e = weld_error_new();
-    weld_conf_t conf = weld_conf_new();
-
-    FILE *fptr = fopen("map_reduce.weld", "r");
-    fseek(fptr, 0, SEEK_END);
-    int string_size = ftell(fptr);
-    rewind(fptr);
-    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
-    fread(program, sizeof(char), string_size, fptr);
-    program[string_size] = '\0';
-
-    struct timeval start, end, diff;
-
-    gettimeofday(&start, 0);
-    weld_module_t m = weld_module_compile(program, conf, e);
-    weld_conf_free(conf);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld compile time: %ld.%06ld\n",
-            (long) diff.tv_sec, (long) diff.tv_usec);
-
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+int32_t run_query_range(struct gen_data *d, int64_t start, int64_t end) {
+    int32_t sum = 0;
+    for (int64_t i = start; i < end; i++) {
+        sum += (4 * d->x[i]);
     }
+    return sum;
+}
+
+int32_t run_query_parallel(struct gen_data *d, int threads) {
+    return bench_parallel_sum<int32_t>(threads, d->size, [&](int64_t start, int64_t end) {
+        return run_query_range(d, start, end);
+    });
+}
 
-   gettimeofday(&start, 0);
-   struct args args;
-   args.x = make_weld_vector<int32_t>(d->x, d->size);
-   weld_value_t weld_args = weld_value_new(&args);
-
-   // Run the module and get the result.
-    conf = weld_conf_new();
-    weld_value_t result = weld_module_run(m, conf, weld_args, e);
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+#ifdef __AVX2__
+int32_t run_query_simd_range(struct gen_data *d, int64_t start, int64_t end) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    int64_t i = start;
+    for (; i + 16 <= end; i += 16) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *) &d->x[i]);
+        __m256i x1 = _mm256_loadu_si256((const __m256i *) &d->x[i + 8]);
+        acc0 = _mm256_add_epi32(acc0, _mm256_slli_epi32(x0, 2));
+        acc1 = _mm256_add_epi32(acc1, _mm256_slli_epi32(x1, 2));
     }
-    int32_t *result_data = (int32_t *) weld_value_data(result);
-    int32_t final_result = *result_data;
+    int32_t sum = bench_hsum_epi32(_mm256_add_epi32(acc0, acc1));
+    return sum + run_query_range(d, i, end);
+}
+
+int32_t run_query_simd(struct gen_data *d, int threads) {
+    return bench_parallel_sum<int32_t>(threads, d->size, [&](int64_t start, int64_t end) {
+        return run_query_simd_range(d, start, end);
+    });
+}
+#endif
+
+int32_t run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("map_reduce.weld");
 
-    // Free the values.
-    weld_value_free(result);
-    weld_value_free(weld_args);
-    weld_conf_free(conf);
+    struct args args;
+    args.x = make_weld_vector<int32_t>(d->x, d->size);
 
-    weld_error_free(e);
-    weld_module_free(m);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, final_result);
+    int32_t final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, weld_bench_scalar<int32_t>, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%d)", final_result);
 
+    weld_bench_module_free(&m);
     return final_result;
 }
 
 /** Generates input data.
  *
- * @param num_items the number of line items.
- * @param num_buckets the number of buckets we hash into.
- * @param prob the selectivity of the branch.
+ * @param size the number of elements.
+ * @param seed the seed of the random values.
  * @return the generated data in a structure.
  */
-struct gen_data generate_data(int size) {
+struct gen_data generate_data(int size, uint64_t seed) {
     struct gen_data d;
 
     d.size = size;
-    d.x = (int32_t *)malloc(sizeof(int32_t) * size);
+    d.x = (int32_t *) bench_alloc(sizeof(int32_t) * size);
 
-    srand(1);
-    for (int i = 0; i < d.size; i++) {
-        d.x[i] = rand();
-    }
+    // Values are centered on zero so that sums stay far from int32 overflow.
+    bench_fill_uniform<int32_t>(d.x, size, -100, 100, bench_rng_make(seed, 0));
 
     return d;
 }
@@ -141,8 +109,13 @@ struct gen_data generate_data(int size) {
 int main(int argc, char **argv) {
     int size = (1E8 / sizeof(int));
 
+    struct bench_options o = bench_options_default();
+
     int ch;
-    while ((ch = getopt(argc, argv, "n:")) != -1) {
+    while ((ch = getopt(argc, argv, "n:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
         switch (ch) {
             case 'n':
                 size = atoi(optarg);
@@ -157,21 +130,35 @@ int main(int argc, char **argv) {
     // Check parameters.
     assert(size > 0);
 
-    struct gen_data d = generate_data(size);
+    // Each query streams the input once.
+    o.bytes = (double) size * sizeof(int32_t);
+    o.traffic = BENCH_TRAFFIC_READ;
+
+    struct gen_data d = generate_data(size, o.seed);
     int32_t result;
-    struct timeval start, end, diff;
 
-    gettimeofday(&start, 0);
-    result = run_query(&d);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Single-threaded C++: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, result);
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_query(&d); });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%d)", result);
+    // Every other scheme must compute the same sum.
+    int32_t expected = result;
 
-    free(d.x);
-    d = generate_data(size);
+    stats = bench_trials(&o, [&] { result = run_query_parallel(&d, o.threads); });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    bench_verify_int("Multi-threaded C++", "result", expected, result);
+
+#ifdef __AVX2__
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, 1); });
+    bench_report_stats("SIMD C++", &stats, "(result=%d)", result);
+    bench_verify_int("SIMD C++", "result", expected, result);
+
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, o.threads); });
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    bench_verify_int("Multi-threaded SIMD C++", "result", expected, result);
+#endif
 
-    result = run_query_weld(&d);
+    result = run_query_weld(&d, &o);
+    bench_verify_int("Weld", "result", expected, result);
+    bench_free(d.x);
 
-    return 0;
+    return bench_verify_status();
 }
@@ -0,0 +1,385 @@
+/**
+ * sort.cpp
+ *
+ * ORDER BY and ORDER BY ... LIMIT K over generated lineitem columns: the
+ * rows sorted by extended price, and the K rows with the largest extended
+ * prices in descending order. Each scheme returns (extended price, row)
+ * pairs, so that it moves row references as well as keys, and ties are
+ * broken by row so that every scheme returns the same rows.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include <algorithm>
+#include <functional>
+
+#include "weld_bench.h"
+#include "tpch_lineitem.h"
+
+// Bits of the key each radix sort pass orders by.
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+// The generated input data.
+struct gen_data {
+    int64_t size;
+    // Only the extended prices are sorted by.
+    struct synthetic_lineitems items;
+};
+
+// A row of the output: its sort key and its index in the input.
+struct sort_row {
+    float extended_price;
+    int32_t row;
+};
+
+struct args {
+    struct weld_vector<float> l_extendedprice;
+    int64_t k;
+};
+
+/** Returns true if row a sorts before row b: by extended price, then by
+ * row. */
+inline bool row_less(const struct sort_row &a, const struct sort_row &b) {
+    return a.extended_price < b.extended_price ||
+        (a.extended_price == b.extended_price && a.row < b.row);
+}
+
+inline bool row_greater(const struct sort_row &a, const struct sort_row &b) {
+    return row_less(b, a);
+}
+
+/** Returns the (extended price, row) pair of every row, in row order,
+ * allocated with malloc. */
+struct sort_row *make_rows(struct gen_data *d, int threads) {
+    struct sort_row *rows = (struct sort_row *) malloc(sizeof(struct sort_row) * d->size);
+    const float *prices = d->items.extended_prices;
+    bench_parallel_for(threads, d->size, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            rows[i].extended_price = prices[i];
+            rows[i].row = (int32_t) i;
+        }
+    });
+    return rows;
+}
+
+/** Returns the rows sorted with std::sort. */
+struct sort_row *run_sort_std(struct gen_data *d) {
+    struct sort_row *rows = make_rows(d, 1);
+    std::sort(rows, rows + d->size, row_less);
+    return rows;
+}
+
+/** Returns an unsigned key that orders like the float. */
+inline uint32_t radix_key(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    // Negative floats order in reverse of their bits.
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+/** Returns the radix sort digit of a row for the pass at shift. */
+inline uint32_t radix_digit(const struct sort_row &r, int shift) {
+    return (radix_key(r.extended_price) >> shift) & (RADIX_BUCKETS - 1);
+}
+
+/** Returns the rows sorted with an LSD radix sort.
+ *
+ * Each pass orders by the next RADIX_BITS bits of the key: the threads
+ * count the digits of their contiguous part of the input, then copy it
+ * to the other buffer in a stable order, each thread writing to its own
+ * part of every bucket. A pass in which every key has the same digit is
+ * skipped. The passes are stable and start from row order, so ties stay
+ * in row order.
+ */
+struct sort_row *run_sort_radix(struct gen_data *d, int threads) {
+    int64_t n = d->size;
+    struct sort_row *buffers[2];
+    buffers[0] = make_rows(d, threads);
+    buffers[1] = (struct sort_row *) malloc(sizeof(struct sort_row) * n);
+    int64_t *counts = (int64_t *) malloc(sizeof(int64_t) * threads * RADIX_BUCKETS);
+    int next = 1;
+
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        const struct sort_row *in = buffers[1 - next];
+        struct sort_row *out = buffers[next];
+        bool skip = false;
+#pragma omp parallel num_threads(threads)
+        {
+            int thread = omp_get_thread_num();
+            int num_threads = omp_get_num_threads();
+            int64_t start = bench_range_start(n, thread, num_threads);
+            int64_t end = bench_range_start(n, thread + 1, num_threads);
+            int64_t *local = &counts[thread * RADIX_BUCKETS];
+            memset(local, 0, sizeof(int64_t) * RADIX_BUCKETS);
+            for (int64_t i = start; i < end; i++) {
+                local[radix_digit(in[i], shift)]++;
+            }
+#pragma omp barrier
+#pragma omp single
+            {
+                int64_t offset = 0;
+                for (int b = 0; b < RADIX_BUCKETS; b++) {
+                    int64_t first = offset;
+                    for (int t = 0; t < num_threads; t++) {
+                        int64_t count = counts[t * RADIX_BUCKETS + b];
+                        counts[t * RADIX_BUCKETS + b] = offset;
+                        offset += count;
+                    }
+                    skip |= offset - first == n;
+                }
+            }
+            if (!skip) {
+                for (int64_t i = start; i < end; i++) {
+                    out[local[radix_digit(in[i], shift)]++] = in[i];
+                }
+            }
+        }
+        if (!skip) {
+            next = 1 - next;
+        }
+    }
+
+    free(counts);
+    free(buffers[next]);
+    return buffers[1 - next];
+}
+
+/** Adds a row to a min-heap of at most k of the highest-sorting rows seen. */
+inline void heap_offer(struct sort_row *heap, int64_t *size, int64_t k, struct sort_row r) {
+    if (*size < k) {
+        heap[(*size)++] = r;
+        std::push_heap(heap, heap + *size, row_greater);
+    } else if (row_less(heap[0], r)) {
+        std::pop_heap(heap, heap + k, row_greater);
+        heap[k - 1] = r;
+        std::push_heap(heap, heap + k, row_greater);
+    }
+}
+
+/** Returns the k rows that sort last, in descending order, found with a
+ * bounded min-heap. With more than one thread, each thread keeps a heap
+ * for its part of the rows, and the heaps are then merged.
+ *
+ * @param k at most the number of rows.
+ */
+struct sort_row *run_topk_heap(struct gen_data *d, int64_t k, int threads) {
+    struct sort_row *heaps = (struct sort_row *) malloc(sizeof(struct sort_row) * k * threads);
+    int64_t *sizes = (int64_t *) calloc(threads, sizeof(int64_t));
+    const float *prices = d->items.extended_prices;
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        struct sort_row *heap = &heaps[thread * k];
+        int64_t size = 0;
+        int64_t end = bench_range_start(d->size, thread + 1, num_threads);
+        for (int64_t i = bench_range_start(d->size, thread, num_threads); i < end; i++) {
+            struct sort_row r;
+            r.extended_price = prices[i];
+            r.row = (int32_t) i;
+            heap_offer(heap, &size, k, r);
+        }
+        sizes[thread] = size;
+    }
+
+    // Threads that did not run left their sizes at 0.
+    int64_t size = sizes[0];
+    for (int t = 1; t < threads; t++) {
+        for (int64_t i = 0; i < sizes[t]; i++) {
+            heap_offer(heaps, &size, k, heaps[t * k + i]);
+        }
+    }
+    std::sort_heap(heaps, heaps + size, row_greater);
+    free(sizes);
+    return (struct sort_row *) realloc(heaps, sizeof(struct sort_row) * k);
+}
+
+struct weld_vector<struct sort_row> copy_output(void *data) {
+    weld_vector<struct sort_row> *v = (weld_vector<struct sort_row> *) data;
+    struct sort_row *copy =
+        (struct sort_row *) malloc(sizeof(struct sort_row) * (v->length > 0 ? v->length : 1));
+    memcpy(copy, v->data, sizeof(struct sort_row) * v->length);
+    return make_weld_vector<struct sort_row>(copy, v->length);
+}
+
+/** Times a Weld program, then runs it once more untimed to return its
+ * whole output, allocated with malloc.
+ *
+ * @param index the row of the output whose extended price the timing line
+ * reports.
+ */
+struct weld_vector<struct sort_row> run_query_weld(struct gen_data *d, int64_t k, const char *file,
+        const char *scheme, int64_t index, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile(file);
+
+    struct args args;
+    args.l_extendedprice = make_weld_vector<float>(d->items.extended_prices, d->size);
+    args.k = k;
+
+    float final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, [&](void *data) {
+        weld_vector<struct sort_row> *v = (weld_vector<struct sort_row> *) data;
+        return index < v->length ? v->data[index].extended_price : 0.0f;
+    }, &final_result);
+    bench_report_stats(scheme, &stats, "(result=%.2f)", final_result);
+
+    struct weld_vector<struct sort_row> output =
+        weld_bench_query<struct weld_vector<struct sort_row> >(&m, &args, copy_output);
+    weld_bench_module_free(&m);
+    return output;
+}
+
+/** Checks n output rows against the reference, reporting the first that
+ * differs and how many do. */
+void verify_rows(const char *scheme, const struct sort_row *expected, const struct sort_row *output,
+        int64_t n) {
+    int64_t first = -1;
+    int64_t differ = 0;
+    for (int64_t i = 0; i < n; i++) {
+        if (expected[i].row != output[i].row || expected[i].extended_price != output[i].extended_price) {
+            if (first < 0) {
+                first = i;
+            }
+            differ++;
+        }
+    }
+    if (differ > 0) {
+        bench_verify_fail(scheme, "output[%lld] expected row %d (%.2f), got row %d (%.2f) "
+                "(%lld of %lld rows differ)", (long long) first,
+                expected[first].row, expected[first].extended_price,
+                output[first].row, output[first].extended_price,
+                (long long) differ, (long long) n);
+    }
+}
+
+/** Checks a scheme's output against the reference and frees it. */
+void verify_output(const char *scheme, const struct sort_row *expected, struct sort_row *output,
+        int64_t size) {
+    verify_rows(scheme, expected, output, size);
+    free(output);
+}
+
+/** Checks a Weld output's length and rows against the reference and frees
+ * it. */
+void verify_weld_output(const char *scheme, const struct sort_row *expected,
+        struct weld_vector<struct sort_row> output, int64_t size) {
+    if (bench_verify_int(scheme, "length", size, output.length)) {
+        verify_rows(scheme, expected, output.data, size);
+    }
+    free(output.data);
+}
+
+/** Generates input data with the generator of tpch_q1.
+ *
+ * @param size the number of rows.
+ * @param seed the seed of the random values.
+ * @return the generated data in a structure.
+ */
+struct gen_data generate_data(int64_t size, uint64_t seed) {
+    struct gen_data d;
+
+    d.size = size;
+    synthetic_lineitems_alloc(&d.items, size);
+    // The shipdate cutoff does not matter here: every row is sorted.
+    synthetic_lineitems_generate(&d.items, 0, size, 1.0f, 0, seed);
+
+    return d;
+}
+
+int main(int argc, char **argv) {
+    int64_t size = 10000000;
+    // Number of largest values the top-K schemes return.
+    int64_t k = 1000;
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "k:n:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'k':
+                k = atoll(optarg);
+                break;
+            case 'n':
+                size = atoll(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(size > 0 && size <= INT32_MAX);
+    assert(k > 0);
+    if (k > size) {
+        k = size;
+    }
+
+    struct gen_data d = generate_data(size, o.seed);
+    struct sort_row *output = NULL;
+    // Sort timing lines report the median extended price, top-K lines the
+    // Kth largest.
+    int64_t median = size / 2;
+
+    struct bench_stats stats = bench_trials_output(&o, &output, [&] { return run_sort_std(&d); }, free);
+    bench_report_stats("std::sort C++", &stats, "(result=%.2f)", output[median].extended_price);
+    // Every other scheme must produce the same order.
+    struct sort_row *expected = output;
+    // The top K are the last K rows of the sort, reversed.
+    struct sort_row *expected_topk = (struct sort_row *) malloc(sizeof(struct sort_row) * k);
+    for (int64_t i = 0; i < k; i++) {
+        expected_topk[i] = expected[size - 1 - i];
+    }
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_sort_radix(&d, 1); }, free);
+    bench_report_stats("Radix sort C++", &stats, "(result=%.2f)", output[median].extended_price);
+    verify_output("Radix sort C++", expected, output, size);
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_sort_radix(&d, o.threads); }, free);
+    bench_report_stats("Multi-threaded radix sort C++", &stats, "(result=%.2f, threads=%d)",
+            output[median].extended_price, o.threads);
+    verify_output("Multi-threaded radix sort C++", expected, output, size);
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_topk_heap(&d, k, 1); }, free);
+    bench_report_stats("Heap top-K C++", &stats, "(result=%.2f, k=%lld)",
+            output[k - 1].extended_price, (long long) k);
+    verify_output("Heap top-K C++", expected_topk, output, k);
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_topk_heap(&d, k, o.threads); }, free);
+    bench_report_stats("Multi-threaded heap top-K C++", &stats, "(result=%.2f, k=%lld, threads=%d)",
+            output[k - 1].extended_price, (long long) k, o.threads);
+    verify_output("Multi-threaded heap top-K C++", expected_topk, output, k);
+    output = NULL;
+
+    struct weld_vector<struct sort_row> weld_output =
+        run_query_weld(&d, k, "sort.weld", "Weld sort", median, &o);
+    verify_weld_output("Weld sort", expected, weld_output, size);
+    weld_output = run_query_weld(&d, k, "sort_topk.weld", "Weld top-K", k - 1, &o);
+    verify_weld_output("Weld top-K", expected_topk, weld_output, k);
+
+    free(expected_topk);
+    free(expected);
+    synthetic_lineitems_free(&d.items);
+
+    return bench_verify_status();
+}
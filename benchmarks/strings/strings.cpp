@@ -0,0 +1,672 @@
+/**
+ * strings.cpp
+ *
+ * Filters and a group-by over a variable-length string column, stored
+ * once as the rows' own strings and once dictionary-encoded, to compare
+ * the cost of comparing and hashing string bytes with that of working on
+ * integer codes.
+ *
+ */
+
+#ifdef __linux__
+#define _BSD_SOURCE 500
+#define _POSIX_C_SOURCE 2
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include <string>
+#include <unordered_map>
+
+#include "weld_bench.h"
+
+// Multiplier of the string hash and of the hash table's slot placement.
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+// Slots of a new string hash table. It doubles when half full.
+#define INITIAL_TABLE_CAPACITY 1024
+// Longest generated string: the longest family, two dashes, a base-36
+// dictionary code and the padding.
+#define MAX_STRING_LENGTH 32
+// Most lowercase letters that pad a generated string.
+#define MAX_PADDING 8
+
+// The first word of every generated string, the TPC-H ship modes. A prefix
+// filter on one of them selects about a seventh of the dictionary.
+static const char *FAMILIES[] = {"AIR", "FOB", "MAIL", "RAIL", "REG AIR", "SHIP", "TRUCK"};
+#define NUM_FAMILIES (sizeof(FAMILIES) / sizeof(FAMILIES[0]))
+
+// A string that is not NUL-terminated, laid out like a Weld vec[i8].
+struct string_ref {
+    const char *data;
+    int64_t length;
+};
+
+// The generated input data.
+struct gen_data {
+    int64_t size;
+    // The string column, with each row's bytes copied into one buffer, as
+    // a loader stores a column it does not encode.
+    struct string_ref *keys;
+    char *key_bytes;
+    // The same column dictionary-encoded: row i's string is dict[codes[i]].
+    int32_t *codes;
+    int64_t dict_size;
+    struct string_ref *dict;
+    char *dict_bytes;
+    float *l_extendedprice;
+    // Weld vectors over keys and dict.
+    struct weld_vector<int8_t> *weld_keys;
+    struct weld_vector<int8_t> *weld_dict;
+};
+
+struct string_args {
+    struct weld_vector<struct weld_vector<int8_t> > keys;
+    struct weld_vector<float> l_extendedprice;
+    struct weld_vector<int8_t> pattern;
+};
+
+struct dictionary_args {
+    struct weld_vector<int32_t> codes;
+    struct weld_vector<float> l_extendedprice;
+    struct weld_vector<struct weld_vector<int8_t> > dict;
+    struct weld_vector<int8_t> pattern;
+};
+
+// The result of a filter, laid out as the Weld programs return it.
+struct filter_result {
+    // Number of rows that pass.
+    int64_t count;
+    // Sum of l_extendedprice over those rows.
+    double sum;
+};
+
+// The result of a group-by, indexed by dictionary code so that schemes
+// keyed by strings and by codes can be compared.
+struct group_sums {
+    int64_t *counts;
+    double *sums;
+    // Groups whose string is not in the dictionary; always 0 when correct.
+    int64_t unknown;
+};
+
+// A slot of the string hash table, unused if data is NULL.
+struct string_slot {
+    const char *data;
+    int64_t length;
+    uint64_t hash;
+    int64_t count;
+    double sum;
+};
+
+struct string_table {
+    struct string_slot *slots;
+    int64_t capacity;
+    int64_t size;
+};
+
+// An element of the string group-by's Weld output.
+struct weld_string_group {
+    struct weld_vector<int8_t> key;
+    int64_t count;
+    double sum;
+};
+
+// An element of the dictionary group-by's Weld output.
+struct weld_code_group {
+    int64_t count;
+    double sum;
+};
+
+inline bool has_prefix(struct string_ref s, struct string_ref prefix) {
+    return s.length >= prefix.length && memcmp(s.data, prefix.data, prefix.length) == 0;
+}
+
+inline bool equals(struct string_ref s, struct string_ref value) {
+    return s.length == value.length && memcmp(s.data, value.data, value.length) == 0;
+}
+
+/** Returns a hash of a string's bytes, read eight at a time. */
+inline uint64_t hash_string(struct string_ref s) {
+    uint64_t h = (uint64_t) s.length * HASH_MULTIPLIER;
+    int64_t i = 0;
+    for (; i + 8 <= s.length; i += 8) {
+        uint64_t word;
+        memcpy(&word, s.data + i, 8);
+        h = (h ^ word) * HASH_MULTIPLIER;
+        h ^= h >> 32;
+    }
+    if (i < s.length) {
+        uint64_t word = 0;
+        memcpy(&word, s.data + i, s.length - i);
+        h = (h ^ word) * HASH_MULTIPLIER;
+        h ^= h >> 32;
+    }
+    return bench_mix64(h);
+}
+
+/** Sums the prices of the rows for which match(i) is true. Each thread
+ * sums a contiguous part of the rows. */
+template <typename F>
+struct filter_result run_filter(struct gen_data *d, int threads, F match) {
+    struct filter_result result = {0, 0.0};
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        int64_t end = bench_range_start(d->size, thread + 1, num_threads);
+        int64_t count = 0;
+        double sum = 0.0;
+        for (int64_t i = bench_range_start(d->size, thread, num_threads); i < end; i++) {
+            if (match(i)) {
+                count++;
+                sum += d->l_extendedprice[i];
+            }
+        }
+#pragma omp critical
+        {
+            result.count += count;
+            result.sum += sum;
+        }
+    }
+    return result;
+}
+
+/** Filters on the row strings, comparing each row's bytes with prefix. */
+struct filter_result run_prefix_strings(struct gen_data *d, struct string_ref prefix, int threads) {
+    return run_filter(d, threads, [&](int64_t i) { return has_prefix(d->keys[i], prefix); });
+}
+
+/** Filters on the row strings, comparing each row's bytes with value. */
+struct filter_result run_equal_strings(struct gen_data *d, struct string_ref value, int threads) {
+    return run_filter(d, threads, [&](int64_t i) { return equals(d->keys[i], value); });
+}
+
+/** Filters on the dictionary codes: evaluates the predicate once per
+ * dictionary entry, then looks each row's code up in the resulting mask. */
+template <typename P>
+struct filter_result run_filter_dictionary(struct gen_data *d, int threads, P predicate) {
+    uint8_t *mask = (uint8_t *) malloc(d->dict_size);
+    for (int64_t c = 0; c < d->dict_size; c++) {
+        mask[c] = predicate(d->dict[c]);
+    }
+    struct filter_result result = run_filter(d, threads, [&](int64_t i) { return mask[d->codes[i]] != 0; });
+    free(mask);
+    return result;
+}
+
+struct filter_result run_prefix_dictionary(struct gen_data *d, struct string_ref prefix, int threads) {
+    return run_filter_dictionary(d, threads, [&](struct string_ref s) { return has_prefix(s, prefix); });
+}
+
+struct filter_result run_equal_dictionary(struct gen_data *d, struct string_ref value, int threads) {
+    return run_filter_dictionary(d, threads, [&](struct string_ref s) { return equals(s, value); });
+}
+
+struct string_table string_table_make(int64_t capacity) {
+    struct string_table t;
+    t.slots = (struct string_slot *) calloc(capacity, sizeof(struct string_slot));
+    t.capacity = capacity;
+    t.size = 0;
+    return t;
+}
+
+/** Returns the slot of a string, claiming an unused one if the string is
+ * not in the table. */
+inline struct string_slot *string_table_find(struct string_table *t, struct string_ref s, uint64_t hash) {
+    int64_t mask = t->capacity - 1;
+    for (int64_t i = (int64_t) (hash & mask);; i = (i + 1) & mask) {
+        struct string_slot *slot = &t->slots[i];
+        if (slot->data == NULL) {
+            slot->data = s.data;
+            slot->length = s.length;
+            slot->hash = hash;
+            t->size++;
+            return slot;
+        }
+        if (slot->hash == hash && slot->length == s.length && memcmp(slot->data, s.data, s.length) == 0) {
+            return slot;
+        }
+    }
+}
+
+/** Doubles the capacity of a table, moving its groups to new slots. */
+void string_table_grow(struct string_table *t) {
+    struct string_table bigger = string_table_make(t->capacity * 2);
+    for (int64_t i = 0; i < t->capacity; i++) {
+        struct string_slot *slot = &t->slots[i];
+        if (slot->data != NULL) {
+            int64_t mask = bigger.capacity - 1;
+            int64_t j = (int64_t) (slot->hash & mask);
+            while (bigger.slots[j].data != NULL) {
+                j = (j + 1) & mask;
+            }
+            bigger.slots[j] = *slot;
+        }
+    }
+    bigger.size = t->size;
+    free(t->slots);
+    *t = bigger;
+}
+
+/** Groups on the row strings with a hash table keyed by their bytes. The
+ * table's keys point into the input. */
+struct string_table run_group_strings(struct gen_data *d) {
+    struct string_table t = string_table_make(INITIAL_TABLE_CAPACITY);
+    for (int64_t i = 0; i < d->size; i++) {
+        struct string_ref key = d->keys[i];
+        struct string_slot *slot = string_table_find(&t, key, hash_string(key));
+        slot->count++;
+        slot->sum += d->l_extendedprice[i];
+        if (t.size * 2 > t.capacity) {
+            string_table_grow(&t);
+        }
+    }
+    return t;
+}
+
+struct group_sums group_sums_make(int64_t dict_size) {
+    struct group_sums g;
+    g.counts = (int64_t *) calloc(dict_size, sizeof(int64_t));
+    g.sums = (double *) calloc(dict_size, sizeof(double));
+    g.unknown = 0;
+    return g;
+}
+
+void group_sums_free(struct group_sums *g) {
+    free(g->counts);
+    free(g->sums);
+    g->counts = NULL;
+    g->sums = NULL;
+}
+
+/** Groups on the dictionary codes, which index the groups directly. */
+struct group_sums run_group_dictionary(struct gen_data *d) {
+    struct group_sums g = group_sums_make(d->dict_size);
+    for (int64_t i = 0; i < d->size; i++) {
+        g.counts[d->codes[i]]++;
+        g.sums[d->codes[i]] += d->l_extendedprice[i];
+    }
+    return g;
+}
+
+typedef std::unordered_map<std::string, int32_t> code_map;
+
+/** Returns the code of a group's string, or -1 if it is not in the
+ * dictionary. */
+int32_t lookup_code(const code_map *codes, const char *data, int64_t length) {
+    code_map::const_iterator it = codes->find(std::string(data, length));
+    return it == codes->end() ? -1 : it->second;
+}
+
+/** Converts the groups of a string hash table to per-code sums and frees
+ * the table. */
+struct group_sums string_table_sums(struct string_table *t, const code_map *codes, int64_t dict_size) {
+    struct group_sums g = group_sums_make(dict_size);
+    for (int64_t i = 0; i < t->capacity; i++) {
+        struct string_slot *slot = &t->slots[i];
+        if (slot->data != NULL) {
+            int32_t code = lookup_code(codes, slot->data, slot->length);
+            if (code >= 0) {
+                g.counts[code] += slot->count;
+                g.sums[code] += slot->sum;
+            } else {
+                g.unknown++;
+            }
+        }
+    }
+    free(t->slots);
+    t->slots = NULL;
+    return g;
+}
+
+/** Checks a group-by's per-code sums against the reference and frees
+ * them. Stops at the first sum that differs. */
+void verify_groups(const char *scheme, const struct group_sums *expected, struct group_sums *actual,
+        int64_t dict_size, double tolerance) {
+    bench_verify_int(scheme, "unknown groups", 0, actual->unknown);
+    bench_verify_array(scheme, "count", expected->counts, actual->counts, dict_size);
+    for (int64_t c = 0; c < dict_size; c++) {
+        if (!bench_verify_double(scheme, "sum", expected->sums[c], actual->sums[c], tolerance)) {
+            break;
+        }
+    }
+    group_sums_free(actual);
+}
+
+void verify_filter(const char *scheme, const struct filter_result *expected,
+        const struct filter_result *actual, double tolerance) {
+    bench_verify_int(scheme, "count", expected->count, actual->count);
+    bench_verify_double(scheme, "sum", expected->sum, actual->sum, tolerance);
+}
+
+inline struct weld_vector<int8_t> weld_string(struct string_ref s) {
+    return make_weld_vector<int8_t>((int8_t *) s.data, s.length);
+}
+
+struct string_args make_string_args(struct gen_data *d, struct string_ref pattern) {
+    struct string_args args;
+    args.keys = make_weld_vector<struct weld_vector<int8_t> >(d->weld_keys, d->size);
+    args.l_extendedprice = make_weld_vector<float>(d->l_extendedprice, d->size);
+    args.pattern = weld_string(pattern);
+    return args;
+}
+
+struct dictionary_args make_dictionary_args(struct gen_data *d, struct string_ref pattern) {
+    struct dictionary_args args;
+    args.codes = make_weld_vector<int32_t>(d->codes, d->size);
+    args.l_extendedprice = make_weld_vector<float>(d->l_extendedprice, d->size);
+    args.dict = make_weld_vector<struct weld_vector<int8_t> >(d->weld_dict, d->dict_size);
+    args.pattern = weld_string(pattern);
+    return args;
+}
+
+/** Times a Weld filter program and checks its result. */
+void run_filter_weld(const char *file, const char *scheme, void *args,
+        const struct filter_result *expected, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile(file);
+    struct filter_result result;
+    struct bench_stats stats = weld_bench_trials(o, &m, args, [](void *data) {
+        return *(struct filter_result *) data;
+    }, &result);
+    bench_report_stats(scheme, &stats, "(result=%.4f, matches=%lld)",
+            result.sum, (long long) result.count);
+    verify_filter(scheme, expected, &result, o->tolerance);
+    weld_bench_module_free(&m);
+}
+
+/** Times the Weld string group-by, then runs it once more untimed to map
+ * its groups to dictionary codes for reporting and checking. */
+struct group_sums run_group_strings_weld(struct gen_data *d, const code_map *codes,
+        const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("strings_group.weld");
+    struct string_args args = make_string_args(d, d->dict[0]);
+
+    int64_t groups;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, [](void *data) {
+        return ((weld_vector<struct weld_string_group> *) data)->length;
+    }, &groups);
+    struct group_sums g = weld_bench_query<struct group_sums>(&m, &args, [&](void *data) {
+        weld_vector<struct weld_string_group> *v = (weld_vector<struct weld_string_group> *) data;
+        struct group_sums sums = group_sums_make(d->dict_size);
+        for (int64_t i = 0; i < v->length; i++) {
+            struct weld_string_group *group = &v->data[i];
+            int32_t code = lookup_code(codes, (const char *) group->key.data, group->key.length);
+            if (code >= 0) {
+                sums.counts[code] += group->count;
+                sums.sums[code] += group->sum;
+            } else {
+                sums.unknown++;
+            }
+        }
+        return sums;
+    });
+    bench_report_stats("Weld string group-by", &stats, "(result=%.4f, groups=%lld)",
+            g.sums[0], (long long) groups);
+    weld_bench_module_free(&m);
+    return g;
+}
+
+/** Times the Weld dictionary group-by and returns its per-code sums from
+ * the last run. */
+struct group_sums run_group_dictionary_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("dictionary_group.weld");
+    struct dictionary_args args = make_dictionary_args(d, d->dict[0]);
+    int64_t dict_size = d->dict_size;
+
+    struct group_sums g = {NULL, NULL, 0};
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, [&](void *data) {
+        weld_vector<struct weld_code_group> *v = (weld_vector<struct weld_code_group> *) data;
+        group_sums_free(&g);
+        struct group_sums sums = group_sums_make(dict_size);
+        for (int64_t c = 0; c < v->length && c < dict_size; c++) {
+            sums.counts[c] = v->data[c].count;
+            sums.sums[c] = v->data[c].sum;
+        }
+        return sums;
+    }, &g);
+    bench_report_stats("Weld dictionary group-by", &stats, "(result=%.4f)", g.sums[0]);
+    weld_bench_module_free(&m);
+    return g;
+}
+
+/** Writes the string of a dictionary code to out: a family, the code in
+ * base 36, which makes the string unique, and a random padding of
+ * lowercase letters, all separated by dashes.
+ *
+ * @return the length of the string.
+ */
+int64_t format_entry(char *out, int64_t code, uint64_t r) {
+    char digits[16];
+    int num_digits = 0;
+    do {
+        digits[num_digits++] = "0123456789abcdefghijklmnopqrstuvwxyz"[code % 36];
+        code /= 36;
+    } while (code > 0);
+
+    int64_t length = 0;
+    const char *family = FAMILIES[r % NUM_FAMILIES];
+    r = bench_mix64(r);
+    memcpy(out, family, strlen(family));
+    length += strlen(family);
+    out[length++] = '-';
+    while (num_digits > 0) {
+        out[length++] = digits[--num_digits];
+    }
+    out[length++] = '-';
+    int padding = (int) (r % (MAX_PADDING + 1));
+    for (int i = 0; i < padding; i++) {
+        r = bench_mix64(r);
+        out[length++] = 'a' + r % 26;
+    }
+    return length;
+}
+
+/** Generates input data.
+ *
+ * @param size the number of rows.
+ * @param dict_size the number of distinct strings.
+ * @param skew the Zipf exponent of the rows' strings. Code 0 is the most
+ * frequent.
+ * @param seed the seed of the random values.
+ * @return the generated data in a structure.
+ */
+struct gen_data generate_data(int64_t size, int64_t dict_size, double skew, uint64_t seed) {
+    struct gen_data d;
+    d.size = size;
+    d.dict_size = dict_size;
+
+    d.dict = (struct string_ref *) bench_alloc(sizeof(struct string_ref) * dict_size);
+    d.dict_bytes = (char *) bench_alloc(MAX_STRING_LENGTH * dict_size);
+    struct bench_rng dict_rng = bench_rng_make(seed, 0);
+    for (int64_t c = 0; c < dict_size; c++) {
+        char *entry = d.dict_bytes + MAX_STRING_LENGTH * c;
+        d.dict[c].data = entry;
+        d.dict[c].length = format_entry(entry, c, bench_random(dict_rng, c));
+    }
+
+    d.codes = (int32_t *) bench_alloc(sizeof(int32_t) * size);
+    struct bench_zipf zipf = bench_zipf_make(dict_size, skew);
+    bench_generate(d.codes, size, bench_rng_make(seed, 1), [&](uint64_t r) {
+        return (int32_t) (bench_zipf_sample(&zipf, r) - 1);
+    });
+    d.l_extendedprice = (float *) bench_alloc(sizeof(float) * size);
+    bench_fill_uniform<float>(d.l_extendedprice, size, 900.0f, 105000.0f, bench_rng_make(seed, 2));
+
+    // Copy each row's string after the previous row's.
+    d.keys = (struct string_ref *) bench_alloc(sizeof(struct string_ref) * size);
+    int64_t total = 0;
+    for (int64_t i = 0; i < size; i++) {
+        d.keys[i].length = d.dict[d.codes[i]].length;
+        total += d.keys[i].length;
+    }
+    d.key_bytes = (char *) bench_alloc(total > 0 ? total : 1);
+    int64_t offset = 0;
+    for (int64_t i = 0; i < size; i++) {
+        d.keys[i].data = d.key_bytes + offset;
+        offset += d.keys[i].length;
+    }
+    bench_parallel_for(omp_get_max_threads(), size, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            memcpy((char *) d.keys[i].data, d.dict[d.codes[i]].data, d.keys[i].length);
+        }
+    });
+
+    d.weld_keys = (struct weld_vector<int8_t> *) bench_alloc(sizeof(struct weld_vector<int8_t>) * size);
+    for (int64_t i = 0; i < size; i++) {
+        d.weld_keys[i] = weld_string(d.keys[i]);
+    }
+    d.weld_dict = (struct weld_vector<int8_t> *) bench_alloc(sizeof(struct weld_vector<int8_t>) * dict_size);
+    for (int64_t c = 0; c < dict_size; c++) {
+        d.weld_dict[c] = weld_string(d.dict[c]);
+    }
+    return d;
+}
+
+void free_data(struct gen_data *d) {
+    bench_free(d->keys);
+    bench_free(d->key_bytes);
+    bench_free(d->codes);
+    bench_free(d->dict);
+    bench_free(d->dict_bytes);
+    bench_free(d->l_extendedprice);
+    bench_free(d->weld_keys);
+    bench_free(d->weld_dict);
+}
+
+int main(int argc, char **argv) {
+    // Number of rows (should be >> cache size).
+    int64_t size = 10000000;
+    // Number of distinct strings.
+    int64_t dict_size = 10000;
+    // Zipf exponent of the rows' strings.
+    double skew = 0.0;
+    // Prefix of the prefix filter.
+    const char *prefix = "MAIL";
+
+    struct bench_options o = bench_options_default();
+
+    int ch;
+    while ((ch = getopt(argc, argv, "g:n:x:z:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
+        switch (ch) {
+            case 'g':
+                dict_size = atoll(optarg);
+                break;
+            case 'n':
+                size = atoll(optarg);
+                break;
+            case 'x':
+                prefix = optarg;
+                break;
+            case 'z':
+                skew = atof(optarg);
+                break;
+            case '?':
+            default:
+                fprintf(stderr, "invalid options");
+                exit(1);
+        }
+    }
+
+    // Check parameters.
+    assert(size > 0);
+    assert(dict_size > 0 && dict_size <= INT32_MAX);
+    assert(skew >= 0.0);
+
+    struct gen_data d = generate_data(size, dict_size, skew, o.seed);
+    struct string_ref prefix_ref = {prefix, (int64_t) strlen(prefix)};
+    // The equality filter selects the most frequent string.
+    struct string_ref value = d.dict[0];
+    code_map codes;
+    for (int64_t c = 0; c < dict_size; c++) {
+        codes[std::string(d.dict[c].data, d.dict[c].length)] = (int32_t) c;
+    }
+
+    struct filter_result result;
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_prefix_strings(&d, prefix_ref, 1); });
+    bench_report_stats("String prefix filter C++", &stats, "(result=%.4f, matches=%lld)",
+            result.sum, (long long) result.count);
+    // Every other prefix filter must select the same rows.
+    struct filter_result expected = result;
+
+    stats = bench_trials(&o, [&] { result = run_prefix_strings(&d, prefix_ref, o.threads); });
+    bench_report_stats("Multi-threaded string prefix filter C++", &stats,
+            "(result=%.4f, matches=%lld, threads=%d)", result.sum, (long long) result.count, o.threads);
+    verify_filter("Multi-threaded string prefix filter C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_prefix_dictionary(&d, prefix_ref, 1); });
+    bench_report_stats("Dictionary prefix filter C++", &stats, "(result=%.4f, matches=%lld)",
+            result.sum, (long long) result.count);
+    verify_filter("Dictionary prefix filter C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_prefix_dictionary(&d, prefix_ref, o.threads); });
+    bench_report_stats("Multi-threaded dictionary prefix filter C++", &stats,
+            "(result=%.4f, matches=%lld, threads=%d)", result.sum, (long long) result.count, o.threads);
+    verify_filter("Multi-threaded dictionary prefix filter C++", &expected, &result, o.tolerance);
+
+    struct string_args string_args = make_string_args(&d, prefix_ref);
+    run_filter_weld("strings_prefix.weld", "Weld string prefix filter", &string_args, &expected, &o);
+    struct dictionary_args dictionary_args = make_dictionary_args(&d, prefix_ref);
+    run_filter_weld("dictionary_prefix.weld", "Weld dictionary prefix filter", &dictionary_args,
+            &expected, &o);
+
+    stats = bench_trials(&o, [&] { result = run_equal_strings(&d, value, 1); });
+    bench_report_stats("String equality filter C++", &stats, "(result=%.4f, matches=%lld)",
+            result.sum, (long long) result.count);
+    // Every other equality filter must select the same rows.
+    expected = result;
+
+    stats = bench_trials(&o, [&] { result = run_equal_strings(&d, value, o.threads); });
+    bench_report_stats("Multi-threaded string equality filter C++", &stats,
+            "(result=%.4f, matches=%lld, threads=%d)", result.sum, (long long) result.count, o.threads);
+    verify_filter("Multi-threaded string equality filter C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_equal_dictionary(&d, value, 1); });
+    bench_report_stats("Dictionary equality filter C++", &stats, "(result=%.4f, matches=%lld)",
+            result.sum, (long long) result.count);
+    verify_filter("Dictionary equality filter C++", &expected, &result, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result = run_equal_dictionary(&d, value, o.threads); });
+    bench_report_stats("Multi-threaded dictionary equality filter C++", &stats,
+            "(result=%.4f, matches=%lld, threads=%d)", result.sum, (long long) result.count, o.threads);
+    verify_filter("Multi-threaded dictionary equality filter C++", &expected, &result, o.tolerance);
+
+    string_args = make_string_args(&d, value);
+    run_filter_weld("strings_equal.weld", "Weld string equality filter", &string_args, &expected, &o);
+    dictionary_args = make_dictionary_args(&d, value);
+    run_filter_weld("dictionary_equal.weld", "Weld dictionary equality filter", &dictionary_args,
+            &expected, &o);
+
+    struct string_table table = {NULL, 0, 0};
+    stats = bench_trials_output(&o, &table, [&] { return run_group_strings(&d); },
+            [](struct string_table t) { free(t.slots); });
+    int64_t num_groups = table.size;
+    // Every other group-by must compute the same sums.
+    struct group_sums expected_groups = string_table_sums(&table, &codes, dict_size);
+    bench_report_stats("String group-by C++", &stats, "(result=%.4f, groups=%lld)",
+            expected_groups.sums[0], (long long) num_groups);
+    bench_verify_int("String group-by C++", "unknown groups", 0, expected_groups.unknown);
+
+    struct group_sums groups = {NULL, NULL, 0};
+    stats = bench_trials_output(&o, &groups, [&] { return run_group_dictionary(&d); },
+            [](struct group_sums g) { group_sums_free(&g); });
+    bench_report_stats("Dictionary group-by C++", &stats, "(result=%.4f)", groups.sums[0]);
+    verify_groups("Dictionary group-by C++", &expected_groups, &groups, dict_size, o.tolerance);
+
+    groups = run_group_strings_weld(&d, &codes, &o);
+    verify_groups("Weld string group-by", &expected_groups, &groups, dict_size, o.tolerance);
+    groups = run_group_dictionary_weld(&d, &o);
+    verify_groups("Weld dictionary group-by", &expected_groups, &groups, dict_size, o.tolerance);
+
+    group_sums_free(&expected_groups);
+    free_data(&d);
+
+    return bench_verify_status();
+}
@@ -16,26 +16,37 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <math.h>
+#include <sys/stat.h>
 #include <omp.h>
 
-#include "weld.h"
+#include "weld_bench.h"
+#include "bench_columns.h"
+#include "tpch_lineitem.h"
 
 // Value for the predicate to pass.
 #define PASS 19980901
 #define NUM_BUCKETS 6
+// Bytes per cache line, used to keep per-thread aggregates apart.
+#define CACHE_LINE_SIZE 64
+// Rows the SIMD kernel sums in float before adding to the double sums. Each
+// lane adds 64 values, few enough that float rounding stays far below the
+// verification tolerance.
+#define SIMD_BLOCK_ROWS 512
 
-// A bucket entry.
+// A bucket entry. Sums are kept in double: a float running sum of millions
+// of values drifts by percents from the exact sum, and by more than half of
+// it at a billion rows.
 struct bucket_entry {
-    float sum_qty;
-    float sum_base_price;
-    float sum_disc_price;
-    float sum_charge;
-    float sum_discount;
+    double sum_qty;
+    double sum_base_price;
+    double sum_disc_price;
+    double sum_charge;
+    double sum_discount;
     int32_t count;
 
-    // Pad to 32 bytes.
-    int8_t _pad[8];
+    // Pad to 48 bytes.
+    int8_t _pad[4];
 };
 
 // The generated input data.
@@ -45,26 +56,11 @@ struct gen_data {
     // Probability that the branch in the query will be taken.
     float prob;
     // The input data.
-    struct lineitems *items;
+    struct synthetic_lineitems *items;
     // The hash table.
     struct bucket_entry *buckets;
-};
-
-// An input data item represented as in a row format.
-struct lineitems {
-    int8_t *return_flags;
-    int8_t *line_statuses;
-    float *quantities;
-    float *extended_prices;
-    float *discounts;
-    int32_t *shipdates;
-    float *taxes;
-};
-
-template <typename T>
-struct weld_vector {
-    T *data;
-    int64_t length;
+    // The column file the input data is mapped from, if base is not NULL.
+    struct column_file cache;
 };
 
 struct args {
@@ -78,25 +74,17 @@ struct args {
 };
 
 struct output {
-    float elem1;
-    float elem2;
-    float elem3;
-    float elem4;
-    float elem5;
+    double elem1;
+    double elem2;
+    double elem3;
+    double elem4;
+    double elem5;
     int32_t elem6;
 };
 
-template <typename T>
-weld_vector<T> make_weld_vector(T *data, int64_t length) {
-    struct weld_vector<T> vector;
-    vector.data = data;
-    vector.length = length;
-    return vector;
-}
-
 int32_t run_query(struct gen_data *d) {
     for (int i = 0; i < d->num_items; i++) {
-        struct lineitems *items = d->items;
+        struct synthetic_lineitems *items = d->items;
         if (items->shipdates[i] <= PASS) {
             int bucket = (2 * items->return_flags[i]) + items->line_statuses[i];
             struct bucket_entry *e = &d->buckets[bucket];
@@ -113,128 +101,1020 @@ int32_t run_query(struct gen_data *d) {
     return d->buckets[0].count + (int32_t) d->buckets[0].sum_discount;
 }
 
-int32_t run_query_weld(struct gen_data *d) {
-    // Compile Weld module.
-    weld_error_t e = weld_error_new();
-    weld_conf_t conf = weld_conf_new();
-
-    FILE *fptr = fopen("tpch_q1.weld", "r");
-    fseek(fptr, 0, SEEK_END);
-    int string_size = ftell(fptr);
-    rewind(fptr);
-    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
-    fread(program, sizeof(char), string_size, fptr);
-    program[string_size] = '\0';
-
-    struct timeval start, end, diff;
-    gettimeofday(&start, 0);
-    weld_module_t m = weld_module_compile(program, conf, e);
-    weld_conf_free(conf);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld compile time: %ld.%06ld\n",
-            (long) diff.tv_sec, (long) diff.tv_usec);
-
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+/** Aggregates rows [start, end) into buckets. */
+void run_query_range(struct synthetic_lineitems *items, int64_t start, int64_t end,
+        struct bucket_entry *buckets) {
+    for (int64_t i = start; i < end; i++) {
+        if (items->shipdates[i] <= PASS) {
+            int bucket = (2 * items->return_flags[i]) + items->line_statuses[i];
+            struct bucket_entry *e = &buckets[bucket];
+            e->sum_qty += items->quantities[i];
+            e->sum_base_price += items->extended_prices[i];
+            float disc_price = (items->extended_prices[i] * (1 - items->discounts[i]));
+            e->sum_disc_price += disc_price;
+            e->sum_charge +=
+                (disc_price * (1 + items->taxes[i]));
+            e->sum_discount += items->discounts[i];
+            e->count++;
+        }
     }
+}
 
-   gettimeofday(&start, 0);
-   struct args args;
-   args.return_flags = make_weld_vector<int8_t>(d->items->return_flags, d->num_items);
-   args.line_statuses = make_weld_vector<int8_t>(d->items->line_statuses, d->num_items);
-   args.quantities = make_weld_vector<float>(d->items->quantities, d->num_items);
-   args.extended_prices = make_weld_vector<float>(d->items->extended_prices, d->num_items);
-   args.discounts = make_weld_vector<float>(d->items->discounts, d->num_items);
-   args.shipdates = make_weld_vector<int32_t>(d->items->shipdates, d->num_items);
-   args.taxes = make_weld_vector<float>(d->items->taxes, d->num_items);
-   weld_value_t weld_args = weld_value_new(&args);
-
-   // Run the module and get the result.
-    conf = weld_conf_new();
-    weld_value_t result = weld_module_run(m, conf, weld_args, e);
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
+/** Adds the aggregates in src to dst. */
+void merge_buckets(struct bucket_entry *dst, const struct bucket_entry *src) {
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        dst[b].sum_qty += src[b].sum_qty;
+        dst[b].sum_base_price += src[b].sum_base_price;
+        dst[b].sum_disc_price += src[b].sum_disc_price;
+        dst[b].sum_charge += src[b].sum_charge;
+        dst[b].sum_discount += src[b].sum_discount;
+        dst[b].count += src[b].count;
+    }
+}
+
+// Per-thread bucket arrays for partitioned aggregation. Each thread's array
+// starts on its own cache line, so no two threads ever write to the same line.
+struct partitioned_buckets {
+    // Number of threads that aggregated into the arrays.
+    int num_threads;
+    // Distance in entries between consecutive threads' arrays.
+    int stride;
+    struct bucket_entry *entries;
+};
+
+struct partitioned_buckets partitioned_buckets_new(int num_threads) {
+    struct partitioned_buckets p;
+    size_t bytes = sizeof(struct bucket_entry) * NUM_BUCKETS;
+    bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    p.num_threads = num_threads;
+    p.stride = bytes / sizeof(struct bucket_entry);
+    if (posix_memalign((void **) &p.entries, CACHE_LINE_SIZE, bytes * num_threads) != 0) {
+        fprintf(stderr, "could not allocate partitioned buckets");
         exit(1);
     }
-    weld_vector<struct output> *result_data = (weld_vector<struct output> *) weld_value_data(result);
-    int32_t final_result = result_data->data[0].elem6 + (int32_t) result_data->data[0].elem5;
+    return p;
+}
+
+struct bucket_entry *partition_for(struct partitioned_buckets *p, int thread) {
+    return &p->entries[thread * p->stride];
+}
+
+/** Runs kernel over one contiguous range per thread, each thread aggregating
+ * into its own partition, then merges the partitions into d->buckets.
+ *
+ * @param kernel called as kernel(items, start, end, buckets).
+ */
+template <typename K>
+int32_t run_query_partitioned(struct gen_data *d, int threads, K kernel) {
+    struct partitioned_buckets p = partitioned_buckets_new(threads);
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        if (thread == 0) {
+            p.num_threads = num_threads;
+        }
+        // Zeroed by the owning thread, so the partition is first touched locally.
+        struct bucket_entry *local = partition_for(&p, thread);
+        memset(local, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+        kernel(d->items,
+                bench_range_start(d->num_items, thread, num_threads),
+                bench_range_start(d->num_items, thread + 1, num_threads),
+                local);
+    }
+
+    for (int t = 0; t < p.num_threads; t++) {
+        merge_buckets(d->buckets, partition_for(&p, t));
+    }
+    free(p.entries);
+    return d->buckets[0].count + (int32_t) d->buckets[0].sum_discount;
+}
+
+int32_t run_query_parallel(struct gen_data *d, int threads) {
+    return run_query_partitioned(d, threads, run_query_range);
+}
+
+#ifdef __AVX2__
+/** Aggregates rows [start, end) into buckets without branches.
+ *
+ * Every bucket keeps its own vector accumulators; each group of eight rows is
+ * added to all of them under a (bucket matches && shipdate passes) mask. The
+ * float accumulators are added to the buckets' double sums after every
+ * SIMD_BLOCK_ROWS rows, so each lane sums only a few values in float.
+ */
+void run_query_simd_range(struct synthetic_lineitems *items, int64_t start, int64_t end,
+        struct bucket_entry *buckets) {
+    __m256 sum_qty[NUM_BUCKETS], sum_base_price[NUM_BUCKETS], sum_disc_price[NUM_BUCKETS];
+    __m256 sum_charge[NUM_BUCKETS], sum_discount[NUM_BUCKETS];
+    __m256i count[NUM_BUCKETS];
+
+    const __m256i pass = _mm256_set1_epi32(PASS);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int64_t i = start;
+    while (i + 8 <= end) {
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            sum_qty[b] = sum_base_price[b] = sum_disc_price[b] = _mm256_setzero_ps();
+            sum_charge[b] = sum_discount[b] = _mm256_setzero_ps();
+            count[b] = _mm256_setzero_si256();
+        }
+        int64_t block_end = (end - i > SIMD_BLOCK_ROWS) ? i + SIMD_BLOCK_ROWS : end;
+        for (; i + 8 <= block_end; i += 8) {
+            __m256i fail = _mm256_cmpgt_epi32(
+                    _mm256_loadu_si256((const __m256i *) &items->shipdates[i]), pass);
+            __m256i rf = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) &items->return_flags[i]));
+            __m256i ls = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) &items->line_statuses[i]));
+            __m256i bucket = _mm256_add_epi32(_mm256_add_epi32(rf, rf), ls);
+
+            __m256 qty = _mm256_loadu_ps(&items->quantities[i]);
+            __m256 ep = _mm256_loadu_ps(&items->extended_prices[i]);
+            __m256 disc = _mm256_loadu_ps(&items->discounts[i]);
+            __m256 tax = _mm256_loadu_ps(&items->taxes[i]);
+            __m256 disc_price = _mm256_mul_ps(ep, _mm256_sub_ps(one, disc));
+            __m256 charge = _mm256_mul_ps(disc_price, _mm256_add_ps(one, tax));
+
+            for (int b = 0; b < NUM_BUCKETS; b++) {
+                __m256i m = _mm256_andnot_si256(fail, _mm256_cmpeq_epi32(bucket, _mm256_set1_epi32(b)));
+                __m256 mf = _mm256_castsi256_ps(m);
+                sum_qty[b] = _mm256_add_ps(sum_qty[b], _mm256_and_ps(qty, mf));
+                sum_base_price[b] = _mm256_add_ps(sum_base_price[b], _mm256_and_ps(ep, mf));
+                sum_disc_price[b] = _mm256_add_ps(sum_disc_price[b], _mm256_and_ps(disc_price, mf));
+                sum_charge[b] = _mm256_add_ps(sum_charge[b], _mm256_and_ps(charge, mf));
+                sum_discount[b] = _mm256_add_ps(sum_discount[b], _mm256_and_ps(disc, mf));
+                // Matching lanes are -1.
+                count[b] = _mm256_sub_epi32(count[b], m);
+            }
+        }
+
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            buckets[b].sum_qty += bench_hsum_ps(sum_qty[b]);
+            buckets[b].sum_base_price += bench_hsum_ps(sum_base_price[b]);
+            buckets[b].sum_disc_price += bench_hsum_ps(sum_disc_price[b]);
+            buckets[b].sum_charge += bench_hsum_ps(sum_charge[b]);
+            buckets[b].sum_discount += bench_hsum_ps(sum_discount[b]);
+            buckets[b].count += bench_hsum_epi32(count[b]);
+        }
+    }
+    run_query_range(items, i, end, buckets);
+}
+
+int32_t run_query_simd(struct gen_data *d, int threads) {
+    return run_query_partitioned(d, threads, run_query_simd_range);
+}
+#endif
+
+/** Decodes the Weld result into the value the native schemes return. */
+int32_t decode_result(void *data) {
+    weld_vector<struct output> *result_data = (weld_vector<struct output> *) data;
+    return result_data->data[0].elem6 + (int32_t) result_data->data[0].elem5;
+}
+
+// The groups of one Weld result, copied out before the result is freed.
+struct weld_groups {
+    struct output groups[NUM_BUCKETS];
+};
+
+struct weld_groups decode_groups(void *data) {
+    weld_vector<struct output> *result_data = (weld_vector<struct output> *) data;
+    struct weld_groups g;
+    memcpy(g.groups, result_data->data, sizeof(g.groups));
+    return g;
+}
+
+/** Adds the groups of a Weld result to buckets. */
+void add_groups(struct bucket_entry *buckets, const struct weld_groups *g) {
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        buckets[b].sum_qty += g->groups[b].elem1;
+        buckets[b].sum_base_price += g->groups[b].elem2;
+        buckets[b].sum_disc_price += g->groups[b].elem3;
+        buckets[b].sum_charge += g->groups[b].elem4;
+        buckets[b].sum_discount += g->groups[b].elem5;
+        buckets[b].count += g->groups[b].elem6;
+    }
+}
+
+/** Checks every aggregate of every bucket against the reference, reporting
+ * only the first that differs.
+ *
+ * Counts must match exactly and sums to the tolerance. Reordering a double
+ * sum of n values changes it by at most about n * DBL_EPSILON of its
+ * value, under 1e-6 for any input size the benchmark runs.
+ */
+void verify_buckets(const char *scheme, const struct bucket_entry *expected,
+        const struct bucket_entry *actual, int64_t num_buckets, double tolerance) {
+    for (int64_t b = 0; b < num_buckets; b++) {
+        char what[64];
+        snprintf(what, sizeof(what), "bucket %lld count", (long long) b);
+        if (!bench_verify_int(scheme, what, expected[b].count, actual[b].count)) {
+            return;
+        }
+        const char *names[] = { "sum_qty", "sum_base_price", "sum_disc_price", "sum_charge", "sum_discount" };
+        const double sums[][2] = {
+            { expected[b].sum_qty, actual[b].sum_qty },
+            { expected[b].sum_base_price, actual[b].sum_base_price },
+            { expected[b].sum_disc_price, actual[b].sum_disc_price },
+            { expected[b].sum_charge, actual[b].sum_charge },
+            { expected[b].sum_discount, actual[b].sum_discount },
+        };
+        for (int i = 0; i < 5; i++) {
+            snprintf(what, sizeof(what), "bucket %lld %s", (long long) b, names[i]);
+            if (!bench_verify_double(scheme, what, sums[i][0], sums[i][1], tolerance)) {
+                return;
+            }
+        }
+    }
+}
+
+/** Returns a copy of a column, allocated with bench_alloc. */
+template <typename T>
+T *copy_column(const T *src, int64_t n) {
+    T *dst = (T *) bench_alloc(sizeof(T) * n);
+    memcpy(dst, src, sizeof(T) * n);
+    return dst;
+}
+
+/** Runs the concurrent Weld modes on one compiled module: throughput with
+ * up to o->clients clients, and open-loop latency at each rate in o->rates
+ * with a pool of o->clients workers (one if unset). Each client or worker
+ * queries its own copy of the input. */
+void run_concurrent_weld(struct gen_data *d, const struct bench_options *o,
+        struct weld_bench_module *m) {
+    int clients = o->clients > 0 ? o->clients : 1;
+    int64_t n = d->num_items;
+    struct args *client_args = new struct args[clients];
+    void **arg_ptrs = new void *[clients];
+    for (int c = 0; c < clients; c++) {
+        struct args *a = &client_args[c];
+        a->return_flags = make_weld_vector<int8_t>(copy_column(d->items->return_flags, n), n);
+        a->line_statuses = make_weld_vector<int8_t>(copy_column(d->items->line_statuses, n), n);
+        a->quantities = make_weld_vector<float>(copy_column(d->items->quantities, n), n);
+        a->extended_prices = make_weld_vector<float>(copy_column(d->items->extended_prices, n), n);
+        a->discounts = make_weld_vector<float>(copy_column(d->items->discounts, n), n);
+        a->shipdates = make_weld_vector<int32_t>(copy_column(d->items->shipdates, n), n);
+        a->taxes = make_weld_vector<float>(copy_column(d->items->taxes, n), n);
+        arg_ptrs[c] = a;
+    }
+
+    if (o->clients > 0) {
+        weld_bench_throughput<int32_t>(o, "Weld throughput", m, arg_ptrs, decode_result);
+    }
+    if (o->num_rates > 0) {
+        weld_bench_open_loop<int32_t>(o, "Weld open-loop", m, clients, arg_ptrs, decode_result);
+    }
 
-    // Free the values.
-    weld_value_free(result);
-    weld_value_free(weld_args);
-    weld_conf_free(conf);
+    for (int c = 0; c < clients; c++) {
+        bench_free(client_args[c].return_flags.data);
+        bench_free(client_args[c].line_statuses.data);
+        bench_free(client_args[c].quantities.data);
+        bench_free(client_args[c].extended_prices.data);
+        bench_free(client_args[c].discounts.data);
+        bench_free(client_args[c].shipdates.data);
+        bench_free(client_args[c].taxes.data);
+    }
+    delete[] arg_ptrs;
+    delete[] client_args;
+}
+
+/** Runs the Weld program and returns its groups as buckets. */
+void run_query_weld(struct gen_data *d, const struct bench_options *o, struct bucket_entry *buckets) {
+    struct weld_bench_module m = weld_bench_compile("tpch_q1.weld");
 
-    weld_error_free(e);
-    weld_module_free(m);
+    struct args args;
+    args.return_flags = make_weld_vector<int8_t>(d->items->return_flags, d->num_items);
+    args.line_statuses = make_weld_vector<int8_t>(d->items->line_statuses, d->num_items);
+    args.quantities = make_weld_vector<float>(d->items->quantities, d->num_items);
+    args.extended_prices = make_weld_vector<float>(d->items->extended_prices, d->num_items);
+    args.discounts = make_weld_vector<float>(d->items->discounts, d->num_items);
+    args.shipdates = make_weld_vector<int32_t>(d->items->shipdates, d->num_items);
+    args.taxes = make_weld_vector<float>(d->items->taxes, d->num_items);
 
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, final_result);
+    struct weld_groups final_groups;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, decode_groups, &final_groups);
+    memset(buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+    add_groups(buckets, &final_groups);
+    bench_report_stats("Weld", &stats, "(result=%d)", buckets[0].count + (int32_t) buckets[0].sum_discount);
+
+    if (o->clients > 0 || o->num_rates > 0) {
+        run_concurrent_weld(d, o, &m);
+    }
 
-    return final_result;
+    weld_bench_module_free(&m);
 }
 
 /** Generates input data.
  *
  * @param num_items the number of line items.
  * @param prob the selectivity of the branch.
+ * @param seed the seed of the random values.
  * @return the generated data in a structure.
  */
-struct gen_data generate_data(int num_items, float prob) {
+struct gen_data generate_data(int num_items, float prob, uint64_t seed) {
     struct gen_data d;
 
     d.num_items = num_items;
     d.prob = prob;
+    d.cache.base = NULL;
 
-    d.items = (struct lineitems *)malloc(sizeof(struct lineitems));
+    d.items = (struct synthetic_lineitems *)malloc(sizeof(struct synthetic_lineitems));
     d.buckets = (struct bucket_entry *)malloc(sizeof(struct bucket_entry) * NUM_BUCKETS);
 
-    d.items->return_flags = (int8_t *) malloc(sizeof(int8_t) * num_items);
-    d.items->line_statuses = (int8_t *) malloc(sizeof(int8_t) * num_items);
-    d.items->quantities = (float *) malloc(sizeof(float) * num_items);
-    d.items->extended_prices = (float *) malloc(sizeof(float) * num_items);
-    d.items->discounts = (float *) malloc(sizeof(float) * num_items);
-    d.items->shipdates = (int32_t *) malloc(sizeof(int32_t) * num_items);
-    d.items->taxes = (float *) malloc(sizeof(float) * num_items);
-
-    int pass_thres = (int)(prob * 1000000.0);
-    srand(1);
-    for (int i = 0; i < d.num_items; i++) {
-        if (rand() % 1000000 <= pass_thres) {
-            d.items->shipdates[i] = PASS;
-        } else {
-            d.items->shipdates[i] = PASS + 1;
+    synthetic_lineitems_alloc(d.items, num_items);
+    synthetic_lineitems_generate(d.items, 0, num_items, prob, PASS, seed);
+    memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+
+    return d;
+}
+
+/** Runs Q1 over generated input in chunks, without materializing it.
+ *
+ * For each chunk size in o->chunk_sizes, the input is generated chunk by
+ * chunk into two buffers while the previous chunk is queried. Each chunk's
+ * groups (the vecmerger buckets of tpch_q1.weld, or the native buckets) are
+ * added to running totals, so the result matches the query over the whole
+ * generated input, up to floating-point summation order.
+ *
+ * @param num_items the number of line items.
+ * @param prob the selectivity of the branch.
+ * @param o the options; the seed, threads and chunk sizes are used.
+ */
+void run_chunked(int64_t num_items, float prob, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("tpch_q1.weld");
+    struct bucket_entry totals[NUM_BUCKETS];
+
+    for (int c = 0; c < o->num_chunk_sizes; c++) {
+        int64_t chunk_rows = o->chunk_sizes[c] < num_items ? o->chunk_sizes[c] : num_items;
+        int64_t num_chunks = (num_items + chunk_rows - 1) / chunk_rows;
+        struct synthetic_lineitems slots[BENCH_PIPELINE_SLOTS];
+        for (int s = 0; s < BENCH_PIPELINE_SLOTS; s++) {
+            synthetic_lineitems_alloc(&slots[s], chunk_rows);
         }
+        auto produce = [&](int slot, int64_t start, int64_t end) {
+            synthetic_lineitems_generate(&slots[slot], start, end - start, prob, PASS, o->seed);
+        };
+
+        int32_t result;
+        double stall;
+        struct bench_stats stats = bench_trials(o, [&] {
+            memset(totals, 0, sizeof(totals));
+            bench_pipeline(num_items, chunk_rows, produce, [&](int slot, int64_t start, int64_t end) {
+                // run_query_parallel adds each chunk's groups to view.buckets.
+                struct gen_data view;
+                view.num_items = end - start;
+                view.items = &slots[slot];
+                view.buckets = totals;
+                result = run_query_parallel(&view, o->threads);
+            }, &stall);
+        });
+        char scheme[64];
+        snprintf(scheme, sizeof(scheme), "Multi-threaded C++ chunked (rows=%lld)", (long long) chunk_rows);
+        bench_report_stats(scheme, &stats, "(result=%d, threads=%d, chunks=%lld, rows-per-sec=%.0f, stall=%.9f)",
+                result, o->threads, (long long) num_chunks, num_items / stats.median, stall);
+        // The input is never materialized whole, so the native chunked
+        // groups are the reference for the Weld ones.
+        struct bucket_entry expected[NUM_BUCKETS];
+        memcpy(expected, totals, sizeof(expected));
+
+        stats = bench_trials(o, [&] {
+            memset(totals, 0, sizeof(totals));
+            bench_pipeline(num_items, chunk_rows, produce, [&](int slot, int64_t start, int64_t end) {
+                struct args args;
+                int64_t n = end - start;
+                args.return_flags = make_weld_vector<int8_t>(slots[slot].return_flags, n);
+                args.line_statuses = make_weld_vector<int8_t>(slots[slot].line_statuses, n);
+                args.quantities = make_weld_vector<float>(slots[slot].quantities, n);
+                args.extended_prices = make_weld_vector<float>(slots[slot].extended_prices, n);
+                args.discounts = make_weld_vector<float>(slots[slot].discounts, n);
+                args.shipdates = make_weld_vector<int32_t>(slots[slot].shipdates, n);
+                args.taxes = make_weld_vector<float>(slots[slot].taxes, n);
+                struct weld_groups g = weld_bench_query<struct weld_groups>(&m, &args, decode_groups);
+                add_groups(totals, &g);
+            }, &stall);
+            result = totals[0].count + (int32_t) totals[0].sum_discount;
+        });
+        snprintf(scheme, sizeof(scheme), "Weld chunked (rows=%lld)", (long long) chunk_rows);
+        bench_report_stats(scheme, &stats, "(result=%d, chunks=%lld, rows-per-sec=%.0f, stall=%.9f)",
+                result, (long long) num_chunks, num_items / stats.median, stall);
+        verify_buckets(scheme, expected, totals, NUM_BUCKETS, o->tolerance);
+
+        for (int s = 0; s < BENCH_PIPELINE_SLOTS; s++) {
+            synthetic_lineitems_free(&slots[s]);
+        }
+    }
+
+    weld_bench_module_free(&m);
+}
+
+/** Returns the fraction of line items that pass the shipdate predicate. */
+float passing_fraction(const struct gen_data *d) {
+    int64_t passing = 0;
+    for (int64_t i = 0; i < d->num_items; i++) {
+        passing += (d->items->shipdates[i] <= PASS);
+    }
+    return d->num_items > 0 ? (float) passing / d->num_items : 0.0f;
+}
+
+/** Loads input data from a dbgen-format lineitem table.
+ *
+ * Return flags (A, N, R) and line statuses (F, O) are coded so that
+ * 2 * return_flag + line_status indexes one of the NUM_BUCKETS groups.
+ *
+ * @param path the lineitem.tbl file.
+ * @return the loaded data in a structure.
+ */
+struct gen_data load_data(const char *path) {
+    struct lineitem_columns c = lineitem_load(path);
+    struct gen_data d;
+    int64_t num_items = c.num_items;
+
+    d.num_items = num_items;
+    d.cache.base = NULL;
+
+    d.items = (struct synthetic_lineitems *)malloc(sizeof(struct synthetic_lineitems));
+    d.buckets = (struct bucket_entry *)malloc(sizeof(struct bucket_entry) * NUM_BUCKETS);
+
+    d.items->return_flags = c.return_flags;
+    d.items->line_statuses = c.line_statuses;
+    d.items->quantities = (float *) bench_alloc(sizeof(float) * num_items);
+    d.items->extended_prices = (float *) bench_alloc(sizeof(float) * num_items);
+    d.items->discounts = (float *) bench_alloc(sizeof(float) * num_items);
+    d.items->shipdates = c.shipdates;
+    d.items->taxes = (float *) bench_alloc(sizeof(float) * num_items);
 
-        d.items->return_flags[i] = rand() % 2;
-        d.items->line_statuses[i] = rand() % 3;
-        d.items->quantities[i] = rand();
-        d.items->extended_prices[i] = rand();
-        d.items->discounts[i] = rand();
-        d.items->taxes[i] = rand();
-        // TODO: Figure out how to set return flag and linestatus to ensure that
-        // num_buckets constraint is respected.
+    for (int64_t i = 0; i < num_items; i++) {
+        d.items->quantities[i] = c.quantities[i];
+        d.items->extended_prices[i] = c.extended_prices[i];
+        d.items->discounts[i] = c.discounts[i];
+        d.items->taxes[i] = c.taxes[i];
     }
+    d.prob = passing_fraction(&d);
     memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
 
+    bench_free(c.quantities);
+    bench_free(c.extended_prices);
+    bench_free(c.discounts);
+    bench_free(c.taxes);
     return d;
 }
 
+/** Writes the input columns to a column file.
+ *
+ * @param path the column file.
+ * @param key the parameters the data was generated with.
+ * @param d the data to write.
+ * @return true on success.
+ */
+bool write_cache(const char *path, const char *key, const struct gen_data *d) {
+    struct column_spec columns[] = {
+        { "return_flags", COLUMN_INT8, d->items->return_flags },
+        { "line_statuses", COLUMN_INT8, d->items->line_statuses },
+        { "quantities", COLUMN_FLOAT, d->items->quantities },
+        { "extended_prices", COLUMN_FLOAT, d->items->extended_prices },
+        { "discounts", COLUMN_FLOAT, d->items->discounts },
+        { "shipdates", COLUMN_INT32, d->items->shipdates },
+        { "taxes", COLUMN_FLOAT, d->items->taxes },
+    };
+    return column_file_write(path, key, d->num_items, columns,
+            sizeof(columns) / sizeof(columns[0]));
+}
+
+/** Maps input data from a column file written by write_cache.
+ *
+ * The columns point into the mapping, so they are shared without copies
+ * by the native kernels and the Weld arguments.
+ *
+ * @param path the column file.
+ * @param key the parameters the data must have been generated with.
+ * @param d the mapped data, set on success.
+ * @return true on success, false if the file is missing or stale.
+ */
+bool map_data(const char *path, const char *key, struct gen_data *d) {
+    if (!column_file_map(path, key, &d->cache)) {
+        return false;
+    }
+    struct column_file *f = &d->cache;
+    d->num_items = f->num_rows;
+
+    d->items = (struct synthetic_lineitems *)malloc(sizeof(struct synthetic_lineitems));
+    d->buckets = (struct bucket_entry *)malloc(sizeof(struct bucket_entry) * NUM_BUCKETS);
+
+    d->items->return_flags = (int8_t *) column_file_column(f, "return_flags", COLUMN_INT8);
+    d->items->line_statuses = (int8_t *) column_file_column(f, "line_statuses", COLUMN_INT8);
+    d->items->quantities = (float *) column_file_column(f, "quantities", COLUMN_FLOAT);
+    d->items->extended_prices = (float *) column_file_column(f, "extended_prices", COLUMN_FLOAT);
+    d->items->discounts = (float *) column_file_column(f, "discounts", COLUMN_FLOAT);
+    d->items->shipdates = (int32_t *) column_file_column(f, "shipdates", COLUMN_INT32);
+    d->items->taxes = (float *) column_file_column(f, "taxes", COLUMN_FLOAT);
+
+    d->prob = passing_fraction(d);
+    memset(d->buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+    return true;
+}
+
 void free_generated_data(struct gen_data *d) {
-    free(d->items->return_flags);
-    free(d->items->line_statuses);
-    free(d->items->quantities);
-    free(d->items->extended_prices);
-    free(d->items->discounts);
-    free(d->items->shipdates);
-    free(d->items->taxes);
+    if (d->cache.base != NULL) {
+        column_file_unmap(&d->cache);
+    } else {
+        synthetic_lineitems_free(d->items);
+    }
 
     free(d->items);
+    free(d->buckets);
+}
+
+// Group-by mode (-b): the Q1 aggregates grouped by a synthetic key with a
+// chosen number of distinct values, instead of by the six return flag and
+// line status combinations.
+
+// Multiplier of the Fibonacci hash that places keys in partitions and slots.
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+// Key of an unused hash table slot.
+#define EMPTY_KEY -1
+// Groups per partition that radix-partitioned aggregation aims for, so that
+// each partition's hash table (48 bytes per slot, half full) fits in L2.
+#define GROUPS_PER_PARTITION 4096
+// Most partitions radix-partitioned aggregation writes in its one pass;
+// beyond this, the scatter runs out of TLB entries and write-combining lines.
+#define MAX_PARTITION_BITS 11
+
+// The input of the group-by mode.
+struct group_data {
+    int64_t num_items;
+    // Number of distinct keys.
+    int64_t num_groups;
+    // Group keys, uniform in [0, num_groups).
+    int32_t *keys;
+    // The Q1 columns; the return flags and line statuses are not used.
+    struct synthetic_lineitems items;
+};
+
+struct group_args {
+    struct weld_vector<int32_t> keys;
+    struct weld_vector<float> quantities;
+    struct weld_vector<float> extended_prices;
+    struct weld_vector<float> discounts;
+    struct weld_vector<int32_t> shipdates;
+    struct weld_vector<float> taxes;
+    int64_t num_groups;
+};
+
+// An element of the dictmerger and groupmerger results.
+struct keyed_output {
+    int32_t key;
+    struct output value;
+};
+
+// A slot of an open-addressing hash table: a key and its aggregates.
+struct hash_slot {
+    int32_t key;
+    int32_t count;
+    double sum_qty;
+    double sum_base_price;
+    double sum_disc_price;
+    double sum_charge;
+    double sum_discount;
+};
+
+// An open-addressing hash table with linear probing from group keys to
+// aggregates. It doubles whenever more than half of its slots are in use.
+struct group_table {
+    struct hash_slot *slots;
+    // log2 of the number of slots.
+    int bits;
+    // Number of leading hash bits that are the same for every key, because
+    // they chose the partition the table aggregates.
+    int skip_bits;
+    // Number of slots in use.
+    int64_t size;
+};
+
+// A passing row, as radix-partitioned aggregation copies it into its partition.
+struct partitioned_row {
+    int32_t key;
+    float quantity;
+    float extended_price;
+    float discount;
+    float tax;
+};
+
+inline uint64_t hash_key(int32_t key) {
+    return (uint64_t) (uint32_t) key * HASH_MULTIPLIER;
+}
+
+/** Adds one passing row to the aggregates of e. */
+template <typename E>
+inline void aggregate_row(E *e, float quantity, float extended_price, float discount, float tax) {
+    e->sum_qty += quantity;
+    e->sum_base_price += extended_price;
+    float disc_price = extended_price * (1 - discount);
+    e->sum_disc_price += disc_price;
+    e->sum_charge += disc_price * (1 + tax);
+    e->sum_discount += discount;
+    e->count++;
+}
+
+/** Returns the smallest number of bits b with 2^b >= n. */
+int ceil_log2(int64_t n) {
+    int b = 0;
+    while (((int64_t) 1 << b) < n) {
+        b++;
+    }
+    return b;
+}
+
+void group_table_init(struct group_table *t, int bits, int skip_bits) {
+    t->bits = bits;
+    t->skip_bits = skip_bits;
+    t->size = 0;
+    int64_t capacity = (int64_t) 1 << bits;
+    t->slots = (struct hash_slot *) malloc(sizeof(struct hash_slot) * capacity);
+    memset(t->slots, 0, sizeof(struct hash_slot) * capacity);
+    for (int64_t s = 0; s < capacity; s++) {
+        t->slots[s].key = EMPTY_KEY;
+    }
+}
+
+/** Returns the slot of a hash table that holds key, or the empty slot where
+ * it belongs. */
+inline struct hash_slot *group_table_probe(struct hash_slot *slots, int bits, int skip_bits,
+        int32_t key) {
+    uint64_t mask = ((uint64_t) 1 << bits) - 1;
+    uint64_t s = (hash_key(key) << skip_bits) >> (64 - bits);
+    while (slots[s].key != key && slots[s].key != EMPTY_KEY) {
+        s = (s + 1) & mask;
+    }
+    return &slots[s];
+}
+
+/** Doubles the number of slots of a hash table. */
+void group_table_grow(struct group_table *t) {
+    struct hash_slot *old = t->slots;
+    int64_t old_capacity = (int64_t) 1 << t->bits;
+    group_table_init(t, t->bits + 1, t->skip_bits);
+    for (int64_t s = 0; s < old_capacity; s++) {
+        if (old[s].key != EMPTY_KEY) {
+            *group_table_probe(t->slots, t->bits, t->skip_bits, old[s].key) = old[s];
+            t->size++;
+        }
+    }
+    free(old);
+}
+
+/** Returns the slot of key in a hash table, inserting it if it is missing. */
+inline struct hash_slot *group_table_find(struct group_table *t, int32_t key) {
+    struct hash_slot *slot = group_table_probe(t->slots, t->bits, t->skip_bits, key);
+    if (slot->key == EMPTY_KEY) {
+        if (2 * (t->size + 1) > ((int64_t) 1 << t->bits)) {
+            group_table_grow(t);
+            slot = group_table_probe(t->slots, t->bits, t->skip_bits, key);
+        }
+        slot->key = key;
+        t->size++;
+    }
+    return slot;
+}
+
+/** Copies the aggregates of every key in a hash table to buckets[key]. */
+void group_table_scatter(const struct group_table *t, struct bucket_entry *buckets) {
+    int64_t capacity = (int64_t) 1 << t->bits;
+    for (int64_t s = 0; s < capacity; s++) {
+        const struct hash_slot *slot = &t->slots[s];
+        if (slot->key != EMPTY_KEY) {
+            struct bucket_entry *e = &buckets[slot->key];
+            e->sum_qty = slot->sum_qty;
+            e->sum_base_price = slot->sum_base_price;
+            e->sum_disc_price = slot->sum_disc_price;
+            e->sum_charge = slot->sum_charge;
+            e->sum_discount = slot->sum_discount;
+            e->count = slot->count;
+        }
+    }
+}
+
+/** Aggregates into a flat array indexed by key. With more than one thread,
+ * each thread aggregates its rows into its own array, and the arrays are
+ * then added up, each thread adding one range of keys.
+ *
+ * @param buckets num_groups zeroed entries, which receive the groups.
+ * @param partials threads - 1 arrays of num_groups zeroed entries, which
+ * the threads after the first aggregate into.
+ */
+void run_groups_flat(const struct group_data *g, int threads, struct bucket_entry *buckets,
+        struct bucket_entry **partials) {
+    const struct synthetic_lineitems *items = &g->items;
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        // The first thread aggregates into the result directly.
+        struct bucket_entry *local = thread > 0 ? partials[thread - 1] : buckets;
+        int64_t end = bench_range_start(g->num_items, thread + 1, num_threads);
+        for (int64_t i = bench_range_start(g->num_items, thread, num_threads); i < end; i++) {
+            if (items->shipdates[i] <= PASS) {
+                aggregate_row(&local[g->keys[i]], items->quantities[i], items->extended_prices[i],
+                        items->discounts[i], items->taxes[i]);
+            }
+        }
+#pragma omp barrier
+        int64_t last = bench_range_start(g->num_groups, thread + 1, num_threads);
+        for (int t = 1; t < num_threads; t++) {
+            const struct bucket_entry *partial = partials[t - 1];
+            for (int64_t k = bench_range_start(g->num_groups, thread, num_threads); k < last; k++) {
+                buckets[k].sum_qty += partial[k].sum_qty;
+                buckets[k].sum_base_price += partial[k].sum_base_price;
+                buckets[k].sum_disc_price += partial[k].sum_disc_price;
+                buckets[k].sum_charge += partial[k].sum_charge;
+                buckets[k].sum_discount += partial[k].sum_discount;
+                buckets[k].count += partial[k].count;
+            }
+        }
+    }
+}
+
+/** Aggregates into one open-addressing hash table, sized up front for
+ * num_groups keys as a planner would from a cardinality estimate.
+ *
+ * @param buckets num_groups zeroed entries, which receive the groups.
+ */
+void run_groups_hash(const struct group_data *g, struct bucket_entry *buckets) {
+    const struct synthetic_lineitems *items = &g->items;
+    struct group_table t;
+    group_table_init(&t, ceil_log2(2 * g->num_groups), 0);
+    for (int64_t i = 0; i < g->num_items; i++) {
+        if (items->shipdates[i] <= PASS) {
+            aggregate_row(group_table_find(&t, g->keys[i]), items->quantities[i],
+                    items->extended_prices[i], items->discounts[i], items->taxes[i]);
+        }
+    }
+    group_table_scatter(&t, buckets);
+    free(t.slots);
+}
+
+/** Returns the number of bits of the hash that radix-partitioned
+ * aggregation partitions num_groups keys by. */
+int partition_bits(int64_t num_groups) {
+    int bits = ceil_log2((num_groups + GROUPS_PER_PARTITION - 1) / GROUPS_PER_PARTITION);
+    return bits < MAX_PARTITION_BITS ? bits : MAX_PARTITION_BITS;
+}
+
+/** Aggregates in two passes. The first copies the passing rows into
+ * partitions by the leading bits of their key's hash, each thread writing
+ * its rows to its own part of every partition; the second aggregates each
+ * partition into a hash table small enough to stay in cache. Partitions
+ * hold disjoint keys, so they are aggregated by the threads independently.
+ *
+ * @param buckets num_groups zeroed entries, which receive the groups.
+ */
+void run_groups_radix(const struct group_data *g, int threads, struct bucket_entry *buckets) {
+    const struct synthetic_lineitems *items = &g->items;
+    int bits = partition_bits(g->num_groups);
+    int num_partitions = 1 << bits;
+    // Per-thread row counts of each partition, turned into write offsets.
+    int64_t *offsets = (int64_t *) calloc((int64_t) threads * num_partitions, sizeof(int64_t));
+    int64_t *starts = (int64_t *) malloc(sizeof(int64_t) * (num_partitions + 1));
+    struct partitioned_row *rows =
+        (struct partitioned_row *) malloc(sizeof(struct partitioned_row) * g->num_items);
+    int table_bits = ceil_log2(2 * ((g->num_groups >> bits) + 1));
+
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+        int64_t start = bench_range_start(g->num_items, thread, num_threads);
+        int64_t end = bench_range_start(g->num_items, thread + 1, num_threads);
+        int64_t *local = &offsets[(int64_t) thread * num_partitions];
+        for (int64_t i = start; i < end; i++) {
+            if (items->shipdates[i] <= PASS) {
+                local[bits > 0 ? hash_key(g->keys[i]) >> (64 - bits) : 0]++;
+            }
+        }
+#pragma omp barrier
+#pragma omp single
+        {
+            int64_t offset = 0;
+            for (int p = 0; p < num_partitions; p++) {
+                starts[p] = offset;
+                for (int t = 0; t < num_threads; t++) {
+                    int64_t count = offsets[(int64_t) t * num_partitions + p];
+                    offsets[(int64_t) t * num_partitions + p] = offset;
+                    offset += count;
+                }
+            }
+            starts[num_partitions] = offset;
+        }
+        for (int64_t i = start; i < end; i++) {
+            if (items->shipdates[i] <= PASS) {
+                int32_t key = g->keys[i];
+                struct partitioned_row *row = &rows[local[bits > 0 ? hash_key(key) >> (64 - bits) : 0]++];
+                row->key = key;
+                row->quantity = items->quantities[i];
+                row->extended_price = items->extended_prices[i];
+                row->discount = items->discounts[i];
+                row->tax = items->taxes[i];
+            }
+        }
+#pragma omp barrier
+#pragma omp for schedule(dynamic)
+        for (int p = 0; p < num_partitions; p++) {
+            struct group_table t;
+            group_table_init(&t, table_bits, bits);
+            for (int64_t r = starts[p]; r < starts[p + 1]; r++) {
+                aggregate_row(group_table_find(&t, rows[r].key), rows[r].quantity,
+                        rows[r].extended_price, rows[r].discount, rows[r].tax);
+            }
+            group_table_scatter(&t, buckets);
+            free(t.slots);
+        }
+    }
+
+    free(rows);
+    free(starts);
+    free(offsets);
+}
+
+/** Copies a group of a Weld result to a bucket. */
+void set_bucket(struct bucket_entry *e, const struct output *o) {
+    e->sum_qty = o->elem1;
+    e->sum_base_price = o->elem2;
+    e->sum_disc_price = o->elem3;
+    e->sum_charge = o->elem4;
+    e->sum_discount = o->elem5;
+    e->count = o->elem6;
+}
+
+/** Runs one of the group-by Weld programs.
+ *
+ * @param file the program.
+ * @param keyed whether the program returns {key, groups} pairs, as
+ * dictmerger and groupmerger do, rather than a vector indexed by key.
+ * @param buckets num_groups entries, which receive the groups.
+ */
+void run_groups_weld(const struct group_data *g, const struct bench_options *o,
+        const char *file, const char *scheme, bool keyed, struct bucket_entry *buckets) {
+    struct weld_bench_module m = weld_bench_compile(file);
+
+    struct group_args args;
+    args.keys = make_weld_vector<int32_t>(g->keys, g->num_items);
+    args.quantities = make_weld_vector<float>(g->items.quantities, g->num_items);
+    args.extended_prices = make_weld_vector<float>(g->items.extended_prices, g->num_items);
+    args.discounts = make_weld_vector<float>(g->items.discounts, g->num_items);
+    args.shipdates = make_weld_vector<int32_t>(g->items.shipdates, g->num_items);
+    args.taxes = make_weld_vector<float>(g->items.taxes, g->num_items);
+    args.num_groups = g->num_groups;
+
+    int64_t num_groups = g->num_groups;
+    auto decode = [&](void *data) {
+        // Keys without passing rows are missing from the keyed results.
+        memset(buckets, 0, sizeof(struct bucket_entry) * num_groups);
+        if (keyed) {
+            weld_vector<struct keyed_output> *result = (weld_vector<struct keyed_output> *) data;
+            for (int64_t i = 0; i < result->length; i++) {
+                int32_t key = result->data[i].key;
+                if (key >= 0 && key < num_groups) {
+                    set_bucket(&buckets[key], &result->data[i].value);
+                }
+            }
+        } else {
+            weld_vector<struct output> *result = (weld_vector<struct output> *) data;
+            for (int64_t k = 0; k < result->length && k < num_groups; k++) {
+                set_bucket(&buckets[k], &result->data[k]);
+            }
+        }
+        return buckets[0].count + (int32_t) buckets[0].sum_discount;
+    };
+
+    int32_t result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, decode, &result);
+    bench_report_stats(scheme, &stats, "(result=%d, groups=%lld)", result, (long long) num_groups);
+
+    weld_bench_module_free(&m);
+}
+
+/** Runs the group-by mode: every native aggregation strategy and Weld
+ * builder over the same input, checked against the flat array.
+ *
+ * @param num_items the number of line items.
+ * @param num_groups the number of distinct keys.
+ * @param prob the selectivity of the branch.
+ * @param o the options; the seed and threads are used.
+ */
+void run_groups(int64_t num_items, int64_t num_groups, float prob, const struct bench_options *o) {
+    struct group_data g;
+    g.num_items = num_items;
+    g.num_groups = num_groups;
+    synthetic_lineitems_alloc(&g.items, num_items);
+    synthetic_lineitems_generate(&g.items, 0, num_items, prob, PASS, o->seed);
+    g.keys = (int32_t *) bench_alloc(sizeof(int32_t) * num_items);
+    bench_fill_uniform<int32_t>(g.keys, num_items, 0, num_groups - 1, bench_rng_make(o->seed, 7));
+
+    size_t bytes = sizeof(struct bucket_entry) * num_groups;
+    struct bucket_entry *buckets = (struct bucket_entry *) malloc(bytes);
+    struct bucket_entry *expected = (struct bucket_entry *) malloc(bytes);
+    // The arrays of the multi-threaded flat array's other threads.
+    int num_partials = o->threads - 1;
+    struct bucket_entry **partials = new struct bucket_entry *[num_partials > 0 ? num_partials : 1];
+    for (int t = 0; t < num_partials; t++) {
+        partials[t] = (struct bucket_entry *) malloc(bytes);
+    }
+    int32_t result;
+
+    // The arrays are zeroed before every run, untimed, so that at large
+    // num_groups the times measure the aggregation rather than the memset.
+    auto clear = [&] { memset(buckets, 0, bytes); };
+    struct bench_stats stats = bench_trials_setup(o, clear, [&] {
+        run_groups_flat(&g, 1, buckets, NULL);
+    });
+    result = buckets[0].count + (int32_t) buckets[0].sum_discount;
+    bench_report_stats("Flat array C++", &stats, "(result=%d, groups=%lld)",
+            result, (long long) num_groups);
+    // Every other scheme must compute the same groups.
+    memcpy(expected, buckets, bytes);
+
+    auto clear_all = [&] {
+        clear();
+        for (int t = 0; t < num_partials; t++) {
+            memset(partials[t], 0, bytes);
+        }
+    };
+    stats = bench_trials(o, clear_all);
+    bench_report_stats("Multi-threaded flat array zeroing C++", &stats, "(groups=%lld, threads=%d)",
+            (long long) num_groups, o->threads);
+
+    stats = bench_trials_setup(o, clear_all, [&] {
+        run_groups_flat(&g, o->threads, buckets, partials);
+    });
+    result = buckets[0].count + (int32_t) buckets[0].sum_discount;
+    bench_report_stats("Multi-threaded flat array C++", &stats, "(result=%d, groups=%lld, threads=%d)",
+            result, (long long) num_groups, o->threads);
+    verify_buckets("Multi-threaded flat array C++", expected, buckets, num_groups, o->tolerance);
+
+    stats = bench_trials_setup(o, clear, [&] {
+        run_groups_hash(&g, buckets);
+    });
+    result = buckets[0].count + (int32_t) buckets[0].sum_discount;
+    bench_report_stats("Hash table C++", &stats, "(result=%d, groups=%lld)",
+            result, (long long) num_groups);
+    verify_buckets("Hash table C++", expected, buckets, num_groups, o->tolerance);
+
+    int partitions = 1 << partition_bits(num_groups);
+    stats = bench_trials_setup(o, clear, [&] {
+        run_groups_radix(&g, 1, buckets);
+    });
+    result = buckets[0].count + (int32_t) buckets[0].sum_discount;
+    bench_report_stats("Radix-partitioned C++", &stats, "(result=%d, groups=%lld, partitions=%d)",
+            result, (long long) num_groups, partitions);
+    verify_buckets("Radix-partitioned C++", expected, buckets, num_groups, o->tolerance);
+
+    stats = bench_trials_setup(o, clear, [&] {
+        run_groups_radix(&g, o->threads, buckets);
+    });
+    result = buckets[0].count + (int32_t) buckets[0].sum_discount;
+    bench_report_stats("Multi-threaded radix-partitioned C++", &stats,
+            "(result=%d, groups=%lld, partitions=%d, threads=%d)",
+            result, (long long) num_groups, partitions, o->threads);
+    verify_buckets("Multi-threaded radix-partitioned C++", expected, buckets, num_groups, o->tolerance);
+
+    const char *files[] = {
+        "tpch_q1_vecmerger.weld", "tpch_q1_dictmerger.weld", "tpch_q1_groupmerger.weld"
+    };
+    const char *schemes[] = { "Weld vecmerger", "Weld dictmerger", "Weld groupmerger" };
+    for (int w = 0; w < 3; w++) {
+        run_groups_weld(&g, o, files[w], schemes[w], w > 0, buckets);
+        verify_buckets(schemes[w], expected, buckets, num_groups, o->tolerance);
+    }
+
+    for (int t = 0; t < num_partials; t++) {
+        free(partials[t]);
+    }
+    delete[] partials;
+    free(expected);
+    free(buckets);
+    bench_free(g.keys);
+    synthetic_lineitems_free(&g.items);
+}
+
+/** Times run at 1, 2, 4, ... up to o->threads threads, reporting each point
+ * with its speedup over one thread and checking its groups against expected.
+ */
+void run_scaling(const char *name, struct gen_data *d, const struct bucket_entry *expected,
+        const struct bench_options *o, int32_t (*run)(struct gen_data *, int)) {
+    double base = 0.0;
+    for (int threads = 1; ; threads = (threads * 2 < o->threads) ? threads * 2 : o->threads) {
+        int32_t result;
+        struct bench_stats stats = bench_trials(o, [&] {
+            memset(d->buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+            result = run(d, threads);
+        });
+        if (threads == 1) {
+            base = stats.median;
+        }
+        char scheme[64];
+        snprintf(scheme, sizeof(scheme), "%s (threads=%d)", name, threads);
+        bench_report_stats(scheme, &stats, "(result=%d, speedup=%.2f)",
+                result, base / stats.median);
+        verify_buckets(scheme, expected, d->buckets, NUM_BUCKETS, o->tolerance);
+        if (threads >= o->threads) {
+            break;
+        }
+    }
 }
 
 int main(int argc, char **argv) {
@@ -242,16 +1122,46 @@ int main(int argc, char **argv) {
     int num_items = (1E8 / sizeof(int));
     // Approx. PASS probability.
     float prob = 0.01;
+    // A dbgen lineitem table to load instead of generating data, and the
+    // scale factor to generate it at if it does not exist yet.
+    const char *input = NULL;
+    double generate_sf = 0.0;
+    // A column file caching the input data across runs.
+    const char *cache = NULL;
+    // Whether to also report partitioned aggregation at 1, 2, 4, ... threads.
+    int scaling = 0;
+    // Number of groups in group-by mode; 0 runs Q1 with its own six groups.
+    int64_t num_groups = 0;
+
+    struct bench_options o = bench_options_default();
 
     int ch;
-    while ((ch = getopt(argc, argv, "b:n:p:")) != -1) {
+    while ((ch = getopt(argc, argv, "b:f:g:m:n:p:s:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
         switch (ch) {
+            case 'b':
+                num_groups = atoll(optarg);
+                break;
             case 'n':
                 num_items = atoi(optarg);
                 break;
             case 'p':
                 prob = atof(optarg);
                 break;
+            case 's':
+                scaling = atoi(optarg);
+                break;
+            case 'f':
+                input = optarg;
+                break;
+            case 'g':
+                generate_sf = atof(optarg);
+                break;
+            case 'm':
+                cache = optarg;
+                break;
             case '?':
             default:
                 fprintf(stderr, "invalid options");
@@ -262,22 +1172,114 @@ int main(int argc, char **argv) {
     // Check parameters.
     assert(num_items > 0);
     assert(prob >= 0.0 && prob <= 1.0);
+    if (cache != NULL && bench_alloc_is_placed()) {
+        fprintf(stderr, "columns mapped from -m are not placed; -a must be malloc");
+        exit(1);
+    }
+
+    if (num_groups > 0) {
+        if (num_groups > INT32_MAX) {
+            fprintf(stderr, "-b must be at most %d", INT32_MAX);
+            exit(1);
+        }
+        if (input != NULL || cache != NULL || o.num_chunk_sizes > 0 || o.clients > 0 || o.num_rates > 0) {
+            fprintf(stderr, "group-by mode generates its input; -f, -m, -C, -K and -L are not supported");
+            exit(1);
+        }
+        run_groups(num_items, num_groups, prob, &o);
+        return bench_verify_status();
+    }
+
+    if (o.num_chunk_sizes > 0) {
+        if (input != NULL || cache != NULL) {
+            fprintf(stderr, "chunked mode generates its input; -f and -m are not supported");
+            exit(1);
+        }
+        run_chunked(num_items, prob, &o);
+        return bench_verify_status();
+    }
+
+    if (input != NULL && generate_sf > 0.0 && access(input, R_OK) != 0) {
+        lineitem_generate(input, generate_sf);
+    }
+
+    // Identifies the input data in the column file cache.
+    char key[COLUMN_FILE_KEY_LEN];
+    struct stat st;
+    if (input != NULL && stat(input, &st) == 0) {
+        snprintf(key, sizeof(key), "tpch_q1 f=%s size=%lld mtime=%lld",
+                input, (long long) st.st_size, (long long) st.st_mtime);
+    } else {
+        snprintf(key, sizeof(key), "tpch_q1 n=%d p=%f seed=%llu",
+                num_items, prob, (unsigned long long) o.seed);
+    }
 
-    struct gen_data d = generate_data(num_items, prob);
+    struct gen_data d;
+    if (cache == NULL || !map_data(cache, key, &d)) {
+        if (input != NULL) {
+            d = load_data(input);
+        } else {
+            d = generate_data(num_items, prob, o.seed);
+        }
+        if (cache != NULL) {
+            // Run on the written file so every run measures the same input.
+            if (!write_cache(cache, key, &d)) {
+                fprintf(stderr, "could not write %s\n", cache);
+                exit(1);
+            }
+            free_generated_data(&d);
+            if (!map_data(cache, key, &d)) {
+                fprintf(stderr, "could not map %s\n", cache);
+                exit(1);
+            }
+        }
+    }
     int32_t result;
-    struct timeval start, end, diff;
-
-    gettimeofday(&start, 0);
-    result = run_query(&d);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Single-threaded C++: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, result);
-    free_generated_data(&d);
 
-    d = generate_data(num_items, prob);
-    result = run_query_weld(&d);
+    struct bench_stats stats = bench_trials(&o, [&] {
+        memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+        result = run_query(&d);
+    });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%d)", result);
+    // Every other scheme must compute the same groups.
+    struct bucket_entry expected[NUM_BUCKETS];
+    memcpy(expected, d.buckets, sizeof(expected));
+
+    stats = bench_trials(&o, [&] {
+        memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+        result = run_query_parallel(&d, o.threads);
+    });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    verify_buckets("Multi-threaded C++", expected, d.buckets, NUM_BUCKETS, o.tolerance);
+
+    if (scaling) {
+        run_scaling("Multi-threaded C++", &d, expected, &o, run_query_parallel);
+    }
+
+#ifdef __AVX2__
+    stats = bench_trials(&o, [&] {
+        memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+        result = run_query_simd(&d, 1);
+    });
+    bench_report_stats("SIMD C++", &stats, "(result=%d)", result);
+    verify_buckets("SIMD C++", expected, d.buckets, NUM_BUCKETS, o.tolerance);
+
+    stats = bench_trials(&o, [&] {
+        memset(d.buckets, 0, sizeof(struct bucket_entry) * NUM_BUCKETS);
+        result = run_query_simd(&d, o.threads);
+    });
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    verify_buckets("Multi-threaded SIMD C++", expected, d.buckets, NUM_BUCKETS, o.tolerance);
+
+    if (scaling) {
+        run_scaling("Multi-threaded SIMD C++", &d, expected, &o, run_query_simd);
+    }
+#endif
+
+    struct bucket_entry weld_buckets[NUM_BUCKETS];
+    run_query_weld(&d, &o, weld_buckets);
+    verify_buckets("Weld", expected, weld_buckets, NUM_BUCKETS, o.tolerance);
     free_generated_data(&d);
 
-    return 0;
+    return bench_verify_status();
 }
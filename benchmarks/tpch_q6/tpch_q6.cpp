@@ -16,24 +16,41 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <sys/stat.h>
 
-#include "weld.h"
+#include "weld_bench.h"
+#include "bench_columns.h"
+#include "bench_reader.h"
+#include "tpch_lineitem.h"
 
 // Value for the predicate to pass.
 #define PASS 19940101
 #define FAIL 19930101
+// Discount and quantity values that pass or fail their predicates.
+#define DISCOUNT_PASS 6.0
+#define DISCOUNT_FAIL 8.0
+#define QUANTITY_PASS 12.0
+#define QUANTITY_FAIL 36.0
+
+// Selectivity of each Q6 predicate in the generated data.
+struct selectivities {
+    double shipdate;
+    double discount;
+    double quantity;
+};
 
 // The generated input data.
 struct gen_data {
     // Number of lineitems in the table.
     int64_t num_items;
-    // Probability that the branch in the query will be taken.
-    double prob;
+    // Probability that each predicate in the query passes.
+    struct selectivities sel;
     // The input data.
     struct lineitems *items;
     // The hash table.
     struct bucket_entry *buckets;
+    // The column file the input data is mapped from, if base is not NULL.
+    struct column_file cache;
 };
 
 // An input data item represented as in a row format.
@@ -44,12 +61,6 @@ struct lineitems {
     double *extended_prices;
 };
 
-template <typename T>
-struct weld_vector {
-    T *data;
-    int64_t length;
-};
-
 struct args {
     struct weld_vector<int32_t> shipdates;
     struct weld_vector<double> discounts;
@@ -57,14 +68,6 @@ struct args {
     struct weld_vector<double> extended_prices;
 };
 
-template <typename T>
-weld_vector<T> make_weld_vector(T *data, int64_t length) {
-    struct weld_vector<T> vector;
-    vector.data = data;
-    vector.length = length;
-    return vector;
-}
-
 double run_query(struct gen_data *d) {
     double final_result = 0.0;
     for (int i = 0; i < d->num_items; i++) {
@@ -80,110 +83,535 @@ double run_query(struct gen_data *d) {
     return final_result;
 }
 
-double run_query_weld(struct gen_data *d) {
-    // Compile Weld module.
-    weld_error_t e = weld_error_new();
-    weld_conf_t conf = weld_conf_new();
-
-    FILE *fptr = fopen("tpch_q6.weld", "r");
-    fseek(fptr, 0, SEEK_END);
-    int string_size = ftell(fptr);
-    rewind(fptr);
-    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
-    fread(program, sizeof(char), string_size, fptr);
-    program[string_size] = '\0';
-
-    struct timeval start, end, diff;
-    gettimeofday(&start, 0);
-    weld_module_t m = weld_module_compile(program, conf, e);
-    weld_conf_free(conf);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld compile time: %ld.%06ld\n",
-            (long) diff.tv_sec, (long) diff.tv_usec);
-
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+/** Q6 with every predicate evaluated and combined with a non-short-circuit
+ * &, and the sum masked with a select instead of a branch. */
+double run_query_predicated(struct gen_data *d) {
+    struct lineitems *items = d->items;
+    double result = 0.0;
+    for (int64_t i = 0; i < d->num_items; i++) {
+        bool pass = (items->shipdates[i] >= 19940101) & (items->shipdates[i] < 19950101) &
+            (items->discounts[i] >= 5.0) & (items->discounts[i] <= 7.0) & (items->quantities[i] < 24.0);
+        double value = items->discounts[i] * items->extended_prices[i];
+        result += pass ? value : 0.0;
     }
+    return result;
+}
 
-   gettimeofday(&start, 0);
-   struct args args;
-   args.shipdates = make_weld_vector<int32_t>(d->items->shipdates, d->num_items);
-   args.discounts = make_weld_vector<double>(d->items->discounts, d->num_items);
-   args.quantities = make_weld_vector<double>(d->items->quantities, d->num_items);
-   args.extended_prices = make_weld_vector<double>(d->items->extended_prices, d->num_items);
+double run_query_range(struct lineitems *items, int64_t start, int64_t end) {
+    double result = 0.0;
+    for (int64_t i = start; i < end; i++) {
+        if (items->shipdates[i] >= 19940101 && items->shipdates[i] < 19950101 &&
+            items->discounts[i] >= 5.0 && items->discounts[i] <= 7.0 && items->quantities[i] < 24.0) {
+            result += (items->discounts[i] * items->extended_prices[i]);
+        }
+    }
+    return result;
+}
 
-   weld_value_t weld_args = weld_value_new(&args);
+double run_query_parallel(struct gen_data *d, int threads) {
+    return bench_parallel_sum<double>(threads, d->num_items, [&](int64_t start, int64_t end) {
+        return run_query_range(d->items, start, end);
+    });
+}
 
-   // Run the module and get the result.
-    conf = weld_conf_new();
-    weld_value_t result = weld_module_run(m, conf, weld_args, e);
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+#ifdef __AVX2__
+double run_query_simd_range(struct lineitems *items, int64_t start, int64_t end) {
+    const __m128i date_lo = _mm_set1_epi32(19940101 - 1);
+    const __m128i date_hi = _mm_set1_epi32(19950101);
+    const __m256d disc_lo = _mm256_set1_pd(5.0);
+    const __m256d disc_hi = _mm256_set1_pd(7.0);
+    const __m256d qty_hi = _mm256_set1_pd(24.0);
+
+    __m256d acc = _mm256_setzero_pd();
+    int64_t i = start;
+    for (; i + 4 <= end; i += 4) {
+        // Evaluate every predicate and combine them as masks, without branches.
+        __m128i ship = _mm_loadu_si128((const __m128i *) &items->shipdates[i]);
+        __m128i ship_ok = _mm_and_si128(_mm_cmpgt_epi32(ship, date_lo), _mm_cmplt_epi32(ship, date_hi));
+        __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(ship_ok));
+
+        __m256d disc = _mm256_loadu_pd(&items->discounts[i]);
+        __m256d qty = _mm256_loadu_pd(&items->quantities[i]);
+        __m256d ep = _mm256_loadu_pd(&items->extended_prices[i]);
+        mask = _mm256_and_pd(mask, _mm256_cmp_pd(disc, disc_lo, _CMP_GE_OQ));
+        mask = _mm256_and_pd(mask, _mm256_cmp_pd(disc, disc_hi, _CMP_LE_OQ));
+        mask = _mm256_and_pd(mask, _mm256_cmp_pd(qty, qty_hi, _CMP_LT_OQ));
+
+        acc = _mm256_add_pd(acc, _mm256_and_pd(mask, _mm256_mul_pd(disc, ep)));
     }
-    double *result_data = (double *) weld_value_data(result);
-    double final_result = *result_data;
+    return bench_hsum_pd(acc) + run_query_range(items, i, end);
+}
 
-    // Free the values.
-    weld_value_free(result);
-    weld_value_free(weld_args);
-    weld_conf_free(conf);
+// Rows per bitmap block; a block's bitmap stays in L1.
+#define BITMAP_BLOCK 2048
+
+/** Q6 over [start, end) using bitmaps: each predicate is evaluated column at
+ * a time with SIMD compares into a per-block bitmap, the bitmaps are ANDed,
+ * and only rows whose bit survives are summed. */
+double run_query_bitmap_range(struct lineitems *items, int64_t start, int64_t end) {
+    const __m256i date_lo = _mm256_set1_epi32(19940101 - 1);
+    const __m256i date_hi = _mm256_set1_epi32(19950101);
+    const __m256d disc_lo = _mm256_set1_pd(5.0);
+    const __m256d disc_hi = _mm256_set1_pd(7.0);
+    const __m256d qty_hi = _mm256_set1_pd(24.0);
+
+    uint64_t bitmap[BITMAP_BLOCK / 64];
+    double result = 0.0;
+    int64_t block = start;
+    while (block + 64 <= end) {
+        int64_t words = (end - block) / 64;
+        if (words > BITMAP_BLOCK / 64) {
+            words = BITMAP_BLOCK / 64;
+        }
 
-    weld_error_free(e);
-    weld_module_free(m);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld: %ld.%06ld (result=%.4f)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, final_result);
+        for (int64_t w = 0; w < words; w++) {
+            const int32_t *ship = &items->shipdates[block + w * 64];
+            uint64_t bits = 0;
+            for (int j = 0; j < 64; j += 8) {
+                __m256i x = _mm256_loadu_si256((const __m256i *) &ship[j]);
+                __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi32(x, date_lo), _mm256_cmpgt_epi32(date_hi, x));
+                bits |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(ok)) << j;
+            }
+            bitmap[w] = bits;
+        }
+
+        for (int64_t w = 0; w < words; w++) {
+            const double *disc = &items->discounts[block + w * 64];
+            uint64_t bits = 0;
+            for (int j = 0; j < 64; j += 4) {
+                __m256d x = _mm256_loadu_pd(&disc[j]);
+                __m256d ok = _mm256_and_pd(_mm256_cmp_pd(x, disc_lo, _CMP_GE_OQ),
+                                           _mm256_cmp_pd(x, disc_hi, _CMP_LE_OQ));
+                bits |= (uint64_t) _mm256_movemask_pd(ok) << j;
+            }
+            bitmap[w] &= bits;
+        }
+
+        for (int64_t w = 0; w < words; w++) {
+            const double *qty = &items->quantities[block + w * 64];
+            uint64_t bits = 0;
+            for (int j = 0; j < 64; j += 4) {
+                __m256d ok = _mm256_cmp_pd(_mm256_loadu_pd(&qty[j]), qty_hi, _CMP_LT_OQ);
+                bits |= (uint64_t) _mm256_movemask_pd(ok) << j;
+            }
+            bitmap[w] &= bits;
+        }
+
+        for (int64_t w = 0; w < words; w++) {
+            uint64_t bits = bitmap[w];
+            int64_t base = block + w * 64;
+            while (bits != 0) {
+                int64_t i = base + __builtin_ctzll(bits);
+                result += items->discounts[i] * items->extended_prices[i];
+                bits &= bits - 1;
+            }
+        }
+        block += words * 64;
+    }
+    // Rows past the last full 64-row word.
+    return result + run_query_range(items, block, end);
+}
+
+double run_query_simd(struct gen_data *d, int threads) {
+    return bench_parallel_sum<double>(threads, d->num_items, [&](int64_t start, int64_t end) {
+        return run_query_simd_range(d->items, start, end);
+    });
+}
+#endif
+
+/** Returns a copy of a column, allocated with bench_alloc. */
+template <typename T>
+T *copy_column(const T *src, int64_t n) {
+    T *dst = (T *) bench_alloc(sizeof(T) * n);
+    memcpy(dst, src, sizeof(T) * n);
+    return dst;
+}
+
+/** Runs the concurrent Weld modes on one compiled module: throughput with
+ * up to o->clients clients, and open-loop latency at each rate in o->rates
+ * with a pool of o->clients workers (one if unset). Each client or worker
+ * queries its own copy of the input. */
+void run_concurrent_weld(struct gen_data *d, const struct bench_options *o,
+        struct weld_bench_module *m) {
+    int clients = o->clients > 0 ? o->clients : 1;
+    struct args *client_args = new struct args[clients];
+    void **arg_ptrs = new void *[clients];
+    for (int c = 0; c < clients; c++) {
+        struct args *a = &client_args[c];
+        a->shipdates = make_weld_vector<int32_t>(
+                copy_column(d->items->shipdates, d->num_items), d->num_items);
+        a->discounts = make_weld_vector<double>(
+                copy_column(d->items->discounts, d->num_items), d->num_items);
+        a->quantities = make_weld_vector<double>(
+                copy_column(d->items->quantities, d->num_items), d->num_items);
+        a->extended_prices = make_weld_vector<double>(
+                copy_column(d->items->extended_prices, d->num_items), d->num_items);
+        arg_ptrs[c] = a;
+    }
 
+    if (o->clients > 0) {
+        weld_bench_throughput<double>(o, "Weld throughput", m, arg_ptrs, weld_bench_scalar<double>);
+    }
+    if (o->num_rates > 0) {
+        weld_bench_open_loop<double>(o, "Weld open-loop", m, clients, arg_ptrs,
+                weld_bench_scalar<double>);
+    }
+
+    for (int c = 0; c < clients; c++) {
+        bench_free(client_args[c].shipdates.data);
+        bench_free(client_args[c].discounts.data);
+        bench_free(client_args[c].quantities.data);
+        bench_free(client_args[c].extended_prices.data);
+    }
+    delete[] arg_ptrs;
+    delete[] client_args;
+}
+
+double run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("tpch_q6.weld");
+
+    struct args args;
+    args.shipdates = make_weld_vector<int32_t>(d->items->shipdates, d->num_items);
+    args.discounts = make_weld_vector<double>(d->items->discounts, d->num_items);
+    args.quantities = make_weld_vector<double>(d->items->quantities, d->num_items);
+    args.extended_prices = make_weld_vector<double>(d->items->extended_prices, d->num_items);
+
+    double final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, weld_bench_scalar<double>, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%.4f)", final_result);
+
+    if (o->clients > 0 || o->num_rates > 0) {
+        run_concurrent_weld(d, o, &m);
+    }
+
+    weld_bench_module_free(&m);
     return final_result;
 }
 
+/** Allocates the columns of num_items line items with bench_alloc. */
+void alloc_items(struct lineitems *items, int64_t num_items) {
+    items->shipdates = (int32_t *) bench_alloc(sizeof(int32_t) * num_items);
+    items->discounts = (double *) bench_alloc(sizeof(double) * num_items);
+    items->quantities = (double *) bench_alloc(sizeof(double) * num_items);
+    items->extended_prices = (double *) bench_alloc(sizeof(double) * num_items);
+}
+
+/** Generates rows [first, first + n) of the input into items.
+ *
+ * Each predicate's column is drawn independently, so the selectivity of the
+ * shipdate, discount and quantity predicates can be varied one at a time.
+ */
+void generate_rows(struct lineitems *items, int64_t first, int64_t n,
+        struct selectivities sel, uint64_t seed) {
+    // One random stream per column, so the predicates pass independently.
+    bench_fill_selectivity<int32_t>(items->shipdates, n, sel.shipdate, PASS, FAIL,
+            bench_rng_make(seed, 0), first);
+    bench_fill_selectivity<double>(items->discounts, n, sel.discount,
+            DISCOUNT_PASS, DISCOUNT_FAIL, bench_rng_make(seed, 1), first);
+    bench_fill_selectivity<double>(items->quantities, n, sel.quantity,
+            QUANTITY_PASS, QUANTITY_FAIL, bench_rng_make(seed, 2), first);
+    bench_generate(items->extended_prices, n, bench_rng_make(seed, 3), [](uint64_t r) {
+        return (double) bench_random_uniform(r, 0, 99);
+    }, first);
+}
+
 /** Generates input data.
  *
  * @param num_items the number of line items.
- * @param prob the selectivity of the branch.
+ * @param sel the selectivity of each predicate.
+ * @param seed the seed of the random values.
  * @return the generated data in a structure.
  */
-struct gen_data generate_data(int num_items, double prob) {
+struct gen_data generate_data(int num_items, struct selectivities sel, uint64_t seed) {
     struct gen_data d;
 
     d.num_items = num_items;
-    d.prob = prob;
+    d.sel = sel;
+    d.cache.base = NULL;
 
     d.items = (struct lineitems *)malloc(sizeof(struct lineitems));
+    alloc_items(d.items, num_items);
+    generate_rows(d.items, 0, num_items, sel, seed);
 
-    d.items->shipdates = (int32_t *) malloc(sizeof(int32_t) * num_items);
-    d.items->discounts = (double *) malloc(sizeof(double) * num_items);
-    d.items->quantities = (double *) malloc(sizeof(double) * num_items);
-    d.items->extended_prices = (double *) malloc(sizeof(double) * num_items);
+    return d;
+}
 
-    int pass_thres = (int)(prob * 1000000.0);
-    srand(1);
-    for (int i = 0; i < d.num_items; i++) {
-        if (rand() % 1000000 <= pass_thres) {
-            d.items->shipdates[i] = PASS;
-        } else {
-            d.items->shipdates[i] = FAIL;
+/** Runs Q6 over generated input in chunks, without materializing it.
+ *
+ * For each chunk size in o->chunk_sizes, the input is generated chunk by
+ * chunk into two buffers while the previous chunk is queried, and the
+ * per-chunk sums are added up. The result matches the query over the whole
+ * generated input, up to floating-point summation order.
+ *
+ * @param num_items the number of line items.
+ * @param sel the selectivity of each predicate.
+ * @param o the options; the seed and chunk sizes are used.
+ */
+void run_chunked(int64_t num_items, struct selectivities sel, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("tpch_q6.weld");
+
+    for (int c = 0; c < o->num_chunk_sizes; c++) {
+        int64_t chunk_rows = o->chunk_sizes[c] < num_items ? o->chunk_sizes[c] : num_items;
+        int64_t num_chunks = (num_items + chunk_rows - 1) / chunk_rows;
+        struct lineitems slots[BENCH_PIPELINE_SLOTS];
+        for (int s = 0; s < BENCH_PIPELINE_SLOTS; s++) {
+            alloc_items(&slots[s], chunk_rows);
         }
+        auto produce = [&](int slot, int64_t start, int64_t end) {
+            generate_rows(&slots[slot], start, end - start, sel, o->seed);
+        };
+
+        double result, stall;
+        struct bench_stats stats = bench_trials(o, [&] {
+            result = 0.0;
+            bench_pipeline(num_items, chunk_rows, produce, [&](int slot, int64_t start, int64_t end) {
+                struct gen_data view;
+                view.num_items = end - start;
+                view.items = &slots[slot];
+                result += run_query_parallel(&view, o->threads);
+            }, &stall);
+        });
+        char scheme[64];
+        snprintf(scheme, sizeof(scheme), "Multi-threaded C++ chunked (rows=%lld)", (long long) chunk_rows);
+        bench_report_stats(scheme, &stats, "(result=%.4f, threads=%d, chunks=%lld, rows-per-sec=%.0f, stall=%.9f)",
+                result, o->threads, (long long) num_chunks, num_items / stats.median, stall);
+        // The input is never materialized whole, so the native chunked
+        // result is the reference for the Weld one.
+        double expected = result;
+
+        stats = bench_trials(o, [&] {
+            result = 0.0;
+            bench_pipeline(num_items, chunk_rows, produce, [&](int slot, int64_t start, int64_t end) {
+                struct args args;
+                int64_t n = end - start;
+                args.shipdates = make_weld_vector<int32_t>(slots[slot].shipdates, n);
+                args.discounts = make_weld_vector<double>(slots[slot].discounts, n);
+                args.quantities = make_weld_vector<double>(slots[slot].quantities, n);
+                args.extended_prices = make_weld_vector<double>(slots[slot].extended_prices, n);
+                // The merger[f64,+] result of each chunk is a partial sum.
+                result += weld_bench_query<double>(&m, &args, weld_bench_scalar<double>);
+            }, &stall);
+        });
+        snprintf(scheme, sizeof(scheme), "Weld chunked (rows=%lld)", (long long) chunk_rows);
+        bench_report_stats(scheme, &stats, "(result=%.4f, chunks=%lld, rows-per-sec=%.0f, stall=%.9f)",
+                result, (long long) num_chunks, num_items / stats.median, stall);
+        bench_verify_double(scheme, "result", expected, result, o->tolerance);
+
+        for (int s = 0; s < BENCH_PIPELINE_SLOTS; s++) {
+            bench_free(slots[s].shipdates);
+            bench_free(slots[s].discounts);
+            bench_free(slots[s].quantities);
+            bench_free(slots[s].extended_prices);
+        }
+    }
+
+    weld_bench_module_free(&m);
+}
+
+/** Opens a column file written by write_cache for scanning in blocks. */
+struct column_reader *open_reader(const char *path, const char *key, int64_t block_rows,
+        const struct bench_options *o) {
+    static const struct column_reader_column columns[] = {
+        { "shipdates", COLUMN_INT32 },
+        { "discounts", COLUMN_DOUBLE },
+        { "quantities", COLUMN_DOUBLE },
+        { "extended_prices", COLUMN_DOUBLE },
+    };
+    struct column_reader *r = column_reader_open(path, key, columns,
+            sizeof(columns) / sizeof(columns[0]), block_rows, o->read_depth, o->reader);
+    if (r == NULL) {
+        fprintf(stderr, "could not open %s\n", path);
+        exit(1);
+    }
+    return r;
+}
+
+/** Returns a view of the line items in a block read by open_reader's reader. */
+struct lineitems block_items(const struct column_block *b) {
+    struct lineitems items;
+    items.shipdates = (int32_t *) b->columns[0];
+    items.discounts = (double *) b->columns[1];
+    items.quantities = (double *) b->columns[2];
+    items.extended_prices = (double *) b->columns[3];
+    return items;
+}
 
-        d.items->discounts[i] = 6.0f;
-        d.items->quantities[i] = 12.0f;
-        d.items->extended_prices[i] = rand() % 100;
+/** Runs Q6 over a column file read from disk in blocks.
+ *
+ * For each chunk size in o->chunk_sizes, every trial opens the file with
+ * its pages evicted and reads it with o->read_depth blocks in flight,
+ * querying each block as it arrives, so the times cover the whole path from
+ * the file to the result.
+ *
+ * @param path the column file, written by write_cache.
+ * @param key the parameters the data was generated with.
+ * @param expected the result over the whole file, which both scans are
+ * checked against.
+ * @param o the options; the chunk sizes and reader settings are used.
+ */
+void run_scan(const char *path, const char *key, double expected, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("tpch_q6.weld");
+
+    for (int c = 0; c < o->num_chunk_sizes; c++) {
+        double result, stall;
+        int64_t bytes, num_rows, block_rows, num_blocks;
+        const char *io;
+        // Records the reader's settings and closes it.
+        auto finish = [&](struct column_reader *r) {
+            num_rows = column_reader_num_rows(r);
+            block_rows = column_reader_block_rows(r);
+            num_blocks = column_reader_num_blocks(r);
+            stall = column_reader_stall(r);
+            io = column_reader_backend_name(r);
+            column_reader_close(r);
+        };
+
+        struct bench_stats stats = bench_trials(o, [&] {
+            struct column_reader *r = open_reader(path, key, o->chunk_sizes[c], o);
+            result = 0.0;
+            bytes = bench_scan(r, [&](const struct column_block *b) {
+                struct lineitems items = block_items(b);
+                struct gen_data view;
+                view.num_items = b->rows;
+                view.items = &items;
+                result += run_query_parallel(&view, o->threads);
+            });
+            finish(r);
+        });
+        char scheme[64];
+        snprintf(scheme, sizeof(scheme), "Multi-threaded C++ scan (rows=%lld)", (long long) block_rows);
+        bench_report_stats(scheme, &stats,
+                "(result=%.4f, threads=%d, io=%s, depth=%d, blocks=%lld, rows-per-sec=%.0f, mb-per-sec=%.1f, stall=%.9f)",
+                result, o->threads, io, o->read_depth, (long long) num_blocks,
+                num_rows / stats.median, bytes / stats.median / 1e6, stall);
+        bench_verify_double(scheme, "result", expected, result, o->tolerance);
+
+        stats = bench_trials(o, [&] {
+            struct column_reader *r = open_reader(path, key, o->chunk_sizes[c], o);
+            result = 0.0;
+            bytes = bench_scan(r, [&](const struct column_block *b) {
+                struct args args;
+                args.shipdates = make_weld_vector<int32_t>((int32_t *) b->columns[0], b->rows);
+                args.discounts = make_weld_vector<double>((double *) b->columns[1], b->rows);
+                args.quantities = make_weld_vector<double>((double *) b->columns[2], b->rows);
+                args.extended_prices = make_weld_vector<double>((double *) b->columns[3], b->rows);
+                result += weld_bench_query<double>(&m, &args, weld_bench_scalar<double>);
+            });
+            finish(r);
+        });
+        snprintf(scheme, sizeof(scheme), "Weld scan (rows=%lld)", (long long) block_rows);
+        bench_report_stats(scheme, &stats,
+                "(result=%.4f, io=%s, depth=%d, blocks=%lld, rows-per-sec=%.0f, mb-per-sec=%.1f, stall=%.9f)",
+                result, io, o->read_depth, (long long) num_blocks,
+                num_rows / stats.median, bytes / stats.median / 1e6, stall);
+        bench_verify_double(scheme, "result", expected, result, o->tolerance);
+    }
+
+    weld_bench_module_free(&m);
+}
+
+/** Returns the fraction of line items that pass each predicate. */
+struct selectivities measure_selectivities(const struct gen_data *d) {
+    const struct lineitems *items = d->items;
+    int64_t shipdate = 0, discount = 0, quantity = 0;
+    for (int64_t i = 0; i < d->num_items; i++) {
+        shipdate += (items->shipdates[i] >= 19940101 && items->shipdates[i] < 19950101);
+        discount += (items->discounts[i] >= 5.0 && items->discounts[i] <= 7.0);
+        quantity += (items->quantities[i] < 24.0);
+    }
+    double n = d->num_items > 0 ? (double) d->num_items : 1.0;
+    struct selectivities sel;
+    sel.shipdate = shipdate / n;
+    sel.discount = discount / n;
+    sel.quantity = quantity / n;
+    return sel;
+}
+
+/** Loads input data from a dbgen-format lineitem table.
+ *
+ * Discounts are stored in percent (0.06 becomes 6.0), the unit the query's
+ * predicates and tpch_q6.weld use.
+ *
+ * @param path the lineitem.tbl file.
+ * @return the loaded data in a structure.
+ */
+struct gen_data load_data(const char *path) {
+    struct lineitem_columns c = lineitem_load(path);
+    struct gen_data d;
+
+    d.num_items = c.num_items;
+    d.cache.base = NULL;
+
+    d.items = (struct lineitems *)malloc(sizeof(struct lineitems));
+    d.items->shipdates = c.shipdates;
+    d.items->discounts = c.discounts;
+    d.items->quantities = c.quantities;
+    d.items->extended_prices = c.extended_prices;
+    for (int64_t i = 0; i < d.num_items; i++) {
+        d.items->discounts[i] *= 100.0;
     }
+    d.sel = measure_selectivities(&d);
 
+    bench_free(c.return_flags);
+    bench_free(c.line_statuses);
+    bench_free(c.taxes);
     return d;
 }
 
+/** Writes the input columns to a column file.
+ *
+ * @param path the column file.
+ * @param key the parameters the data was generated with.
+ * @param d the data to write.
+ * @return true on success.
+ */
+bool write_cache(const char *path, const char *key, const struct gen_data *d) {
+    struct column_spec columns[] = {
+        { "shipdates", COLUMN_INT32, d->items->shipdates },
+        { "discounts", COLUMN_DOUBLE, d->items->discounts },
+        { "quantities", COLUMN_DOUBLE, d->items->quantities },
+        { "extended_prices", COLUMN_DOUBLE, d->items->extended_prices },
+    };
+    return column_file_write(path, key, d->num_items, columns,
+            sizeof(columns) / sizeof(columns[0]));
+}
+
+/** Maps input data from a column file written by write_cache.
+ *
+ * The columns point into the mapping, so they are shared without copies
+ * by the native kernels and the Weld arguments.
+ *
+ * @param path the column file.
+ * @param key the parameters the data must have been generated with.
+ * @param d the mapped data, set on success.
+ * @return true on success, false if the file is missing or stale.
+ */
+bool map_data(const char *path, const char *key, struct gen_data *d) {
+    if (!column_file_map(path, key, &d->cache)) {
+        return false;
+    }
+    struct column_file *f = &d->cache;
+    d->num_items = f->num_rows;
+
+    d->items = (struct lineitems *)malloc(sizeof(struct lineitems));
+    d->items->shipdates = (int32_t *) column_file_column(f, "shipdates", COLUMN_INT32);
+    d->items->discounts = (double *) column_file_column(f, "discounts", COLUMN_DOUBLE);
+    d->items->quantities = (double *) column_file_column(f, "quantities", COLUMN_DOUBLE);
+    d->items->extended_prices = (double *) column_file_column(f, "extended_prices", COLUMN_DOUBLE);
+
+    d->sel = measure_selectivities(d);
+    return true;
+}
+
 void free_generated_data(struct gen_data *d) {
-    free(d->items->shipdates);
-    free(d->items->discounts);
-    free(d->items->quantities);
-    free(d->items->extended_prices);
+    if (d->cache.base != NULL) {
+        column_file_unmap(&d->cache);
+    } else {
+        bench_free(d->items->shipdates);
+        bench_free(d->items->discounts);
+        bench_free(d->items->quantities);
+        bench_free(d->items->extended_prices);
+    }
 
     free(d->items);
 }
@@ -194,16 +622,27 @@ void handler(int sig) {
 }
 
 int main(int argc, char **argv) {
-
-
-
     // Number of elements in array (should be >> cache size);
     int num_items = 113058;// (1E8 / sizeof(int));
     // Approx. PASS probability.
     double prob = 1.0; //0.01;
+    // The predicate whose selectivity -p sets: shipdate, discount, quantity
+    // or all. The others always pass.
+    const char *column = "shipdate";
+    // A dbgen lineitem table to load instead of generating data, and the
+    // scale factor to generate it at if it does not exist yet.
+    const char *input = NULL;
+    double generate_sf = 0.0;
+    // A column file caching the input data across runs.
+    const char *cache = NULL;
+
+    struct bench_options o = bench_options_default();
 
     int ch;
-    while ((ch = getopt(argc, argv, "b:n:p:")) != -1) {
+    while ((ch = getopt(argc, argv, "b:c:f:g:m:n:p:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
         switch (ch) {
             case 'n':
                 num_items = atoi(optarg);
@@ -211,6 +650,18 @@ int main(int argc, char **argv) {
             case 'p':
                 prob = atof(optarg);
                 break;
+            case 'c':
+                column = optarg;
+                break;
+            case 'f':
+                input = optarg;
+                break;
+            case 'g':
+                generate_sf = atof(optarg);
+                break;
+            case 'm':
+                cache = optarg;
+                break;
             case '?':
             default:
                 fprintf(stderr, "invalid options");
@@ -221,24 +672,117 @@ int main(int argc, char **argv) {
     // Check parameters.
     assert(num_items > 0);
     assert(prob >= 0.0 && prob <= 1.0);
+    if (cache != NULL && bench_alloc_is_placed()) {
+        fprintf(stderr, "columns mapped from -m are not placed; -a must be malloc");
+        exit(1);
+    }
 
-    struct gen_data d = generate_data(num_items, prob);
+    bool all = strcmp(column, "all") == 0;
+    if (!all && strcmp(column, "shipdate") != 0 && strcmp(column, "discount") != 0 &&
+            strcmp(column, "quantity") != 0) {
+        fprintf(stderr, "invalid predicate column");
+        exit(1);
+    }
+    struct selectivities sel;
+    sel.shipdate = (all || strcmp(column, "shipdate") == 0) ? prob : 1.0;
+    sel.discount = (all || strcmp(column, "discount") == 0) ? prob : 1.0;
+    sel.quantity = (all || strcmp(column, "quantity") == 0) ? prob : 1.0;
+
+    if (o.num_chunk_sizes > 0 && cache == NULL) {
+        if (input != NULL) {
+            fprintf(stderr, "chunked mode without -m generates its input; -f needs -m");
+            exit(1);
+        }
+        run_chunked(num_items, sel, &o);
+        return bench_verify_status();
+    }
+
+    if (input != NULL && generate_sf > 0.0 && access(input, R_OK) != 0) {
+        lineitem_generate(input, generate_sf);
+    }
+
+    // Identifies the input data in the column file cache.
+    char key[COLUMN_FILE_KEY_LEN];
+    struct stat st;
+    if (input != NULL && stat(input, &st) == 0) {
+        snprintf(key, sizeof(key), "tpch_q6 f=%s size=%lld mtime=%lld",
+                input, (long long) st.st_size, (long long) st.st_mtime);
+    } else {
+        snprintf(key, sizeof(key), "tpch_q6 n=%d shipdate=%f discount=%f quantity=%f seed=%llu",
+                num_items, sel.shipdate, sel.discount, sel.quantity, (unsigned long long) o.seed);
+    }
+
+    struct gen_data d;
+    if (o.num_chunk_sizes > 0) {
+        // Scan the column file from disk, writing it first if it is missing.
+        if (!column_file_check(cache, key)) {
+            d = input != NULL ? load_data(input) : generate_data(num_items, sel, o.seed);
+            if (!write_cache(cache, key, &d)) {
+                fprintf(stderr, "could not write %s\n", cache);
+                exit(1);
+            }
+            free_generated_data(&d);
+        }
+        if (!map_data(cache, key, &d)) {
+            fprintf(stderr, "could not map %s\n", cache);
+            exit(1);
+        }
+        double expected = run_query(&d);
+        free_generated_data(&d);
+        run_scan(cache, key, expected, &o);
+        return bench_verify_status();
+    }
+    if (cache == NULL || !map_data(cache, key, &d)) {
+        if (input != NULL) {
+            d = load_data(input);
+        } else {
+            d = generate_data(num_items, sel, o.seed);
+        }
+        if (cache != NULL) {
+            // Run on the written file so every run measures the same input.
+            if (!write_cache(cache, key, &d)) {
+                fprintf(stderr, "could not write %s\n", cache);
+                exit(1);
+            }
+            free_generated_data(&d);
+            if (!map_data(cache, key, &d)) {
+                fprintf(stderr, "could not map %s\n", cache);
+                exit(1);
+            }
+        }
+    }
     double result_c, result_weld;
-    struct timeval start, end, diff;
-
-    gettimeofday(&start, 0);
-    result_c = run_query(&d);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Single-threaded C++: %ld.%06ld (result=%.4f)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, result_c);
-    free_generated_data(&d);
 
-    d = generate_data(num_items, prob);
-    result_weld = run_query_weld(&d);
-    free_generated_data(&d);
+    struct bench_stats stats = bench_trials(&o, [&] { result_c = run_query(&d); });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%.4f)", result_c);
+    // Every other scheme must compute the same sum, up to summation order.
+
+    double result_native;
+    stats = bench_trials(&o, [&] { result_native = run_query_predicated(&d); });
+    bench_report_stats("Predicated C++", &stats, "(result=%.4f)", result_native);
+    bench_verify_double("Predicated C++", "result", result_c, result_native, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result_native = run_query_parallel(&d, o.threads); });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%.4f, threads=%d)", result_native, o.threads);
+    bench_verify_double("Multi-threaded C++", "result", result_c, result_native, o.tolerance);
+
+#ifdef __AVX2__
+    stats = bench_trials(&o, [&] { result_native = run_query_simd(&d, 1); });
+    bench_report_stats("SIMD C++", &stats, "(result=%.4f)", result_native);
+    bench_verify_double("SIMD C++", "result", result_c, result_native, o.tolerance);
 
-    printf("Difference: %f\n", result_weld - result_c);
+    stats = bench_trials(&o, [&] { result_native = run_query_bitmap_range(d.items, 0, d.num_items); });
+    bench_report_stats("Bitmap SIMD C++", &stats, "(result=%.4f)", result_native);
+    bench_verify_double("Bitmap SIMD C++", "result", result_c, result_native, o.tolerance);
+
+    stats = bench_trials(&o, [&] { result_native = run_query_simd(&d, o.threads); });
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%.4f, threads=%d)", result_native, o.threads);
+    bench_verify_double("Multi-threaded SIMD C++", "result", result_c, result_native, o.tolerance);
+#endif
+
+    result_weld = run_query_weld(&d, &o);
+    bench_verify_double("Weld", "result", result_c, result_weld, o.tolerance);
+    free_generated_data(&d);
 
-    return 0;
+    return bench_verify_status();
 }
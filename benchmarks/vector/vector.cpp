@@ -16,9 +16,8 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
 
-#include "weld.h"
+#include "weld_bench.h"
 
 // The generated input data.
 struct gen_data {
@@ -27,113 +26,101 @@ struct gen_data {
     int32_t a;
 };
 
-template <typename T>
-struct weld_vector {
-    T *data;
-    int64_t size;
-};
-
 struct args {
     struct weld_vector<int32_t> x;
     int32_t a;
 };
 
-template <typename T>
-weld_vector<T> make_weld_vector(T *data, int64_t size) {
-    struct weld_vector<T> vector;
-    vector.data = data;
-    vector.size = size;
-    return vector;
+/** Returns the output vector, allocated with malloc. */
+int32_t *run_query(struct gen_data *d) {
+    int32_t *result = (int32_t *) malloc(sizeof(int32_t) * d->size);
+    for (int64_t i = 0; i < d->size; i++) {
+        result[i] = d->x[i] + d->a;
+    }
+    return result;
 }
 
-int32_t run_query(struct gen_data *d) {
+int32_t *run_query_parallel(struct gen_data *d, int threads) {
     int32_t *result = (int32_t *) malloc(sizeof(int32_t) * d->size);
-    for (int i = 0; i < d->size; i++) {
+    bench_parallel_for(threads, d->size, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            result[i] = d->x[i] + d->a;
+        }
+    });
+    return result;
+}
+
+#ifdef __AVX2__
+void run_query_simd_range(struct gen_data *d, int32_t *result, int64_t start, int64_t end) {
+    __m256i a = _mm256_set1_epi32(d->a);
+    int64_t i = start;
+    for (; i + 8 <= end; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) &d->x[i]);
+        _mm256_storeu_si256((__m256i *) &result[i], _mm256_add_epi32(x, a));
+    }
+    for (; i < end; i++) {
         result[i] = d->x[i] + d->a;
     }
-    return result[0];
 }
 
-int32_t run_query_weld(struct gen_data *d) {
-    // Compile Weld module.
-    weld_error_t e = weld_error_new();
-    weld_conf_t conf = weld_conf_new();
-
-    FILE *fptr = fopen("vector.weld", "r");
-    fseek(fptr, 0, SEEK_END);
-    int string_size = ftell(fptr);
-    rewind(fptr);
-    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
-    fread(program, sizeof(char), string_size, fptr);
-    program[string_size] = '\0';
-
-    struct timeval start, end, diff;
-
-    gettimeofday(&start, 0);
-    weld_module_t m = weld_module_compile(program, conf, e);
-    weld_conf_free(conf);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld compile time: %ld.%06ld\n",
-            (long) diff.tv_sec, (long) diff.tv_usec);
-
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
-    }
+int32_t *run_query_simd(struct gen_data *d, int threads) {
+    int32_t *result = (int32_t *) malloc(sizeof(int32_t) * d->size);
+    bench_parallel_for(threads, d->size, [&](int64_t start, int64_t end) {
+        run_query_simd_range(d, result, start, end);
+    });
+    return result;
+}
+#endif
 
-   gettimeofday(&start, 0);
-   struct args args;
-   args.x = make_weld_vector<int32_t>(d->x, d->size);
-   args.a = d->a;
-   weld_value_t weld_args = weld_value_new(&args);
-
-   // Run the module and get the result.
-    conf = weld_conf_new();
-    weld_value_t result = weld_module_run(m, conf, weld_args, e);
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
-    }
-    weld_vector<int32_t> *result_data = (weld_vector<int32_t> *) weld_value_data(result);
-    int32_t final_result = result_data->data[0];
+/** Copies the appender's vector out of a Weld result before it is freed. */
+struct weld_vector<int32_t> copy_output(void *data) {
+    weld_vector<int32_t> *v = (weld_vector<int32_t> *) data;
+    int32_t *copy = (int32_t *) malloc(sizeof(int32_t) * (v->length > 0 ? v->length : 1));
+    memcpy(copy, v->data, sizeof(int32_t) * v->length);
+    return make_weld_vector<int32_t>(copy, v->length);
+}
 
-    // Free the values.
-    weld_value_free(result);
-    weld_value_free(weld_args);
-    weld_conf_free(conf);
+/** Times the Weld program, then runs it once more untimed to return its
+ * whole output, allocated with malloc. */
+struct weld_vector<int32_t> run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("vector.weld");
 
-    weld_error_free(e);
-    weld_module_free(m);
+    struct args args;
+    args.x = make_weld_vector<int32_t>(d->x, d->size);
+    args.a = d->a;
 
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, final_result);
+    int32_t final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, [](void *data) {
+        return ((weld_vector<int32_t> *) data)->data[0];
+    }, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%d)", final_result);
 
-    return final_result;
+    struct weld_vector<int32_t> output = weld_bench_query<struct weld_vector<int32_t> >(&m, &args, copy_output);
+    weld_bench_module_free(&m);
+    return output;
+}
+
+/** Checks a scheme's output vector against the reference and frees it. */
+void verify_output(const char *scheme, const int32_t *expected, int32_t *output, int64_t size) {
+    bench_verify_array(scheme, "output", expected, output, size);
+    free(output);
 }
 
 /** Generates input data.
  *
- * @param num_items the number of line items.
- * @param num_buckets the number of buckets we hash into.
- * @param prob the selectivity of the branch.
+ * @param size the number of elements.
+ * @param seed the seed of the random values.
  * @return the generated data in a structure.
  */
-struct gen_data generate_data(int size) {
+struct gen_data generate_data(int size, uint64_t seed) {
     struct gen_data d;
 
     d.size = size;
-    d.x = (int32_t *)malloc(sizeof(int32_t) * size);
+    d.x = (int32_t *) bench_alloc(sizeof(int32_t) * size);
 
-    srand(1);
-    for (int i = 0; i < d.size; i++) {
-        d.x[i] = rand();
-    }
-    d.a = rand();
+    // Small values keep every x[i] + a well inside int32, so results compare exactly.
+    bench_fill_uniform<int32_t>(d.x, size, -100, 100, bench_rng_make(seed, 0));
+    d.a = bench_random_uniform<int32_t>(bench_random(bench_rng_make(seed, 1), 0), -100, 100);
 
     return d;
 }
@@ -141,8 +128,13 @@ struct gen_data generate_data(int size) {
 int main(int argc, char **argv) {
     int size = (1E8 / sizeof(int));
 
+    struct bench_options o = bench_options_default();
+
     int ch;
-    while ((ch = getopt(argc, argv, "n:")) != -1) {
+    while ((ch = getopt(argc, argv, "n:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
         switch (ch) {
             case 'n':
                 size = atoi(optarg);
@@ -157,21 +149,44 @@ int main(int argc, char **argv) {
     // Check parameters.
     assert(size > 0);
 
-    struct gen_data d = generate_data(size);
-    int32_t result;
-    struct timeval start, end, diff;
-
-    gettimeofday(&start, 0);
-    result = run_query(&d);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Single-threaded C++: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, result);
-
-    free(d.x);
-    d = generate_data(size);
+    // Each query reads the input and writes an output of the same size.
+    o.bytes = 2.0 * size * sizeof(int32_t);
+    o.traffic = BENCH_TRAFFIC_COPY;
+
+    struct gen_data d = generate_data(size, o.seed);
+    // The output of the last trial of each scheme.
+    int32_t *output = NULL;
+
+    struct bench_stats stats = bench_trials_output(&o, &output, [&] { return run_query(&d); }, free);
+    bench_report_stats("Single-threaded C++", &stats, "(result=%d)", output[0]);
+    // Every other scheme must compute the same vector.
+    int32_t *expected = output;
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_query_parallel(&d, o.threads); }, free);
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%d, threads=%d)", output[0], o.threads);
+    verify_output("Multi-threaded C++", expected, output, d.size);
+    output = NULL;
+
+#ifdef __AVX2__
+    stats = bench_trials_output(&o, &output, [&] { return run_query_simd(&d, 1); }, free);
+    bench_report_stats("SIMD C++", &stats, "(result=%d)", output[0]);
+    verify_output("SIMD C++", expected, output, d.size);
+    output = NULL;
+
+    stats = bench_trials_output(&o, &output, [&] { return run_query_simd(&d, o.threads); }, free);
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%d, threads=%d)", output[0], o.threads);
+    verify_output("Multi-threaded SIMD C++", expected, output, d.size);
+    output = NULL;
+#endif
 
-    result = run_query_weld(&d);
+    struct weld_vector<int32_t> weld_output = run_query_weld(&d, &o);
+    if (bench_verify_int("Weld", "length", d.size, weld_output.length)) {
+        bench_verify_array("Weld", "output", expected, weld_output.data, d.size);
+    }
+    free(weld_output.data);
+    free(expected);
+    bench_free(d.x);
 
-    return 0;
+    return bench_verify_status();
 }
@@ -16,128 +16,235 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
 
-#include "weld.h"
+#include "weld_bench.h"
+#include "bench_columns.h"
+#include "bench_reader.h"
 
 // The generated input data.
 struct gen_data {
     int64_t size;
     int32_t *x;
-};
-
-template <typename T>
-struct weld_vector {
-    T *data;
-    int64_t size;
+    // The column file the input data is mapped from, if base is not NULL.
+    struct column_file cache;
 };
 
 struct args {
     struct weld_vector<int32_t> x;
 };
 
-template <typename T>
-weld_vector<T> make_weld_vector(T *data, int64_t size) {
-    struct weld_vector<T> vector;
-    vector.data = data;
-    vector.size = size;
-    return vector;
-}
-
 int32_t run_query(struct gen_data *d) {
-    int32_t result;
-    for (int i = 0; i < d->size; i++) {
+    int32_t result = 0;
+    for (int64_t i = 0; i < d->size; i++) {
         result += d->x[i];
     }
     return result;
 }
 
-int32_t run_query_weld(struct gen_data *d) {
-    // Compile Weld module.
-    weld_error_t e = weld_error_new();
-    weld_conf_t conf = weld_conf_new();
-
-    FILE *fptr = fopen("vector_sum.weld", "r");
-    fseek(fptr, 0, SEEK_END);
-    int string_size = ftell(fptr);
-    rewind(fptr);
-    char *program = (char *) malloc(sizeof(char) * (string_size + 1));
-    fread(program, sizeof(char), string_size, fptr);
-    program[string_size] = '\0';
-
-    struct timeval start, end, diff;
-    gettimeofday(&start, 0);
-    weld_module_t m = weld_module_compile(program, conf, e);
-    weld_conf_free(conf);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld compile time: %ld.%06ld\n",
-            (long) diff.tv_sec, (long) diff.tv_usec);
-
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+int32_t run_query_range(struct gen_data *d, int64_t start, int64_t end) {
+    int32_t result = 0;
+    for (int64_t i = start; i < end; i++) {
+        result += d->x[i];
     }
+    return result;
+}
 
-   gettimeofday(&start, 0);
-   struct args args;
-   args.x = make_weld_vector<int32_t>(d->x, d->size);
-   weld_value_t weld_args = weld_value_new(&args);
-
-   // Run the module and get the result.
-    conf = weld_conf_new();
-    weld_value_t result = weld_module_run(m, conf, weld_args, e);
-    if (weld_error_code(e)) {
-        const char *err = weld_error_message(e);
-        printf("Error message: %s\n", err);
-        exit(1);
+int32_t run_query_parallel(struct gen_data *d, int threads) {
+    return bench_parallel_sum<int32_t>(threads, d->size, [&](int64_t start, int64_t end) {
+        return run_query_range(d, start, end);
+    });
+}
+
+#ifdef __AVX2__
+int32_t run_query_simd_range(struct gen_data *d, int64_t start, int64_t end) {
+    // Two accumulators to hide the add latency.
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    int64_t i = start;
+    for (; i + 16 <= end; i += 16) {
+        acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256((const __m256i *) &d->x[i]));
+        acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256((const __m256i *) &d->x[i + 8]));
     }
-    int32_t final_result = *((int32_t *) weld_value_data(result));
+    int32_t result = bench_hsum_epi32(_mm256_add_epi32(acc0, acc1));
+    return result + run_query_range(d, i, end);
+}
 
-    // Free the values.
-    weld_value_free(result);
-    weld_value_free(weld_args);
-    weld_conf_free(conf);
+int32_t run_query_simd(struct gen_data *d, int threads) {
+    return bench_parallel_sum<int32_t>(threads, d->size, [&](int64_t start, int64_t end) {
+        return run_query_simd_range(d, start, end);
+    });
+}
+#endif
 
-    weld_error_free(e);
-    weld_module_free(m);
+int32_t run_query_weld(struct gen_data *d, const struct bench_options *o) {
+    struct weld_bench_module m = weld_bench_compile("vector_sum.weld");
 
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Weld: %ld.%06ld (result=%d)\n",
-           (long) diff.tv_sec, (long) diff.tv_usec, final_result);
+    struct args args;
+    args.x = make_weld_vector<int32_t>(d->x, d->size);
 
+    int32_t final_result;
+    struct bench_stats stats = weld_bench_trials(o, &m, &args, weld_bench_scalar<int32_t>, &final_result);
+    bench_report_stats("Weld", &stats, "(result=%d)", final_result);
+
+    weld_bench_module_free(&m);
     return final_result;
 }
 
 /** Generates input data.
  *
- * @param num_items the number of line items.
- * @param num_buckets the number of buckets we hash into.
- * @param prob the selectivity of the branch.
+ * @param size the number of elements.
+ * @param seed the seed of the random values.
  * @return the generated data in a structure.
  */
-struct gen_data generate_data(int size) {
+struct gen_data generate_data(int size, uint64_t seed) {
     struct gen_data d;
 
     d.size = size;
-    d.x = (int32_t *)malloc(sizeof(int32_t) * size);
+    d.cache.base = NULL;
+    d.x = (int32_t *) bench_alloc(sizeof(int32_t) * size);
 
-    srand(1);
-    for (int i = 0; i < d.size; i++) {
-        d.x[i] = rand();
-    }
+    // Values are centered on zero so that sums stay far from int32 overflow.
+    bench_fill_uniform<int32_t>(d.x, size, -100, 100, bench_rng_make(seed, 0));
 
     return d;
 }
 
+/** Writes the input column to a column file.
+ *
+ * @param path the column file.
+ * @param key the parameters the data was generated with.
+ * @param d the data to write.
+ * @return true on success.
+ */
+bool write_cache(const char *path, const char *key, const struct gen_data *d) {
+    struct column_spec columns[] = {
+        { "x", COLUMN_INT32, d->x },
+    };
+    return column_file_write(path, key, d->size, columns, 1);
+}
+
+/** Maps input data from a column file written by write_cache.
+ *
+ * @param path the column file.
+ * @param key the parameters the data must have been generated with.
+ * @param d the mapped data, set on success.
+ * @return true on success, false if the file is missing or stale.
+ */
+bool map_data(const char *path, const char *key, struct gen_data *d) {
+    if (!column_file_map(path, key, &d->cache)) {
+        return false;
+    }
+    d->size = d->cache.num_rows;
+    d->x = (int32_t *) column_file_column(&d->cache, "x", COLUMN_INT32);
+    return true;
+}
+
+void free_generated_data(struct gen_data *d) {
+    if (d->cache.base != NULL) {
+        column_file_unmap(&d->cache);
+    } else {
+        bench_free(d->x);
+    }
+}
+
+/** Sums a column file read from disk in blocks.
+ *
+ * For each chunk size in o->chunk_sizes, every trial opens the file with
+ * its pages evicted and reads it with o->read_depth blocks in flight,
+ * summing each block as it arrives.
+ *
+ * @param path the column file, written by write_cache.
+ * @param key the parameters the data was generated with.
+ * @param expected the result over the whole file, which both scans are
+ * checked against.
+ * @param o the options; the chunk sizes and reader settings are used.
+ */
+void run_scan(const char *path, const char *key, int32_t expected, const struct bench_options *o) {
+    static const struct column_reader_column columns[] = {
+        { "x", COLUMN_INT32 },
+    };
+    struct weld_bench_module m = weld_bench_compile("vector_sum.weld");
+
+    for (int c = 0; c < o->num_chunk_sizes; c++) {
+        int32_t result;
+        double stall;
+        int64_t bytes, num_rows, block_rows, num_blocks;
+        const char *io;
+        auto open_reader = [&] {
+            struct column_reader *r = column_reader_open(path, key, columns, 1,
+                    o->chunk_sizes[c], o->read_depth, o->reader);
+            if (r == NULL) {
+                fprintf(stderr, "could not open %s\n", path);
+                exit(1);
+            }
+            return r;
+        };
+        // Records the reader's settings and closes it.
+        auto finish = [&](struct column_reader *r) {
+            num_rows = column_reader_num_rows(r);
+            block_rows = column_reader_block_rows(r);
+            num_blocks = column_reader_num_blocks(r);
+            stall = column_reader_stall(r);
+            io = column_reader_backend_name(r);
+            column_reader_close(r);
+        };
+
+        struct bench_stats stats = bench_trials(o, [&] {
+            struct column_reader *r = open_reader();
+            result = 0;
+            bytes = bench_scan(r, [&](const struct column_block *b) {
+                struct gen_data view;
+                view.size = b->rows;
+                view.x = (int32_t *) b->columns[0];
+                result += run_query_parallel(&view, o->threads);
+            });
+            finish(r);
+        });
+        char scheme[64];
+        snprintf(scheme, sizeof(scheme), "Multi-threaded C++ scan (rows=%lld)", (long long) block_rows);
+        bench_report_stats(scheme, &stats,
+                "(result=%d, threads=%d, io=%s, depth=%d, blocks=%lld, rows-per-sec=%.0f, mb-per-sec=%.1f, stall=%.9f)",
+                result, o->threads, io, o->read_depth, (long long) num_blocks,
+                num_rows / stats.median, bytes / stats.median / 1e6, stall);
+        bench_verify_int(scheme, "result", expected, result);
+
+        stats = bench_trials(o, [&] {
+            struct column_reader *r = open_reader();
+            result = 0;
+            bytes = bench_scan(r, [&](const struct column_block *b) {
+                struct args args;
+                args.x = make_weld_vector<int32_t>((int32_t *) b->columns[0], b->rows);
+                result += weld_bench_query<int32_t>(&m, &args, weld_bench_scalar<int32_t>);
+            });
+            finish(r);
+        });
+        snprintf(scheme, sizeof(scheme), "Weld scan (rows=%lld)", (long long) block_rows);
+        bench_report_stats(scheme, &stats,
+                "(result=%d, io=%s, depth=%d, blocks=%lld, rows-per-sec=%.0f, mb-per-sec=%.1f, stall=%.9f)",
+                result, io, o->read_depth, (long long) num_blocks,
+                num_rows / stats.median, bytes / stats.median / 1e6, stall);
+        bench_verify_int(scheme, "result", expected, result);
+    }
+
+    weld_bench_module_free(&m);
+}
+
 int main(int argc, char **argv) {
     int size = (1E8 / sizeof(int));
+    // A column file caching the input data across runs.
+    const char *cache = NULL;
+
+    struct bench_options o = bench_options_default();
 
     int ch;
-    while ((ch = getopt(argc, argv, "n:")) != -1) {
+    while ((ch = getopt(argc, argv, "m:n:" BENCH_OPTIONS)) != -1) {
+        if (bench_parse_option(&o, ch, optarg)) {
+            continue;
+        }
         switch (ch) {
+            case 'm':
+                cache = optarg;
+                break;
             case 'n':
                 size = atoi(optarg);
                 break;
@@ -150,22 +257,82 @@ int main(int argc, char **argv) {
 
     // Check parameters.
     assert(size > 0);
+    if (cache != NULL && bench_alloc_is_placed()) {
+        fprintf(stderr, "columns mapped from -m are not placed; -a must be malloc");
+        exit(1);
+    }
 
-    struct gen_data d = generate_data(size);
+    // Each query streams the input once.
+    o.bytes = (double) size * sizeof(int32_t);
+    o.traffic = BENCH_TRAFFIC_READ;
+
+    // Identifies the input data in the column file cache.
+    char key[COLUMN_FILE_KEY_LEN];
+    snprintf(key, sizeof(key), "vector_sum n=%d seed=%llu", size, (unsigned long long) o.seed);
+
+    struct gen_data d;
+    if (o.num_chunk_sizes > 0) {
+        if (cache == NULL) {
+            // Chunked mode always scans a file, so -C alone uses a default one.
+            cache = "vector_sum.cols";
+        }
+        // Scan the column file from disk, writing it first if it is missing.
+        if (!column_file_check(cache, key)) {
+            d = generate_data(size, o.seed);
+            if (!write_cache(cache, key, &d)) {
+                fprintf(stderr, "could not write %s\n", cache);
+                exit(1);
+            }
+            free_generated_data(&d);
+        }
+        if (!map_data(cache, key, &d)) {
+            fprintf(stderr, "could not map %s\n", cache);
+            exit(1);
+        }
+        int32_t expected = run_query(&d);
+        free_generated_data(&d);
+        run_scan(cache, key, expected, &o);
+        return bench_verify_status();
+    }
+    if (cache == NULL || !map_data(cache, key, &d)) {
+        d = generate_data(size, o.seed);
+        if (cache != NULL) {
+            // Run on the written file so every run measures the same input.
+            if (!write_cache(cache, key, &d)) {
+                fprintf(stderr, "could not write %s\n", cache);
+                exit(1);
+            }
+            free_generated_data(&d);
+            if (!map_data(cache, key, &d)) {
+                fprintf(stderr, "could not map %s\n", cache);
+                exit(1);
+            }
+        }
+    }
     int32_t result;
-    struct timeval start, end, diff;
 
-    gettimeofday(&start, 0);
-    result = run_query(&d);
-    gettimeofday(&end, 0);
-    timersub(&end, &start, &diff);
-    printf("Single-threaded C++: %ld.%06ld (result=%d)\n",
-            (long) diff.tv_sec, (long) diff.tv_usec, result);
+    struct bench_stats stats = bench_trials(&o, [&] { result = run_query(&d); });
+    bench_report_stats("Single-threaded C++", &stats, "(result=%d)", result);
+    // Every other scheme must compute the same sum.
+    int32_t expected = result;
 
-    free(d.x);
-    d = generate_data(size);
+    stats = bench_trials(&o, [&] { result = run_query_parallel(&d, o.threads); });
+    bench_report_stats("Multi-threaded C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    bench_verify_int("Multi-threaded C++", "result", expected, result);
+
+#ifdef __AVX2__
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, 1); });
+    bench_report_stats("SIMD C++", &stats, "(result=%d)", result);
+    bench_verify_int("SIMD C++", "result", expected, result);
+
+    stats = bench_trials(&o, [&] { result = run_query_simd(&d, o.threads); });
+    bench_report_stats("Multi-threaded SIMD C++", &stats, "(result=%d, threads=%d)", result, o.threads);
+    bench_verify_int("Multi-threaded SIMD C++", "result", expected, result);
+#endif
 
-    result = run_query_weld(&d);
+    result = run_query_weld(&d, &o);
+    bench_verify_int("Weld", "result", expected, result);
+    free_generated_data(&d);
 
-    return 0;
+    return bench_verify_status();
 }
@@ -4,6 +4,8 @@ import itertools
 import json
 import math
 import numpy as np
+import os
+import re
 import subprocess
 import sys
 
@@ -19,6 +21,16 @@ def labeled_params(param_dict):
         ret.append(p_list)
     return ret
         
+## metadata appended to timing lines by -R (bandwidth), -M (memory, in MB), -K (throughput) and -L (open loop) ##
+RECORDED_METRICS = ['gbps', 'roofline', 'allocated', 'heap-peak', 'rss-peak', 'qps', 'achieved',
+                    'p50', 'p99', 'p999']
+METRIC_PATTERN = re.compile(r'([a-z-]+)=([0-9.]+)(?:MB)?(?=[ \]])')
+
+## exit status of a compiled benchmark in which a scheme computed a wrong result ##
+VERIFY_FAILED = 2
+## (benchmark, parameters, exit status) of every run that did not exit cleanly ##
+failed_runs = []
+
 def parse_output(output):
     output_lines = output.split("\n")
     times = []
@@ -32,7 +44,24 @@ def parse_output(output):
         times.append((scheme, time))
     return times
 
-def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default, verbose):
+def parse_metrics(output):
+    ''' -> [(scheme, metric, value)] for the RECORDED_METRICS in bracketed metadata '''
+    metrics = []
+    for output_line in output.split("\n"):
+        output_line = output_line.strip()
+        if ": " not in output_line:
+            continue
+        scheme = output_line.split(": ")[0]
+        for bracket in re.findall(r'\[([^\]]*)\]', output_line):
+            for (metric, value) in METRIC_PATTERN.findall(bracket + ' '):
+                if metric in RECORDED_METRICS:
+                    metrics.append((scheme, metric, float(value)))
+    return metrics
+
+def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default, verbose,
+                  reps=1, warmup=0, alloc='malloc', bandwidth_file=None, memory=False,
+                  clients=0, queries=100, rates=None, chunks=None, read_depth=None, reader=None,
+                  tolerance=None):
     if verbose:
         print("++++++++++++++++++++++++++++++++++++++")
         print(benchmark)
@@ -40,9 +69,35 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
 
     b_config = read_config('benchmarks/%s/config.json' % benchmark)
 
+    harness_flags = ''
+    harness_settings = []
     if b_config['compile'] == True:
         compile_benchmark(benchmark)
+        ## compiled benchmarks repeat their kernels in-process ##
+        harness_flags = '-r %d -w %d -a %s' % (reps, warmup, alloc)
+        if alloc != 'malloc':
+            harness_settings.append(('alloc', alloc))
+        if bandwidth_file is not None:
+            harness_flags += ' -R %s' % bandwidth_file
+        if memory:
+            harness_flags += ' -M'
+        if clients > 0:
+            harness_flags += ' -K %d' % clients
+        if rates is not None:
+            harness_flags += ' -L %s' % rates
+        if clients > 0 or rates is not None:
+            harness_flags += ' -Q %d' % queries
+        if chunks is not None:
+            harness_flags += ' -C %s' % chunks
+        if read_depth is not None:
+            harness_flags += ' -D %d' % read_depth
+        if reader is not None:
+            harness_flags += ' -B %s' % reader
+        if tolerance is not None:
+            harness_flags += ' -T %g' % tolerance
 
+    ## each parameter set is swept over as its own cross product ##
+    extra_param_sets = []
     if default:
         params = b_config.get('default_params', {})
         params = {key: [value] for (key, value) in params.items()}
@@ -56,6 +111,8 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
 
         params.update(scaled_params)
 
+        extra_param_sets = [expand_params(sweep) for sweep in b_config.get('sweeps', [])]
+
     csvf = open(csv_filename, 'a+')
     writer = csv.writer(csvf, delimiter='\t')
     logfile = "benchmarks/%s/output.log" % benchmark
@@ -66,10 +123,12 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
         nf.write("++++++++++++++++++++++++++++++++++++++\n\n")
 
     all_times = list()
-    param_settings = itertools.product(*labeled_params(params))
+    param_settings = itertools.chain(*[itertools.product(*labeled_params(p))
+                                       for p in [params] + extra_param_sets])
     for s in param_settings:
-        log_settings  = (', '.join(['%s=%s'  % (x[0], str(x[1])) for x in s]))
-        csv_settings  = ( ';'.join(['%s=%s'  % (x[0], str(x[1])) for x in s]))
+        recorded = s + tuple(harness_settings) ## harness settings are logged, not passed as params ##
+        log_settings  = (', '.join(['%s=%s'  % (x[0], str(x[1])) for x in recorded]))
+        csv_settings  = ( ';'.join(['%s=%s'  % (x[0], str(x[1])) for x in recorded]))
         flag_settings = ( ' '.join(['-%s %s' % (x[0], str(x[1])) for x in s]))
         
         if verbose:
@@ -80,10 +139,19 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
             nf.write("\n")
 
         times = {}
+        ## bandwidth and memory metadata, per (scheme, metric) ##
+        metrics = {}
+        ## exit status of each failed trial ##
+        failures = []
         for i in range(num_iterations):
-            output = subprocess.check_output("cd benchmarks/%s; WELD_NUM_THREADS=%d ./bench %s 2>/dev/null"
-                                             % (benchmark, num_threads, flag_settings),
-                                             shell=True)
+            try:
+                output = subprocess.check_output("cd benchmarks/%s; WELD_NUM_THREADS=%d ./bench %s %s 2>/dev/null"
+                                                 % (benchmark, num_threads, flag_settings, harness_flags),
+                                                 shell=True)
+            except subprocess.CalledProcessError as e:
+                ## the timings of a run that failed verification are still recorded ##
+                output = e.output
+                failures.append(e.returncode)
             try:
                 output = output.decode('utf-8')
             except:
@@ -96,6 +164,8 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
                 if scheme not in times:
                     times[scheme] = list()
                 times[scheme].append(time)
+            for (scheme, metric, value) in parse_metrics(output):
+                metrics.setdefault((scheme, metric), []).append(value)
 
         for scheme in times:
             row = [benchmark, scheme, log_settings]
@@ -106,6 +176,18 @@ def run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default,
                 sys.stdout.flush()
             row.extend([str(elem) for elem in times[scheme]])
             writer.writerow(row)
+        for (scheme, metric) in sorted(metrics):
+            values = metrics[(scheme, metric)]
+            if verbose:
+                print("%s (%s): %.2f" % (scheme, metric, np.mean(values)))
+            writer.writerow([benchmark, "%s (%s)" % (scheme, metric), log_settings] + [str(x) for x in values])
+        if failures:
+            label = "Verification failed" if VERIFY_FAILED in failures else "Failed"
+            if verbose:
+                print("%s: %d of %d trials (exit status %s)"
+                      % (label, len(failures), num_iterations, ', '.join([str(x) for x in failures])))
+            writer.writerow([benchmark, label, log_settings] + [str(x) for x in failures])
+            failed_runs.append((benchmark, log_settings, failures[0]))
         if verbose:
             print("\n")
         all_times.append(times)
@@ -166,6 +248,31 @@ if __name__ == '__main__':
                         help="Output verbose statistics")
     parser.add_argument('-d', "--default", action='store_true',
                         help="Use default arguments for every binary")
+    parser.add_argument('-r', "--reps", type=int, default=1,
+                        help="Timed in-process repetitions per trial (compiled benchmarks)")
+    parser.add_argument('-w', "--warmup", type=int, default=0,
+                        help="Untimed in-process repetitions per trial (compiled benchmarks)")
+    parser.add_argument('-a', "--alloc", type=str, default='malloc',
+                        choices=['malloc', 'first-touch', 'interleave', 'thp', 'hugetlb'],
+                        help="Placement of input columns (compiled benchmarks)")
+    parser.add_argument('-R', "--roofline", action='store_true',
+                        help="Report achieved memory bandwidth against a probed peak (compiled benchmarks)")
+    parser.add_argument('-M', "--memory", action='store_true',
+                        help="Record allocations and peak RSS of each scheme (compiled benchmarks)")
+    parser.add_argument('-K', "--clients", type=int, default=0,
+                        help="Largest number of concurrent Weld clients in throughput mode (compiled benchmarks)")
+    parser.add_argument('-Q', "--queries", type=int, default=100,
+                        help="Timed queries per client in throughput mode, or per rate in open-loop mode")
+    parser.add_argument('-L', "--rates", type=str, default=None,
+                        help="Comma-separated offered loads (queries/sec) for open-loop mode (compiled benchmarks)")
+    parser.add_argument('-C', "--chunks", type=str, default=None,
+                        help="Comma-separated chunk sizes (rows) for chunked mode (compiled benchmarks)")
+    parser.add_argument('-D', "--read_depth", type=int, default=None,
+                        help="Blocks in flight when scanning column files (compiled benchmarks)")
+    parser.add_argument('-B', "--reader", type=str, default=None, choices=['io_uring', 'pread'],
+                        help="Backend for scanning column files (compiled benchmarks)")
+    parser.add_argument('-T', "--tolerance", type=float, default=None,
+                        help="Relative tolerance of floating-point result checks (compiled benchmarks)")
     parser.add_argument('-p', "--plot_filename", type=str, default=None,
                         help="Plot filename")
 
@@ -178,8 +285,18 @@ if __name__ == '__main__':
     csv_filename = opt_dict["csv_filename"]
     default = opt_dict["default"]
     verbose = opt_dict["verbose"]
+    reps = opt_dict["reps"]
+    warmup = opt_dict["warmup"]
+    alloc = opt_dict["alloc"]
     open(csv_filename, 'w').close() ## erase current contents ##
 
+    bandwidth_file = None
+    if opt_dict["roofline"]:
+        ## probed once per session, by the first benchmark that reports a roofline ##
+        bandwidth_file = os.path.abspath(csv_filename + ".bandwidth")
+        if os.path.exists(bandwidth_file):
+            os.remove(bandwidth_file)
+
     csvf = open(csv_filename, 'a+')
     writer = csv.writer(csvf, delimiter='\t')
     row = ["Benchmark", "Scheme", "Parameters"]
@@ -192,9 +309,18 @@ if __name__ == '__main__':
 
     all_times = []
     for benchmark in benchmarks:
-        times = run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default, verbose)
+        times = run_benchmark(benchmark, num_threads, num_iterations, csv_filename, default, verbose,
+                              reps, warmup, alloc, bandwidth_file, opt_dict["memory"],
+                              opt_dict["clients"], opt_dict["queries"], opt_dict["rates"],
+                              opt_dict["chunks"], opt_dict["read_depth"], opt_dict["reader"],
+                              opt_dict["tolerance"])
         all_times.append((benchmark, times[0]))  # Only consider first parameter for plotting
 
     plot_filename = opt_dict["plot_filename"]
     if plot_filename is not None:
         utils.plot(all_times, plot_filename)
+
+    if failed_runs:
+        for (benchmark, settings, status) in failed_runs:
+            sys.stderr.write("%s (%s) exited with status %d\n" % (benchmark, settings, status))
+        sys.exit(1)
@@ -17,7 +17,8 @@ def plot(all_times, filename=None):
     xpos = 0.0
     ticks = []
     tick_labels = []
-    scheme_ordering = ["Single-threaded C++", "Pandas", "Weld", "Weld compile time"]
+    scheme_ordering = ["Single-threaded C++", "Multi-threaded C++", "Multi-threaded SIMD C++",
+                       "Pandas", "Weld", "Weld compile time (cold)"]
     for (benchmark, times) in all_times:
         i = 0
         for scheme in scheme_ordering: